@@ -0,0 +1,4 @@
+// Deferred rendering pixel shader for materials selected from the global texture array
+
+#define BINDLESS
+#include "MRT.frag.hlsl"
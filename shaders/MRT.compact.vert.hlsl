@@ -0,0 +1,4 @@
+// Deferred Rendering vertex shader for the Compact and Quantized vertex formats
+
+#define COMPACT_VERTEX
+#include "MRT.vert.hlsl"
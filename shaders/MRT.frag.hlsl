@@ -1,5 +1,7 @@
 // Deferred rendering pixel shader
 
+// BINDLESS is defined by MRT.bindless.frag.hlsl, materials are selected by the instance instead of per draw descriptor sets
+
 #define SPARKLE_MAT_NORMAL_MAP 0x010
 #define SPARKLE_MAT_PBR 0x100
 
@@ -9,6 +11,9 @@ struct PS_INPUT {
 	[[vk::location(2)]] float3 tangent : TANGENT;
 	[[vk::location(3)]] float3 bitangent : BITANGENT;
 	[[vk::location(4)]] float2 uv : UV;
+#ifdef BINDLESS
+	[[vk::location(5)]] nointerpolation uint material : MATERIAL;
+#endif
 };
 
 struct PS_OUTPUT {
@@ -18,24 +23,49 @@ struct PS_OUTPUT {
 	[[vk::location(3)]] float4 pbrSpecular : SV_Target3;
 };
 
+#ifdef BINDLESS
+// matches BindlessMaterials::MaterialData, texture members index the texture array
+struct MaterialData {
+	uint albedo;
+	uint specular;
+	uint normal;
+	uint roughness;
+	uint metallic;
+	uint features;
+	uint2 pad;
+};
+
+[[vk::binding(0, 1)]] Texture2D textures[];
+[[vk::binding(0, 1)]] SamplerState samplers[];
+[[vk::binding(1, 1)]] StructuredBuffer<MaterialData> materials;
+
+// the draws of one multi draw indirect call select different materials, the index is not uniform
+float4 sampleTexture(uint index, float2 uv)
+{
+	return textures[NonUniformResourceIndex(index)].Sample(samplers[NonUniformResourceIndex(index)], uv);
+}
+#define SAMPLE_MATERIAL(name, uv) sampleTexture(material.name, uv)
+#else
 [[vk::binding(0, 1)]] Texture2D albedoTexture;
-[[vk::binding(0, 1)]] SamplerState albSampler;
+[[vk::binding(0, 1)]] SamplerState albedoSampler;
 [[vk::binding(1, 1)]] Texture2D specularTexture;
-[[vk::binding(1, 1)]] SamplerState specSampler;
+[[vk::binding(1, 1)]] SamplerState specularSampler;
 [[vk::binding(2, 1)]] Texture2D normalTexture;
-[[vk::binding(2, 1)]] SamplerState normSampler;
+[[vk::binding(2, 1)]] SamplerState normalSampler;
 [[vk::binding(3, 1)]] Texture2D roughnessTexture;
-[[vk::binding(3, 1)]] SamplerState roughSampler;
+[[vk::binding(3, 1)]] SamplerState roughnessSampler;
 [[vk::binding(4, 1)]] Texture2D metallicTexture;
-[[vk::binding(4, 1)]] SamplerState metalSampler;
-
-[[vk::constant_id(0)]] const float NEAR_PLANE = 0.1f;
-[[vk::constant_id(1)]] const float FAR_PLANE = 1000.0f;
+[[vk::binding(4, 1)]] SamplerState metallicSampler;
 
 [[vk::push_constant]] cbuffer mat
 {
 	uint materialFeatures;
 };
+#define SAMPLE_MATERIAL(name, uv) name##Texture.Sample(name##Sampler, uv)
+#endif
+
+[[vk::constant_id(0)]] const float NEAR_PLANE = 0.1f;
+[[vk::constant_id(1)]] const float FAR_PLANE = 1000.0f;
 
 float calcLinearDepth(float zval)
 {
@@ -49,10 +79,17 @@ float calcLinearDepth(float zval)
 	PS_OUTPUT output;
 	output.position = float4(input.posWorld, calcLinearDepth(pos.z));
 
-	float4 albedo = albedoTexture.Sample(albSampler, input.uv);
+#ifdef BINDLESS
+	MaterialData material = materials[input.material];
+	uint materialFeatures = material.features;
+#endif
+	float4 albedo = SAMPLE_MATERIAL(albedo, input.uv);
 	float4 normal;
 	if ((materialFeatures & SPARKLE_MAT_NORMAL_MAP) == SPARKLE_MAT_NORMAL_MAP) {
-		normal = 2.0 * normalTexture.Sample(normSampler, input.uv) - 1.0;
+		// only x and y are stored in block compressed normal maps, z of a tangent space normal is positive
+		normal.xy = 2.0 * SAMPLE_MATERIAL(normal, input.uv).rg - 1.0;
+		normal.z = sqrt(saturate(1.0 - dot(normal.xy, normal.xy)));
+		normal.w = 0.0;
 	} else {
 		normal = float4(input.normal, 0.0);
 	}
@@ -89,11 +126,11 @@ float calcLinearDepth(float zval)
 
 	output.albedo = albedo;
 	if ((materialFeatures & SPARKLE_MAT_PBR) == SPARKLE_MAT_PBR) {
-		float roughness = roughnessTexture.Sample(roughSampler, input.uv).r;
-		float metallic = metallicTexture.Sample(metalSampler, input.uv).r;
+		float roughness = SAMPLE_MATERIAL(roughness, input.uv).r;
+		float metallic = SAMPLE_MATERIAL(metallic, input.uv).r;
 		output.pbrSpecular = float4(metallic, roughness, 0.0, 0.0);
 	} else {
-		output.pbrSpecular = specularTexture.Sample(specSampler, input.uv);
+		output.pbrSpecular = SAMPLE_MATERIAL(specular, input.uv);
 		output.pbrSpecular.a = 1.0;
 	}
 
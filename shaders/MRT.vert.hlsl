@@ -1,5 +1,15 @@
 // Deferred Rendering vertex shader
 
+// COMPACT_VERTEX is defined by MRT.compact.vert.hlsl for the Compact and Quantized vertex formats,
+// quantized positions are scaled back to object space by the model matrix
+#ifdef COMPACT_VERTEX
+struct VS_INPUT {
+	[[vk::location(0)]] float3 position : POSITION;
+	[[vk::location(1)]] float2 normal : NORMAL; // octahedral
+	[[vk::location(2)]] float4 tangent : TANGENT; // octahedral xy, bitangent sign z
+	[[vk::location(4)]] float2 uv : UV;
+};
+#else
 struct VS_INPUT {
 	[[vk::location(0)]] float3 position : POSITION;
 	[[vk::location(1)]] float3 normal : NORMAL;
@@ -7,6 +17,7 @@ struct VS_INPUT {
 	[[vk::location(3)]] float3 bitangent : BITANGENT;
 	[[vk::location(4)]] float2 uv : UV;
 };
+#endif
 
 struct VS_OUTPUT {
 	[[vk::location(0)]] float3 posWorld : POSITION_WORLD;
@@ -14,6 +25,7 @@ struct VS_OUTPUT {
 	[[vk::location(2)]] float3 tangent : TANGENT;
 	[[vk::location(3)]] float3 bitangent : BITANGENT;
 	[[vk::location(4)]] float2 uv : UV;
+	[[vk::location(5)]] nointerpolation uint material : MATERIAL; // only read by the bindless fragment shader
 };
 
 [[vk::binding(0, 0)]] cbuffer ubo {
@@ -21,22 +33,48 @@ struct VS_OUTPUT {
 	float4x4 projectionMat;
 }
 
-[[vk::binding(1, 0)]] cbuffer dubo {
+struct InstanceData {
 	float4x4 modelMat;
 	float4x4 normalMat;
+	uint4 material; // x: entry in the materials buffer of bindless draws
+};
+
+// one entry per drawn mesh, instanced draws select theirs through firstInstance
+[[vk::binding(1, 0)]] StructuredBuffer<InstanceData> instances;
+
+#ifdef COMPACT_VERTEX
+// inverse of Geometry::VertexPacking's octahedral mapping
+float3 octDecode(float2 e) {
+	float3 n = float3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = saturate(-n.z);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
 }
+#endif
 
-VS_OUTPUT main(in VS_INPUT input, out float4 vtxPos : SV_Position) {
+VS_OUTPUT main(in VS_INPUT input, uint instanceID : SV_InstanceID, out float4 vtxPos : SV_Position) {
 	VS_OUTPUT output;
+	float4x4 modelMat = instances[instanceID].modelMat;
+	float4x4 normalMat = instances[instanceID].normalMat;
 	float4 worldPos = mul(modelMat, float4(input.position, 1.0));
 	output.posWorld = worldPos.xyz;
 
 	float3x3 mNormal = float3x3(normalMat);
+#ifdef COMPACT_VERTEX
+	float3 normal = octDecode(input.normal);
+	float3 tangent = octDecode(input.tangent.xy);
+	output.normal = mul(mNormal, normal);
+	output.tangent = mul(mNormal, tangent);
+	output.bitangent = cross(normal, tangent) * (input.tangent.z < 0.0 ? -1.0 : 1.0);
+#else
 	output.normal = mul(mNormal, normalize(input.normal));
 	output.tangent = mul(mNormal, normalize(input.tangent));
 	output.bitangent = input.bitangent;
+#endif
 	output.uv = input.uv;
 	output.uv.t = 1.0 - output.uv.t;
+	output.material = instances[instanceID].material.x;
 
 	vtxPos = mul(projectionMat, mul(viewMat, worldPos));
 
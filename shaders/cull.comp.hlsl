@@ -72,7 +72,7 @@ void main(uint3 DTid : SV_DispatchThreadID) {
 		indirectDraws[idx].firstIndex = Meshes[idx].firstIndex;
 		indirectDraws[idx].indexCount = Meshes[idx].indexCount;
 		indirectDraws[idx].vertexOffset = 0;
-		indirectDraws[idx].firstInstance = 0;
+		indirectDraws[idx].firstInstance = idx;
 
 		InterlockedAdd(drawCount[idx], 1);
 	}
@@ -2,6 +2,7 @@
 
 struct PS_INPUT {
 	[[vk::location(0)]] float2 uv : UV;
+	float4 fragCoord : SV_Position;
 };
 
 struct PS_OUTPUT {
@@ -11,6 +12,8 @@ struct PS_OUTPUT {
 #define MASK 0x0000FFFF
 
 #define SPARKLE_SHADER_LIMIT_LIGHTS 1000
+// matches LightCulling::ClusterStride
+#define CLUSTER_STRIDE 256
 
 #define SPARKLE_MAT_NORMAL_MAP 0x010
 #define SPARKLE_MAT_PBR 0x100
@@ -24,10 +27,12 @@ struct PS_OUTPUT {
 [[vk::binding(4, 0)]] Texture2D pbrSpecularTex;
 [[vk::binding(4, 0)]] SamplerState pbrSampler;
 
+// position.w is 1 for point lights, directional lights store the direction towards the light with w = 0
 struct Light {
 	float4 position;
 	float4 color;
 	float radius;
+	float range;
 };
 
 [[vk::binding(0, 0)]] cbuffer ubo
@@ -36,9 +41,16 @@ struct Light {
 	uint numberOfLights;
 	float exposure;
 	float gamma;
+	float4x4 view;
+	float4 clusterProjection; // near, far, projection[0][0], projection[1][1]
+	uint4 clusterGrid; // tiles x, tiles y, depth slices, tile size
+	float4 screenSize;
 	Light lights[SPARKLE_SHADER_LIMIT_LIGHTS];
 };
 
+// per cluster the number of lights followed by their indices, written by lightcull.comp
+[[vk::binding(5, 0)]] StructuredBuffer<uint> clusterLights;
+
 static const float PI = 3.14159265359;
 static const float Epsilon = 0.001;
 static const float MinRoughness = 0.04;
@@ -48,14 +60,14 @@ static const float MinRoughness = 0.04;
 float3 blinnPhong(float3 fragPos, float3 N, float3 V, float3 diffColor, float3 specColor, uint lightnr)
 {
 	Light l = lights[lightnr];
-	float3 lightPos = l.position.xyz;
+	float3 toLight = l.position.xyz - fragPos * l.position.w;
 
-	float d = length(lightPos - fragPos);
-	float att = l.radius / ((d * d) + 1);
+	float d = length(toLight);
+	float att = l.position.w > 0.0 ? l.radius / ((d * d) + 1) : 1.0;
 	float3 rad = l.color.rgb * att;
 
 	// diffuse light
-	float3 L = normalize(lightPos - fragPos);
+	float3 L = normalize(toLight);
 	float diff = max(dot(L, N), 0.0);
 	float3 diffuse = diff * diffColor * att;
 
@@ -99,9 +111,9 @@ float3 FresnelSchlick(float cosTheta, float3 F0)
 float3 BRDF(float3 V, float3 N, float3 position, float3 albedo, float3 F0, Light light, float metallic, float roughness)
 {
 	// Precalculate vectors and dot products
-	float3 L = light.position.xyz - position;
+	float3 L = light.position.xyz - position * light.position.w;
 	float distance = length(L);
-	float attenuation = 1.0 / (distance * distance);
+	float attenuation = light.position.w > 0.0 ? 1.0 / (distance * distance) : 1.0;
 	float3 radiance = light.color.rgb * attenuation;
 
 	L = normalize(L);
@@ -130,6 +142,17 @@ float3 BRDF(float3 V, float3 N, float3 position, float3 albedo, float3 F0, Light
 	return color;
 }
 
+// first uint of the light list of the cluster containing the fragment, slices are spaced exponentially in view depth
+uint clusterBase(float2 fragCoord, float3 worldPos)
+{
+	float depth = -mul(view, float4(worldPos, 1.0)).z;
+	float near = clusterProjection.x;
+	float far = clusterProjection.y;
+	float slice = floor(log(max(depth, near) / near) / log(far / near) * clusterGrid.z);
+	uint3 cluster = uint3(min(uint2(fragCoord) / clusterGrid.w, clusterGrid.xy - 1), min(uint(slice), clusterGrid.z - 1));
+	return (cluster.x + (cluster.y + cluster.z * clusterGrid.y) * clusterGrid.x) * CLUSTER_STRIDE;
+}
+
 // ----------------------------------------------------------------------------
 
 PS_OUTPUT main(in PS_INPUT input)
@@ -154,6 +177,9 @@ PS_OUTPUT main(in PS_INPUT input)
 	float3 V = normalize(cameraPos.rgb - pos.rgb);
 	float3 N = normalize(normal);
 
+	uint base = clusterBase(input.fragCoord.xy, pos.rgb);
+	uint lightCount = clusterLights[base];
+
 	if (specularPbr.a < 1.0) { // use pbr rendering TODO: use a better switch instead of alpha value
 		float metallic = specularPbr.r;
 		float roughness = clamp(specularPbr.g, MinRoughness, 1.0);
@@ -161,15 +187,15 @@ PS_OUTPUT main(in PS_INPUT input)
 		float3 lo = 0.0;
 		float3 F0 = lerp(float3(0.04, 0.04, 0.04), albedo.rgb, metallic);
 
-		for (uint i = 0; i < numberOfLights; i++) {
-			lo += BRDF(V, N, pos.rgb, albedo.rgb, F0, lights[i], metallic, roughness);
+		for (uint i = 1; i <= lightCount; i++) {
+			lo += BRDF(V, N, pos.rgb, albedo.rgb, F0, lights[clusterLights[base + i]], metallic, roughness);
 		}
 		//color = float3(0.03, 0.03, 0.03) * albedo + lo;
 		color = lo;
 	} else {
 		float3 lo = float3(0.0, 0.0, 0.0);
-		for (uint i = 0; i < numberOfLights; i++) {
-			lo += blinnPhong(pos.rgb, N, V, albedo, specularPbr.rgb, i);
+		for (uint i = 1; i <= lightCount; i++) {
+			lo += blinnPhong(pos.rgb, N, V, albedo, specularPbr.rgb, clusterLights[base + i]);
 		}
 		color = float3(0.03, 0.03, 0.03) * albedo + lo;
 	}
@@ -0,0 +1,144 @@
+/*
+*   sparkle-cook
+*
+*   Offline level cooker: imports source levels once and writes cooked .spkl files
+*   usage: sparkle-cook [-j threads] <level> [<level> ...]
+*
+*   This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "AssimpConverter.h"
+#include "LevelWriter.h"
+#include "TextureCompression.h"
+#include "ThreadPool.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/config.h>
+#include <assimp/postprocess.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+#ifdef _WIN32
+#include <filesystem>
+namespace fs = std::filesystem;
+#elif __linux__
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+using namespace Sparkle;
+
+static std::mutex outputMutex;
+
+static void print(const std::string& msg, bool error = false)
+{
+    std::lock_guard<std::mutex> lock(outputMutex);
+    (error ? std::cerr : std::cout) << msg << std::endl;
+}
+
+static bool cookLevel(const std::string& input, Tools::ThreadPool& pool)
+{
+    Assimp::Importer importer;
+    // drop points and lines, the renderer only draws triangle lists
+    importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
+    const auto scene = importer.ReadFile(input,
+        aiProcess_CalcTangentSpace | aiProcess_GenSmoothNormals | aiProcess_JoinIdenticalVertices | aiProcess_Triangulate | aiProcess_FindDegenerates | aiProcess_FindInvalidData | aiProcess_SortByPType | aiProcess_ImproveCacheLocality | aiProcess_RemoveRedundantMaterials | aiProcess_ValidateDataStructure);
+    if (!scene || !scene->mRootNode) {
+        print(input + ": " + importer.GetErrorString(), true);
+        return false;
+    }
+
+    const auto dirOffs = input.find_last_of("/\\");
+    const auto rootDirectory = dirOffs == std::string::npos ? std::string() : input.substr(0, dirOffs + 1);
+
+    Import::AssimpConverter converter(scene, rootDirectory);
+    const auto level = converter.convert(&pool);
+    importer.FreeScene();
+
+    // block compress the texture files into the cache the engine loads them from
+    std::atomic<size_t> compressed { 0 };
+    pool.parallelFor(level.textures.size(), [&](size_t i) {
+        const auto& tex = level.textures[i];
+        if (!tex.embedded.empty()) {
+            return;
+        }
+        const auto path = rootDirectory + tex.path;
+        if (!fs::exists(fs::path(path))) {
+            print(input + ": missing texture " + tex.path, true);
+            return;
+        }
+        try {
+            auto image = Tools::TextureCompression::load(path, tex.type, pool);
+            image.free();
+            ++compressed;
+        } catch (std::exception& ex) {
+            print(input + ": " + tex.path + ": " + ex.what(), true);
+        }
+    });
+
+    auto output = fs::path(input).replace_extension(".spkl").string();
+    try {
+        Import::LevelWriter::write(level, output);
+    } catch (std::exception& ex) {
+        print(input + ": " + ex.what(), true);
+        return false;
+    }
+
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    size_t lodCount = 0;
+    size_t clusterCount = 0;
+    for (const auto& mesh : level.meshes) {
+        vertexCount += mesh.data.vertices.size();
+        indexCount += mesh.data.lods.empty() ? mesh.data.indices.size() : mesh.data.lods.front().indexCount;
+        lodCount += std::max<size_t>(mesh.data.lods.size(), 1);
+        clusterCount += mesh.data.clusters.size();
+    }
+    print(input + " -> " + output + " (" + std::to_string(level.meshes.size()) + " meshes, " + std::to_string(lodCount) + " lods, " + std::to_string(clusterCount) + " clusters, " + std::to_string(vertexCount) + " vertices, " + std::to_string(indexCount / 3) + " triangles, " + std::to_string(level.textures.size()) + " textures (" + std::to_string(compressed) + " compressed), " + std::to_string(level.lights.size()) + " lights, " + converter.getOptimizerReport().toString() + ")");
+    return true;
+}
+
+int main(const int argc, char** argv)
+{
+    size_t threads = std::thread::hardware_concurrency();
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            threads = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "-h" || arg == "--help") {
+            inputs.clear();
+            break;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    if (inputs.empty()) {
+        std::cerr << "usage: sparkle-cook [-j threads] <level> [<level> ...]" << std::endl
+                  << "Writes a cooked <level>.spkl next to every input file." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::atomic<size_t> failed { 0 };
+    {
+        Tools::ThreadPool pool(threads);
+        pool.parallelFor(inputs.size(), [&](size_t i) {
+            try {
+                if (!cookLevel(inputs[i], pool)) {
+                    ++failed;
+                }
+            } catch (std::exception& ex) {
+                print(inputs[i] + ": " + ex.what(), true);
+                ++failed;
+            }
+        });
+    }
+
+    print("Cooked " + std::to_string(inputs.size() - failed) + "/" + std::to_string(inputs.size()) + " levels");
+    return failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
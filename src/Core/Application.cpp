@@ -32,7 +32,7 @@ void App::initialize(std::string config)
     pRenderer->initialize(pSettings, pSettings->withValidationLayer());
 
 	pSceneLoader = std::make_unique<Import::SceneLoader>();
-	pSceneLoader->loadFromFile(pSettings->getLevelPath());
+	pSceneLoader->loadFromFile(pSettings->getLevelPath(), pSettings->getTextureCompression());
 
     pInputController = std::make_shared<InputController>(pWindow, pCamera);
 }
@@ -75,6 +75,12 @@ void App::mainLoop()
 	//pCamera->setAngle(28.0f, 165.f);
 
     double updateFreq = -1.0;
+    // draws of attached meshes are rebuilt at most once per rebuild window and once the level is complete,
+    // the time spent on rebuilding is paid back from the following activation slices
+    const double drawRebuildInterval = 0.25;
+    bool drawsPending = false;
+    auto lastDrawRebuild = lastTime;
+    double loadDebt = 0.0;
     while (!glfwWindowShouldClose(pWindow)) {
         const auto currentTime = glfwGetTime();
         deltaT = currentTime - lastTime;
@@ -92,6 +98,24 @@ void App::mainLoop()
             pScene = pSceneLoader->processScene();
             pRenderer->updateScenePtr(pScene);
         }
+        // the level is created over several frames, meshes are drawn soon after they are uploaded
+        if (pScene && !pSceneLoader->isActivated()) {
+            const auto budget = pSettings->getLoadBudgetMs() / 1000.0;
+            if (loadDebt >= budget) {
+                loadDebt -= budget;
+            } else {
+                const auto sliceStart = glfwGetTime();
+                drawsPending |= pSceneLoader->activate(budget - loadDebt);
+                loadDebt = std::max(0.0, glfwGetTime() - sliceStart - (budget - loadDebt));
+            }
+        }
+        if (drawsPending && (pSceneLoader->isActivated() || currentTime - lastDrawRebuild >= drawRebuildInterval)) {
+            const auto rebuildStart = glfwGetTime();
+            pRenderer->updateDrawCommand();
+            lastDrawRebuild = glfwGetTime();
+            loadDebt += lastDrawRebuild - rebuildStart;
+            drawsPending = false;
+        }
 
         // Update imGui
         ImGui::NewFrame();
@@ -123,9 +147,9 @@ void App::cleanup()
     glfwTerminate();
 }
 
-Geometry::Mesh::BufferOffset App::uploadMeshGPU(const Geometry::Mesh* mesh)
+Geometry::Mesh::BufferOffset App::uploadMeshGPU(const Geometry::Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount)
 {
-    return pRenderer->uploadMeshGPU(mesh);
+    return pRenderer->uploadMeshGPU(vertices, vertexCount, indices, indexCount);
 }
 
 void App::mouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
@@ -34,7 +34,7 @@ public:
         cleanup();
     }
 
-    Geometry::Mesh::BufferOffset uploadMeshGPU(const Geometry::Mesh* m);
+    Geometry::Mesh::BufferOffset uploadMeshGPU(const Geometry::Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount);
 
     std::shared_ptr<RenderBackend> getRenderBackend() { return pRenderer; }
 
@@ -10,11 +10,43 @@ namespace Lights {
         SPARKLE_LIGHT_TYPE_POINT = 0x2
     };
     typedef uint32_t LType;
+    /**
+     * layout of the lights in the deferred fragment shader uniforms, always in world space
+     */
     struct Light {
-        glm::vec4 mVec;
+        glm::vec4 mVec; // point lights: position with w = 1, directional lights: direction towards the light with w = 0
         glm::vec4 mColor;
-        float mRadius;
-        glm::vec3 _pad;
+        float mRadius; // scale of the distance attenuation, unused by directional lights
+        float mRange; // distance beyond which a point light is culled, see influenceRange
+        glm::vec2 _pad;
     };
+
+    /**
+     * point lights contributing less than this per unit of albedo are skipped by the light culling
+     */
+    constexpr float AttenuationCutoff = 0.01f;
+
+    inline Light pointLight(const glm::vec3& position, const glm::vec3& color, float radius)
+    {
+        return { glm::vec4(position, 1.0f), glm::vec4(color, 0.0f), radius, 0.0f, glm::vec2(0.0f) };
+    }
+
+    /**
+     * \param direction direction the light travels in
+     */
+    inline Light directionalLight(const glm::vec3& direction, const glm::vec3& color)
+    {
+        return { glm::vec4(-glm::normalize(direction), 0.0f), glm::vec4(color, 0.0f), 0.0f, 0.0f, glm::vec2(0.0f) };
+    }
+
+    /**
+     * distance at which the attenuation of the deferred shader drops below AttenuationCutoff,
+     * the shading models fall off with color / d^2 and color * radius / (d^2 + 1)
+     */
+    inline float influenceRange(const Light& light)
+    {
+        const auto intensity = glm::max(glm::max(light.mColor.r, light.mColor.g), light.mColor.b) * glm::max(light.mRadius, 1.0f);
+        return glm::sqrt(glm::max(intensity, 0.0f) / AttenuationCutoff);
+    }
 }
 }
\ No newline at end of file
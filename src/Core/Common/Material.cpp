@@ -29,7 +29,25 @@ void Sparkle::Material::initTextureMaterial(std::vector<std::shared_ptr<Sparkle:
     for (const auto& tex : textures) {
         this->textures[tex->type()] = tex; // todo: maybe use a vec to allow multiple of the same type
     }
+    if (this->textures.find(TEX_TYPE_NORMAL) != this->textures.end()) {
+        uniforms.features |= SPARKLE_MAT_NORMAL_MAP;
+    }
+    if (this->textures.find(TEX_TYPE_ROUGHNESS) != this->textures.end() || this->textures.find(TEX_TYPE_METALLIC) != this->textures.end()) {
+        uniforms.features |= SPARKLE_MAT_PBR;
+    }
+
+    // bindless materials share the texture array of the renderer
+    if (App::getHandle().getRenderBackend()->bindlessMaterialsEnabled()) {
+        return;
+    }
+    createDescriptorSet();
+}
 
+void Sparkle::Material::createDescriptorSet()
+{
+    if (initialized) {
+        return;
+    }
     auto device = App::getHandle().getRenderBackend()->getDevice();
     auto texLimit = static_cast<uint32_t>(App::getHandle().getRenderBackend()->getMaterialTextureLimit());
 
@@ -71,6 +89,9 @@ void Sparkle::Material::initTextureMaterial(std::vector<std::shared_ptr<Sparkle:
 
 void Sparkle::Material::updateDescriptorSets()
 {
+    if (!pDescriptorSet) {
+        return;
+    }
     std::vector<VkWriteDescriptorSet> writes;
     if (textures.find(TEX_TYPE_SPECULAR) == textures.end()) {
         throw std::runtime_error("Only textured material supported");
@@ -113,7 +134,6 @@ void Sparkle::Material::updateDescriptorSets()
         auto descriptor = placeholder;
         if (textures.find(TEX_TYPE_NORMAL) != textures.end()) {
             descriptor = textures[TEX_TYPE_NORMAL]->descriptor();
-            uniforms.features |= SPARKLE_MAT_NORMAL_MAP;
         }
         VkWriteDescriptorSet write = {
             VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
@@ -133,7 +153,6 @@ void Sparkle::Material::updateDescriptorSets()
         auto descriptor = placeholder;
         if (textures.find(TEX_TYPE_ROUGHNESS) != textures.end()) {
             descriptor = textures[TEX_TYPE_ROUGHNESS]->descriptor();
-            uniforms.features |= SPARKLE_MAT_PBR;
         }
 
         VkWriteDescriptorSet write = {
@@ -154,7 +173,6 @@ void Sparkle::Material::updateDescriptorSets()
         auto descriptor = placeholder;
         if (textures.find(TEX_TYPE_METALLIC) != textures.end()) {
             descriptor = textures[TEX_TYPE_METALLIC]->descriptor();
-            uniforms.features |= SPARKLE_MAT_PBR;
         }
         VkWriteDescriptorSet write = {
             VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
@@ -40,8 +40,22 @@ public:
     MaterialUniforms getUniforms() const;
 
     VkDescriptorSet getDescriptorSet() const { return pDescriptorSet; }
+    const std::map<size_t, std::shared_ptr<Texture>>& getTextures() const { return textures; }
 
+    /**
+     * entry of the material in the materials buffer of the renderer, only used if bindless materials are enabled
+     */
+    uint32_t getBindlessIndex() const { return bindlessIndex; }
+    void setBindlessIndex(uint32_t index) { bindlessIndex = index; }
+
+    /**
+     * write the textures to the material descriptor set, bindless materials have none and are updated by the renderer
+     */
     void updateDescriptorSets();
+    /**
+     * allocate the material descriptor set, created materials have one unless bindless materials are enabled
+     */
+    void createDescriptorSet();
 
     void cleanup();
 
@@ -50,9 +64,10 @@ private:
 
     VkDescriptorPool pDescriptorPool;
     VkDescriptorSetLayout pDescriptorSetLayout;
-    VkDescriptorSet pDescriptorSet;
+    VkDescriptorSet pDescriptorSet = VK_NULL_HANDLE;
 
     MaterialUniforms uniforms;
+    uint32_t bindlessIndex = 0;
 
     bool initialized = false;
 
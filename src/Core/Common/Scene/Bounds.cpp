@@ -0,0 +1,198 @@
+#include "Bounds.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SPARKLE_BOUNDS_SSE
+#include <xmmintrin.h>
+#endif
+
+using namespace Sparkle;
+using namespace Geometry;
+
+static const glm::vec3& positionAt(const glm::vec3* positions, size_t i, size_t stride)
+{
+	return *reinterpret_cast<const glm::vec3*>(reinterpret_cast<const char*>(positions) + i * stride);
+}
+
+AABB Bounds::computeAABB(const glm::vec3* positions, size_t count, size_t stride)
+{
+	if (count == 0) {
+		return { glm::vec3(0.0f), glm::vec3(0.0f) };
+	}
+#ifdef SPARKLE_BOUNDS_SSE
+	// two independent accumulators hide the latency of min/max
+	const auto load = [positions, stride](size_t i) {
+		const auto& p = positionAt(positions, i, stride);
+		return _mm_setr_ps(p.x, p.y, p.z, p.z);
+	};
+	auto min0 = load(0);
+	auto max0 = min0;
+	auto min1 = min0;
+	auto max1 = min0;
+	size_t i = 1;
+	for (; i + 1 < count; i += 2) {
+		const auto p0 = load(i);
+		const auto p1 = load(i + 1);
+		min0 = _mm_min_ps(min0, p0);
+		max0 = _mm_max_ps(max0, p0);
+		min1 = _mm_min_ps(min1, p1);
+		max1 = _mm_max_ps(max1, p1);
+	}
+	if (i < count) {
+		const auto p = load(i);
+		min0 = _mm_min_ps(min0, p);
+		max0 = _mm_max_ps(max0, p);
+	}
+	alignas(16) float minOut[4];
+	alignas(16) float maxOut[4];
+	_mm_store_ps(minOut, _mm_min_ps(min0, min1));
+	_mm_store_ps(maxOut, _mm_max_ps(max0, max1));
+	return { glm::vec3(minOut[0], minOut[1], minOut[2]), glm::vec3(maxOut[0], maxOut[1], maxOut[2]) };
+#else
+	AABB box = { positionAt(positions, 0, stride), positionAt(positions, 0, stride) };
+	for (size_t i = 1; i < count; ++i) {
+		box.min = glm::min(box.min, positionAt(positions, i, stride));
+		box.max = glm::max(box.max, positionAt(positions, i, stride));
+	}
+	return box;
+#endif
+}
+
+BoundingSphere Bounds::computeSphere(const glm::vec3* positions, size_t count, size_t stride)
+{
+	if (count == 0) {
+		return empty();
+	}
+
+	// points with the smallest and largest coordinate along each axis
+	size_t minIdx[3] = { 0, 0, 0 };
+	size_t maxIdx[3] = { 0, 0, 0 };
+	for (size_t i = 1; i < count; ++i) {
+		const auto& p = positionAt(positions, i, stride);
+		for (int a = 0; a < 3; ++a) {
+			if (p[a] < positionAt(positions, minIdx[a], stride)[a]) {
+				minIdx[a] = i;
+			}
+			if (p[a] > positionAt(positions, maxIdx[a], stride)[a]) {
+				maxIdx[a] = i;
+			}
+		}
+	}
+	int axis = 0;
+	float axisDistance = -1.0f;
+	for (int a = 0; a < 3; ++a) {
+		const auto d = glm::length(positionAt(positions, maxIdx[a], stride) - positionAt(positions, minIdx[a], stride));
+		if (d > axisDistance) {
+			axisDistance = d;
+			axis = a;
+		}
+	}
+
+	// grow the sphere through the most distant pair until it contains every point
+	const auto& p0 = positionAt(positions, minIdx[axis], stride);
+	const auto& p1 = positionAt(positions, maxIdx[axis], stride);
+	auto center = (p0 + p1) * 0.5f;
+	auto radius = axisDistance * 0.5f;
+	for (size_t i = 0; i < count; ++i) {
+		const auto& p = positionAt(positions, i, stride);
+		const auto d = glm::length(p - center);
+		if (d > radius) {
+			const auto grown = (radius + d) * 0.5f;
+			center += (p - center) * ((grown - radius) / d);
+			radius = grown;
+		}
+	}
+
+	const auto box = computeAABB(positions, count, stride);
+	const auto boxCenter = (box.min + box.max) * 0.5f;
+	float boxRadius = 0.0f;
+	for (size_t i = 0; i < count; ++i) {
+		boxRadius = std::max(boxRadius, glm::length(positionAt(positions, i, stride) - boxCenter));
+	}
+	if (boxRadius < radius) {
+		center = boxCenter;
+		radius = boxRadius;
+	}
+
+	// absorb rounding of the incremental updates
+	return { center, radius * (1.0f + 1e-5f) };
+}
+
+BoundingSphere Bounds::merge(const BoundingSphere& a, const BoundingSphere& b)
+{
+	if (a.radius < 0.0f) {
+		return b;
+	}
+	if (b.radius < 0.0f) {
+		return a;
+	}
+	const auto offset = b.center - a.center;
+	const auto distance = glm::length(offset);
+	if (distance + b.radius <= a.radius) {
+		return a;
+	}
+	if (distance + a.radius <= b.radius) {
+		return b;
+	}
+	const auto radius = (distance + a.radius + b.radius) * 0.5f;
+	return { a.center + offset * ((radius - a.radius) / distance), radius };
+}
+
+float Bounds::maxScale(const glm::mat4& model)
+{
+	return std::sqrt(std::max({ glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+	    glm::dot(glm::vec3(model[1]), glm::vec3(model[1])),
+	    glm::dot(glm::vec3(model[2]), glm::vec3(model[2])) }));
+}
+
+BoundingSphere Bounds::transform(const BoundingSphere& sphere, const glm::mat4& model)
+{
+	if (sphere.radius < 0.0f) {
+		return sphere;
+	}
+	return { glm::vec3(model * glm::vec4(sphere.center, 1.0f)), sphere.radius * maxScale(model) };
+}
+
+Bounds::Frustum Bounds::frustumPlanes(const glm::mat4& viewProjection)
+{
+	const auto& m = viewProjection;
+	Frustum planes;
+	for (int i = 0; i < 3; ++i) {
+		planes[i * 2 + 0] = glm::vec4(m[0][3] + m[0][i], m[1][3] + m[1][i], m[2][3] + m[2][i], m[3][3] + m[3][i]);
+		planes[i * 2 + 1] = glm::vec4(m[0][3] - m[0][i], m[1][3] - m[1][i], m[2][3] - m[2][i], m[3][3] - m[3][i]);
+	}
+	// distances to the planes have to be in world units to compare them against radii
+	for (auto& plane : planes) {
+		const auto length = glm::length(glm::vec3(plane));
+		if (length > 0.0f) {
+			plane /= length;
+		}
+	}
+	return planes;
+}
+
+bool Bounds::intersects(const Frustum& frustum, const BoundingSphere& sphere)
+{
+	if (sphere.radius < 0.0f) {
+		return false;
+	}
+	const auto center = glm::vec4(sphere.center, 1.0f);
+	for (const auto& plane : frustum) {
+		if (glm::dot(center, plane) + sphere.radius < 0.0f) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Bounds::coneVisible(const glm::vec4& cone, const BoundingSphere& sphere, const glm::vec3& cameraPos)
+{
+	const auto direction = glm::vec3(cone);
+	if (cone.w >= 1.0f || glm::dot(direction, direction) == 0.0f) {
+		return true;
+	}
+	const auto view = sphere.center - cameraPos;
+	return glm::dot(view, glm::normalize(direction)) < cone.w * glm::length(view) + sphere.radius;
+}
@@ -0,0 +1,59 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <array>
+
+#include <glm/glm.hpp>
+
+#include "SparkleTypes.h"
+
+namespace Sparkle {
+namespace Geometry {
+	struct AABB {
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	/**
+	 * bounding volumes for culling and lod selection, spheres with a negative radius are empty
+	 */
+	class Bounds {
+	public:
+		using Frustum = std::array<glm::vec4, 6>;
+
+		/**
+		 * \param positions first position, further ones follow every stride bytes (e.g. sizeof(Vertex))
+		 */
+		static AABB computeAABB(const glm::vec3* positions, size_t count, size_t stride = sizeof(glm::vec3));
+		/**
+		 * near-optimal sphere: Ritter's sphere seeded with the most distant pair of axis extremes,
+		 * the sphere around the center of the AABB is used instead if it is smaller
+		 */
+		static BoundingSphere computeSphere(const glm::vec3* positions, size_t count, size_t stride = sizeof(glm::vec3));
+
+		static BoundingSphere empty() { return { glm::vec3(0.0f), -1.0f }; }
+		/**
+		 * smallest sphere enclosing both spheres
+		 */
+		static BoundingSphere merge(const BoundingSphere& a, const BoundingSphere& b);
+		/**
+		 * conservative sphere of the transformed sphere, non-uniform scale uses its largest axis
+		 */
+		static BoundingSphere transform(const BoundingSphere& sphere, const glm::mat4& model);
+		static float maxScale(const glm::mat4& model);
+
+		/**
+		 * normalized left, right, bottom, top, near and far planes, inside is positive
+		 */
+		static Frustum frustumPlanes(const glm::mat4& viewProjection);
+		static bool intersects(const Frustum& frustum, const BoundingSphere& sphere);
+		/**
+		 * false if every triangle of a cluster faces away from the camera, the cull shader runs the same test
+		 * \param cone world space facing direction xyz and cutoff w, a cutoff of 1 or a zero direction is never culled
+		 */
+		static bool coneVisible(const glm::vec4& cone, const BoundingSphere& sphere, const glm::vec3& cameraPos);
+	};
+} // namespace Geometry
+} // namespace Sparkle
+
+#endif
@@ -3,31 +3,78 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
+#include <functional>
+#include <tuple>
+
 using namespace Sparkle;
 using namespace Geometry;
 
 Mesh::Mesh(MeshData data, std::shared_ptr<Material> material, std::shared_ptr<Node> parent, glm::mat4 model)
+    : Mesh(data.vertices.data(), data.vertices.size(), data.indices.data(), data.indices.size(), std::move(data.lods), std::move(data.clusters), data.boundingSphere, material, parent, model)
+{
+}
+
+Mesh::Mesh(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, std::vector<Lod> lods, std::vector<Cluster> clusters, BoundingSphere bounds, std::shared_ptr<Material> material, std::shared_ptr<Node> parent, glm::mat4 model)
 {
 	this->model = model;
+	this->initialModel = model;
 	this->material = material;
 	this->parent = parent;
-	this->boundingSphere = data.boundingSphere;
+	this->boundingSphere = bounds;
+	this->lods = std::move(lods);
+	if (this->lods.empty()) {
+		this->lods.push_back({ 0, static_cast<uint32_t>(indexCount), 0.0f });
+	}
+	if (clusters.empty()) {
+		// a single cluster spanning lod 0 that is never cone culled
+		clusters.push_back({ 0, this->lods.front().indexCount, bounds, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f) });
+	}
+	this->clusters = std::make_shared<const std::vector<Cluster>>(std::move(clusters));
 	if (material) { // only upload drawable meshes to gpu!
-		meshFromVertsAndIndices(data.vertices, data.indices);
+		meshFromVertsAndIndices(vertices, vertexCount, indices, indexCount);
 	}
 }
 
+Mesh::Mesh(const Mesh& geometry, std::shared_ptr<Node> parent, glm::mat4 model)
+{
+	this->model = model;
+	this->initialModel = model;
+	this->material = geometry.material;
+	this->parent = parent;
+	this->boundingSphere = geometry.boundingSphere;
+	this->ID = geometry.ID;
+	this->bufferOffset = geometry.bufferOffset;
+	this->lods = geometry.lods;
+	this->clusters = geometry.clusters;
+}
+
 void Node::translate(glm::vec3 pos)
 {
 	model = glm::translate(model, pos);
 }
 
-void Mesh::meshFromVertsAndIndices(std::vector<Vertex> verts, std::vector<uint32_t> inds)
+void Mesh::meshFromVertsAndIndices(const Vertex* verts, size_t vertexCount, const uint32_t* inds, size_t count)
 {
-	vertices = verts;
-	indices = inds;
+	bufferOffset = App::getHandle().uploadMeshGPU(verts, vertexCount, inds, count);
+}
 
-	bufferOffset = App::getHandle().uploadMeshGPU(this);
+uint32_t Mesh::selectLod(const glm::vec3& cameraPos, float lodScale)
+{
+	const auto world = accumModel();
+	const auto bounds = Bounds::transform(boundingSphere, world);
+	const auto scale = Bounds::maxScale(world);
+	// distance to the closest point of the bounding sphere, the camera inside the sphere always gets lod 0
+	const auto distance = glm::length(bounds.center - cameraPos) - bounds.radius;
+	if (distance <= 0.0f) {
+		return 0;
+	}
+	for (auto lod = static_cast<uint32_t>(lods.size()) - 1; lod > 0; --lod) {
+		if (lods[lod].error * scale * lodScale <= distance) {
+			return lod;
+		}
+	}
+	return 0;
 }
 
 glm::mat4 Node::accumModel()
@@ -42,6 +89,15 @@ glm::mat4 Node::accumModel()
 	return cachedModel;
 }
 
+const BoundingSphere& Node::updateBounds()
+{
+	worldBounds = drawable() ? Bounds::transform(getBounds(), accumModel()) : Bounds::empty();
+	for (const auto& c : children) {
+		worldBounds = Bounds::merge(worldBounds, c->updateBounds());
+	}
+	return worldBounds;
+}
+
 std::vector<std::shared_ptr<Node>> Node::getDrawableSceneAsFlatVec()
 {
 	std::vector<std::shared_ptr<Node>> nodes;
@@ -57,15 +113,120 @@ std::vector<std::shared_ptr<Node>> Node::getDrawableSceneAsFlatVec()
 	return nodes;
 }
 
-const std::vector<std::shared_ptr<Node>> Scene::getRenderableScene()
+void Scene::updateDrawableCache(bool append)
+{
+	auto nodes = root->getDrawableSceneAsFlatVec();
+	if (!append) {
+		drawableSceneCache.clear();
+		drawableIndex.clear();
+		drawBatchCache.clear();
+	}
+
+	// group instances of the same geometry, batches of an index type keep the order in which their geometry first appears
+	std::vector<std::vector<std::shared_ptr<Mesh>>> groups;
+	std::map<std::tuple<size_t, size_t, size_t, const Material*>, size_t> groupLookup;
+	for (const auto& node : nodes) {
+		const auto mesh = std::dynamic_pointer_cast<Mesh, Node>(node);
+		if (!mesh || drawableIndex.count(mesh.get()) > 0) {
+			continue;
+		}
+		const auto key = std::make_tuple(mesh->bufferOffset.vertexOffs, mesh->bufferOffset.indexOffs, mesh->size(), mesh->getMaterial().get());
+		const auto group = groupLookup.emplace(key, groups.size());
+		if (group.second) {
+			groups.emplace_back();
+		}
+		groups[group.first->second].push_back(mesh);
+	}
+	// draws with 16 bit indices come first, the index buffer is only rebound when the index type changes
+	std::stable_partition(groups.begin(), groups.end(), [](const std::vector<std::shared_ptr<Mesh>>& group) {
+		return group.front()->bufferOffset.indexType == VK_INDEX_TYPE_UINT16;
+	});
+
+	drawableSceneCache.reserve(nodes.size());
+	drawBatchCache.reserve(drawBatchCache.size() + groups.size());
+	uint32_t commandCount = drawBatchCache.empty() ? 0 : drawBatchCache.back().firstCommand + drawBatchCache.back().commandCount;
+	for (const auto& group : groups) {
+		const auto instanceCount = static_cast<uint32_t>(group.size());
+		const auto batchCommands = instanceCount * static_cast<uint32_t>(group.front()->getClusters().size());
+		drawBatchCache.push_back({ group.front(), static_cast<uint32_t>(drawableSceneCache.size()), instanceCount, 0, true, commandCount, batchCommands });
+		for (const auto& mesh : group) {
+			drawableIndex[mesh.get()] = drawableSceneCache.size();
+			drawableSceneCache.push_back(mesh);
+		}
+		commandCount += batchCommands;
+	}
+
+	root->updateBounds();
+}
+
+void Scene::refreshDrawableCache()
 {
 	if (cacheDirty) {
-		drawableSceneCache = root->getDrawableSceneAsFlatVec();
-		cacheDirty = false;
+		updateDrawableCache();
+	} else if (appendPending) {
+		updateDrawableCache(true);
 	}
+	cacheDirty = false;
+	appendPending = false;
+}
+
+const std::vector<std::shared_ptr<Node>> Scene::getRenderableScene()
+{
+	refreshDrawableCache();
 	return drawableSceneCache;
 }
 
+const std::vector<Scene::DrawBatch>& Scene::getDrawBatches()
+{
+	refreshDrawableCache();
+	return drawBatchCache;
+}
+
+bool Scene::selectLods(const glm::vec3& cameraPos, float lodScale)
+{
+	refreshDrawableCache();
+	bool changed = false;
+	for (auto& batch : drawBatchCache) {
+		auto lod = static_cast<uint32_t>(batch.mesh->getLods().size()) - 1;
+		for (uint32_t i = 0; i < batch.instanceCount && lod > 0; ++i) {
+			const auto mesh = std::static_pointer_cast<Mesh, Node>(drawableSceneCache[batch.firstInstance + i]);
+			lod = std::min(lod, mesh->selectLod(cameraPos, lodScale));
+		}
+		changed |= lod != batch.lod;
+		batch.lod = lod;
+	}
+	return changed;
+}
+
+bool Scene::cullBatches(const Bounds::Frustum& frustum)
+{
+	refreshDrawableCache();
+	std::vector<bool> visible(drawableSceneCache.size(), false);
+	const std::function<void(const Node&)> markVisible = [&](const Node& node) {
+		if (!Bounds::intersects(frustum, node.getWorldBounds())) {
+			return;
+		}
+		const auto index = drawableIndex.find(&node);
+		if (index != drawableIndex.end()) {
+			const auto mesh = drawableSceneCache[index->second];
+			visible[index->second] = Bounds::intersects(frustum, Bounds::transform(mesh->getBounds(), mesh->accumModel()));
+		}
+		for (const auto& c : node.getChildren()) {
+			markVisible(*c);
+		}
+	};
+	markVisible(*root);
+
+	bool changed = false;
+	for (auto& batch : drawBatchCache) {
+		const auto first = visible.begin() + batch.firstInstance;
+		const bool batchVisible = std::find(first, first + batch.instanceCount, true) != first + batch.instanceCount;
+		changed |= batchVisible != batch.visible;
+		batch.visible = batchVisible;
+	}
+	return changed;
+}
+
 size_t Scene::objectCount()
 {
 	return drawableSceneCache.size();
@@ -11,6 +11,8 @@
 #include <vector>
 #include <map>
 
+#include "Bounds.h"
+#include "Lights.h"
 #include "Material.h"
 #include "SparkleTypes.h"
 #include "Texture.h"
@@ -78,8 +80,22 @@ namespace Geometry {
 
 		virtual std::shared_ptr<Material> getMaterial() const { return material; }
 
+		/**
+		 * object space bounds of the geometry of this node itself
+		 */
+		virtual BoundingSphere getBounds() const { return Bounds::empty(); }
+		/**
+		 * world space bounds of this node and everything below it as of the last updateBounds
+		 */
+		const BoundingSphere& getWorldBounds() const { return worldBounds; }
+		/**
+		 * recompute the world bounds of the subtree from the geometry bounds and transforms
+		 */
+		const BoundingSphere& updateBounds();
+
 		std::vector<std::shared_ptr<Node>> getDrawableSceneAsFlatVec();
 
+		const std::vector<std::shared_ptr<Node>>& getChildren() const { return children; }
 		void addChild(std::shared_ptr<Node> child) { children.push_back(child); }
 		void setChildren(std::vector<std::shared_ptr<Node>>& nodes)
 		{
@@ -107,29 +123,61 @@ namespace Geometry {
 
 		glm::mat4 cachedModel;
 		bool dirty = true;
+
+		BoundingSphere worldBounds = Bounds::empty();
 	};
 
 	class Mesh : public Node {
 	public:
 		struct BufferOffset {
 			size_t vertexOffs;
-			size_t indexOffs;
+			size_t indexOffs; // in indices of indexType, relative to the index region of that type
+			VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+			glm::mat4 positionTransform = glm::mat4(1.0f); // object space from the stored positions, see VertexPacking
+		};
+
+		/**
+		 * index range of one level of detail, all lods of a mesh share its vertices
+		 */
+		struct Lod {
+			uint32_t firstIndex; // relative to the first index of the mesh
+			uint32_t indexCount;
+			float error; // object space deviation from lod 0
+		};
+		static constexpr size_t MaxLods = 4;
+
+		/**
+		 * consecutive triangles of lod 0 that are culled and drawn on their own with gpu culling
+		 */
+		struct Cluster {
+			uint32_t firstIndex; // relative to the first index of the mesh
+			uint32_t indexCount;
+			BoundingSphere boundingSphere;
+			glm::vec4 cone; // xyz facing direction, w cutoff, culled if dot(center - camera, xyz) >= w * distance + radius
 		};
 
 		struct MeshData {
 			std::vector<Vertex> vertices;
-			std::vector<uint32_t> indices;
+			std::vector<uint32_t> indices; // all lods, back to back
+			std::vector<Lod> lods; // empty if the mesh only has one lod spanning all indices
+			std::vector<Cluster> clusters; // empty if lod 0 is not split
 			BoundingSphere boundingSphere;
 		};
 
 		Mesh(MeshData data, std::shared_ptr<Material> material, std::shared_ptr<Node> parent = nullptr, glm::mat4 model = glm::mat4(1.0f));
+		/**
+		 * creates the mesh from externally owned data (e.g. a mapped level file), the data is only read during upload
+		 */
+		Mesh(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, std::vector<Lod> lods, std::vector<Cluster> clusters, BoundingSphere bounds, std::shared_ptr<Material> material, std::shared_ptr<Node> parent = nullptr, glm::mat4 model = glm::mat4(1.0f));
+		/**
+		 * creates another instance of already uploaded geometry, only the transform is stored per instance
+		 */
+		Mesh(const Mesh& geometry, std::shared_ptr<Node> parent, glm::mat4 model = glm::mat4(1.0f));
 
 		bool drawable() { return Node::drawable(); }
 
 		std::shared_ptr<Material> getMaterial() { return Node::getMaterial(); }
 
-		std::vector<Vertex> vertices;
-		std::vector<uint32_t> indices;
 		/**
 			 * offset of the vertices and indices in the bound draw buffer
 			 */
@@ -150,20 +198,51 @@ namespace Geometry {
 			return model;
 		}
 
-		auto getBounds() const { return boundingSphere; }
+		BoundingSphere getBounds() const override { return boundingSphere; }
 
-		size_t size() const { return indices.size(); }
+		/**
+		 * index count of lod 0
+		 */
+		size_t size() const { return lods.empty() ? 0 : lods.front().indexCount; }
+
+		const std::vector<Lod>& getLods() const { return lods; }
+		/**
+		 * clusters of lod 0, shared by all instances of the geometry
+		 */
+		const std::vector<Cluster>& getClusters() const { return *clusters; }
+
+		/**
+		 * coarsest lod whose error stays below the threshold on screen, matches the selection in cull.comp
+		 * \param lodScale pixels per world unit at distance 1 divided by the error threshold in pixels
+		 */
+		uint32_t selectLod(const glm::vec3& cameraPos, float lodScale);
 
 	private:
 		glm::mat4 initialModel;
 
 		BoundingSphere boundingSphere;
 
-		void meshFromVertsAndIndices(std::vector<Vertex> verts, std::vector<uint32_t> inds);
+		std::vector<Lod> lods;
+		std::shared_ptr<const std::vector<Cluster>> clusters;
+
+		void meshFromVertsAndIndices(const Vertex* verts, size_t vertexCount, const uint32_t* inds, size_t count);
 	};
 
 	class Scene {
 	public:
+		/**
+		 * consecutive renderable scene entries sharing geometry and material, drawn with one instanced draw
+		 */
+		struct DrawBatch {
+			std::shared_ptr<Mesh> mesh;
+			uint32_t firstInstance;
+			uint32_t instanceCount;
+			uint32_t lod; // used by draws without gpu culling
+			bool visible; // any instance intersects the frustum, used by draws without gpu culling
+			uint32_t firstCommand; // indirect draw commands written by gpu culling, one per cluster and instance
+			uint32_t commandCount;
+		};
+
 		Scene()
 		{
 			root = std::make_shared<Node>(/*model*/);
@@ -174,11 +253,50 @@ namespace Geometry {
 			return root;
 		}
 
+		/**
+		 * all drawable nodes, instances of the same geometry are stored next to each other
+		 */
 		const std::vector<std::shared_ptr<Node>> getRenderableScene();
+		const std::vector<DrawBatch>& getDrawBatches();
 		size_t objectCount();
 
+		/**
+		 * select the lod of every draw batch by its closest instance
+		 * \return true if any batch changed its lod
+		 */
+		bool selectLods(const glm::vec3& cameraPos, float lodScale);
+		/**
+		 * mark the draw batches with at least one instance inside the frustum, subtrees outside of it are skipped
+		 * \return true if the visibility of any batch changed
+		 */
+		bool cullBatches(const Bounds::Frustum& frustum);
+
 		void cleanup();
 		void setDirty() { cacheDirty = true; }
+		/**
+		 * drawables were attached, they are appended as batches of their own and existing instances keep their place
+		 * until the next setDirty groups all instances again
+		 */
+		void setAppended() { appendPending = true; }
+
+		/**
+		 * world space lights of the level, imported once per scene
+		 */
+		const std::vector<Lights::Light>& getLights() const { return lights; }
+		void setLights(std::vector<Lights::Light> sceneLights)
+		{
+			lights = std::move(sceneLights);
+			lightsDirty = true;
+		}
+		/**
+		 * true once after the lights were replaced, the renderer re-uploads them then
+		 */
+		bool takeLightsDirty()
+		{
+			const auto dirty = lightsDirty;
+			lightsDirty = false;
+			return dirty;
+		}
 
 		std::vector<std::shared_ptr<Texture>> textureCache;
 		std::vector<std::shared_ptr<Material>> materialCache;
@@ -187,7 +305,19 @@ namespace Geometry {
 		std::shared_ptr<Node> root;
 
 		std::vector<std::shared_ptr<Node>> drawableSceneCache;
+		std::map<const Node*, size_t> drawableIndex; // position in drawableSceneCache
+		std::vector<DrawBatch> drawBatchCache;
 		bool cacheDirty = false;
+		bool appendPending = false;
+
+		std::vector<Lights::Light> lights;
+		bool lightsDirty = false;
+
+		/**
+		 * \param append only group the drawables missing in the cache and add them behind the existing batches
+		 */
+		void updateDrawableCache(bool append = false);
+		void refreshDrawableCache();
 
 	};
 } // namespace Geometry
@@ -0,0 +1,182 @@
+#include "VertexPacking.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace Sparkle;
+using namespace Geometry;
+
+static uint32_t toSnorm(float value, float scale, uint32_t mask)
+{
+	return static_cast<uint32_t>(static_cast<int32_t>(std::round(std::clamp(value, -1.0f, 1.0f) * scale))) & mask;
+}
+
+static uint16_t toUnorm16(float value)
+{
+	return static_cast<uint16_t>(std::round(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+/*
+ * maps the unit sphere onto [-1, 1]^2, the lower hemisphere is folded over the diagonals
+ */
+static glm::vec2 octahedral(const glm::vec3& direction)
+{
+	const auto l1 = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+	if (l1 <= 0.0f) {
+		return glm::vec2(0.0f);
+	}
+	auto p = glm::vec2(direction.x, direction.y) / l1;
+	if (direction.z < 0.0f) {
+		p = glm::vec2((1.0f - std::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+		    (1.0f - std::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+	}
+	return p;
+}
+
+static uint32_t packHalf2(const glm::vec2& v)
+{
+	return static_cast<uint32_t>(VertexPacking::toHalf(v.x)) | (static_cast<uint32_t>(VertexPacking::toHalf(v.y)) << 16);
+}
+
+VertexFormat VertexPacking::parseFormat(const std::string& name)
+{
+	if (name == "Compact") {
+		return VertexFormat::Compact;
+	}
+	if (name == "Quantized") {
+		return VertexFormat::Quantized;
+	}
+	return VertexFormat::Full;
+}
+
+size_t VertexPacking::stride(VertexFormat format)
+{
+	switch (format) {
+	case VertexFormat::Compact:
+		return sizeof(CompactVertex);
+	case VertexFormat::Quantized:
+		return sizeof(QuantizedVertex);
+	default:
+		return sizeof(Vertex);
+	}
+}
+
+std::vector<VkVertexInputBindingDescription> VertexPacking::getBindingDescriptions(VertexFormat format)
+{
+	return { { 0, static_cast<uint32_t>(stride(format)), VK_VERTEX_INPUT_RATE_VERTEX } };
+}
+
+std::vector<VkVertexInputAttributeDescription> VertexPacking::getAttributeDescriptions(VertexFormat format)
+{
+	switch (format) {
+	case VertexFormat::Compact:
+		return {
+			{ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(CompactVertex, position) },
+			{ 1, 0, VK_FORMAT_R16G16_SNORM, offsetof(CompactVertex, normal) },
+			{ 2, 0, VK_FORMAT_R8G8B8A8_SNORM, offsetof(CompactVertex, tangent) },
+			{ 4, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(CompactVertex, texCoord) }
+		};
+	case VertexFormat::Quantized:
+		return {
+			{ 0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(QuantizedVertex, position) },
+			{ 1, 0, VK_FORMAT_R16G16_SNORM, offsetof(QuantizedVertex, normal) },
+			{ 2, 0, VK_FORMAT_R8G8B8A8_SNORM, offsetof(QuantizedVertex, tangent) },
+			{ 4, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(QuantizedVertex, texCoord) }
+		};
+	default: {
+		const auto attributes = Vertex::getAttributeDescriptions();
+		return std::vector<VkVertexInputAttributeDescription>(attributes.begin(), attributes.end());
+	}
+	}
+}
+
+void VertexPacking::pack(const Vertex* vertices, size_t count, VertexFormat format, const AABB& box, std::vector<unsigned char>& out)
+{
+	out.resize(count * stride(format));
+	if (format == VertexFormat::Full) {
+		std::memcpy(out.data(), vertices, out.size());
+		return;
+	}
+
+	const auto extent = box.max - box.min;
+	const auto invExtent = glm::vec3(extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+	    extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+	    extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+	for (size_t i = 0; i < count; ++i) {
+		const auto& vtx = vertices[i];
+		const auto normal = encodeOctahedral16(vtx.normal);
+		const auto tangent = encodeTangent(vtx.normal, vtx.tangent, vtx.bitangent);
+		const auto texCoord = packHalf2(vtx.texCoord);
+		if (format == VertexFormat::Compact) {
+			const CompactVertex packed = { vtx.position, normal, tangent, texCoord };
+			std::memcpy(out.data() + i * sizeof(CompactVertex), &packed, sizeof(CompactVertex));
+		} else {
+			const auto p = (vtx.position - box.min) * invExtent;
+			const QuantizedVertex packed = { { toUnorm16(p.x), toUnorm16(p.y), toUnorm16(p.z), 0 }, normal, tangent, texCoord };
+			std::memcpy(out.data() + i * sizeof(QuantizedVertex), &packed, sizeof(QuantizedVertex));
+		}
+	}
+}
+
+glm::mat4 VertexPacking::positionTransform(VertexFormat format, const AABB& box)
+{
+	if (format != VertexFormat::Quantized) {
+		return glm::mat4(1.0f);
+	}
+	return glm::scale(glm::translate(glm::mat4(1.0f), box.min), box.max - box.min);
+}
+
+uint32_t VertexPacking::encodeOctahedral16(const glm::vec3& direction)
+{
+	const auto p = octahedral(direction);
+	return toSnorm(p.x, 32767.0f, 0xffff) | (toSnorm(p.y, 32767.0f, 0xffff) << 16);
+}
+
+uint32_t VertexPacking::encodeTangent(const glm::vec3& normal, const glm::vec3& tangent, const glm::vec3& bitangent)
+{
+	// handedness of the tangent frame, the shader rebuilds the bitangent as cross(normal, tangent) * sign
+	const auto sign = glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+	const auto p = octahedral(tangent);
+	return toSnorm(p.x, 127.0f, 0xff) | (toSnorm(p.y, 127.0f, 0xff) << 8) | (toSnorm(sign, 127.0f, 0xff) << 16);
+}
+
+uint16_t VertexPacking::toHalf(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+	const auto exponent = static_cast<int32_t>((bits >> 23) & 0xff);
+	auto mantissa = bits & 0x7fffff;
+
+	if (exponent == 0xff) { // inf and nan
+		return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+	}
+	const auto halfExponent = exponent - 127 + 15;
+	if (halfExponent >= 0x1f) { // overflow
+		return sign | 0x7c00;
+	}
+	if (halfExponent <= 0) { // subnormal or zero
+		if (halfExponent < -10) {
+			return sign;
+		}
+		mantissa |= 0x800000;
+		const auto shift = static_cast<uint32_t>(14 - halfExponent);
+		auto half = mantissa >> shift;
+		// round to nearest, ties to even
+		const auto rest = mantissa & ((1u << shift) - 1);
+		const auto halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1))) {
+			++half;
+		}
+		return sign | static_cast<uint16_t>(half);
+	}
+	auto half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+	const auto rest = mantissa & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+		++half; // may carry into the exponent, which correctly rounds up to the next power of two or inf
+	}
+	return sign | static_cast<uint16_t>(half);
+}
@@ -0,0 +1,72 @@
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include <string>
+#include <vector>
+
+#include "Geometry.h"
+
+namespace Sparkle {
+namespace Geometry {
+	/**
+	 * layout of the vertices in the draw buffer, meshes are always imported and stored as Vertex
+	 */
+	enum class VertexFormat {
+		Full, // Vertex, 56 bytes
+		Compact, // CompactVertex, 24 bytes
+		Quantized // QuantizedVertex, 20 bytes
+	};
+
+	/**
+	 * the bitangent is rebuilt from normal, tangent and its sign in the vertex shader
+	 */
+	struct CompactVertex {
+		glm::vec3 position;
+		uint32_t normal; // octahedral, snorm16 x2
+		uint32_t tangent; // octahedral snorm8 x2, bitangent sign in the third byte
+		uint32_t texCoord; // half x2
+	};
+
+	/**
+	 * CompactVertex with positions stored relative to the bounds of the mesh,
+	 * the instance transform maps them back to object space
+	 */
+	struct QuantizedVertex {
+		uint16_t position[4]; // unorm16 xyz, w unused
+		uint32_t normal;
+		uint32_t tangent;
+		uint32_t texCoord;
+	};
+
+	class VertexPacking {
+	public:
+		/**
+		 * "Full", "Compact" or "Quantized", unknown names select Full
+		 */
+		static VertexFormat parseFormat(const std::string& name);
+		static size_t stride(VertexFormat format);
+
+		static std::vector<VkVertexInputBindingDescription> getBindingDescriptions(VertexFormat format);
+		/**
+		 * all formats feed position, normal, tangent and uv at locations 0, 1, 2 and 4, only Full has the bitangent at 3
+		 */
+		static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(VertexFormat format);
+
+		/**
+		 * converts the vertices to the format, quantized positions are stored relative to box
+		 * \param out receives count * stride(format) bytes
+		 */
+		static void pack(const Vertex* vertices, size_t count, VertexFormat format, const AABB& box, std::vector<unsigned char>& out);
+		/**
+		 * object space transform of the stored positions, identity unless they are quantized
+		 */
+		static glm::mat4 positionTransform(VertexFormat format, const AABB& box);
+
+		static uint32_t encodeOctahedral16(const glm::vec3& direction);
+		static uint32_t encodeTangent(const glm::vec3& normal, const glm::vec3& tangent, const glm::vec3& bitangent);
+		static uint16_t toHalf(float value);
+	};
+} // namespace Geometry
+} // namespace Sparkle
+
+#endif
@@ -4,8 +4,21 @@
 #include "FileReader.h"
 #include "stb_image.h"
 
+#include <algorithm>
+
 using namespace Sparkle;
 
+/*
+ * the values of gli::format are the VkFormat values up to the astc formats
+ */
+static VkFormat toVkFormat(gli::format format)
+{
+    if (format == gli::FORMAT_UNDEFINED || format > gli::FORMAT_RGBA_ASTC_12X12_SRGB_BLOCK16) {
+        throw std::runtime_error("Texture format " + std::to_string(static_cast<int>(format)) + " has no Vulkan equivalent");
+    }
+    return static_cast<VkFormat>(format);
+}
+
 Texture::Texture(std::string filePath, size_t typeID)
     : filePath(filePath)
     , typeID(typeID)
@@ -14,14 +27,7 @@ Texture::Texture(std::string filePath, size_t typeID)
     if (!tex.imageData) {
         throw std::runtime_error("Unable to load texture from: " + filePath);
     }
-    if (tex.imageFileType == Tools::FileReader::ImageType::SPARKLE_IMAGE_DDS) {
-        width = tex.width;
-        height = tex.height;
-        channels = 4; /* tex.channels; */
-        initFromData(tex.imageData, static_cast<VkDeviceSize>(tex.size), VK_FORMAT_BC2_UNORM_BLOCK, -1);
-    } else {
-        initFromData(tex.imageData, tex.width, tex.height, 4 /*channels*/, VK_FORMAT_R8G8B8A8_UNORM);
-    }
+    initFromImage(tex);
 
     tex.free();
 }
@@ -36,6 +42,19 @@ Sparkle::Texture::Texture(const aiTexture* tex, size_t typeID, std::string id)
     initFromData(stbiTex, w, h, 4 /*c*/);
 }
 
+Texture::Texture(const unsigned char* encoded, size_t size, size_t typeID, std::string id)
+    : filePath(id)
+    , typeID(typeID)
+{
+    int w, h, c;
+    auto stbiTex = stbi_load_from_memory(encoded, static_cast<int>(size), &w, &h, &c, STBI_rgb_alpha);
+    if (!stbiTex) {
+        throw std::runtime_error("Unable to decode texture: " + id);
+    }
+    initFromData(stbiTex, w, h, 4);
+    stbi_image_free(stbiTex);
+}
+
 Texture::Texture(void* data, int width, int height, int channels, size_t typeID, std::string id)
     : filePath(id)
     , typeID(typeID)
@@ -43,7 +62,34 @@ Texture::Texture(void* data, int width, int height, int channels, size_t typeID,
     initFromData(data, width, height, channels);
 }
 
-void Texture::initFromData(void* data, int w, int h, int c, VkFormat imageFormat, int m)
+Texture::Texture(const Tools::FileReader::ImageFile& image, size_t typeID, std::string id)
+    : filePath(id)
+    , typeID(typeID)
+{
+    if (!image.imageData) {
+        throw std::runtime_error("No image data for texture: " + id);
+    }
+    initFromImage(image);
+}
+
+void Texture::initFromImage(const Tools::FileReader::ImageFile& image)
+{
+    if (image.imageFileType != Tools::FileReader::ImageType::SPARKLE_IMAGE_OTHER) {
+        width = image.width;
+        height = image.height;
+        channels = static_cast<int>(gli::component_count(image.tex.format()));
+        if (image.mipLevels.size() > 1 && App::getHandle().getRenderBackend()->getTextureStreaming().enabled()) {
+            // shares the storage of the image, freeing the image keeps it alive
+            source = image.tex;
+            sourceLevels = image.mipLevels;
+        }
+        initFromData(image.imageData, static_cast<VkDeviceSize>(image.size), toVkFormat(image.tex.format()), image.mipLevels);
+    } else {
+        initFromData(image.imageData, image.width, image.height, 4 /*channels*/, VK_FORMAT_R8G8B8A8_UNORM);
+    }
+}
+
+void Texture::initFromData(void* data, int w, int h, int c, VkFormat imageFormat)
 {
     width = w;
     height = h;
@@ -53,73 +99,219 @@ void Texture::initFromData(void* data, int w, int h, int c, VkFormat imageFormat
     if (texSize == 0)
         return;
 
-    initFromData(data, texSize, imageFormat, m);
+    initFromData(data, texSize, imageFormat, {});
 }
 
-void Texture::initFromData(void* data, VkDeviceSize s, VkFormat format, int m)
+uint32_t Texture::mipLevelCount(uint32_t width, uint32_t height)
+{
+    uint32_t levels = 1;
+    for (auto size = std::max(width, height); size > 1; size >>= 1) {
+        ++levels;
+    }
+    return levels;
+}
+
+void Texture::initFromData(void* data, VkDeviceSize s, VkFormat imageFormat, const std::vector<Tools::FileReader::ImageMipLevel>& levels)
 {
     auto context = App::getHandle().getRenderBackend();
+    format = imageFormat;
 
-    vkExt::Buffer staging;
-    vkExt::SharedMemory* stagingMem = new vkExt::SharedMemory();
+    // block compressed formats can not be blitted, they only get the levels stored in the file
+    const auto generateMips = levels.size() <= 1 && context->supportsLinearBlit(format);
+    if (generateMips) {
+        mipLevels = mipLevelCount(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+    } else {
+        mipLevels = std::max(static_cast<uint32_t>(levels.size()), 1u);
+    }
 
-    context->createBuffer(s, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging, stagingMem);
+    // streamed textures start with the small levels, the renderer requests the others once they are seen
+    upload(static_cast<const unsigned char*>(data), s, levels, streamable() ? baseLevel() : 0, generateMips);
+    texImageSampler = context->getSamplerCache().get();
+}
 
-    staging.map();
-    staging.copyTo(data, static_cast<size_t>(s));
-    staging.unmap();
+void Texture::upload(const unsigned char* data, VkDeviceSize s, const std::vector<Tools::FileReader::ImageMipLevel>& levels, uint32_t firstLevel, bool generateMips)
+{
+    auto context = App::getHandle().getRenderBackend();
+
+    // levels are stored from the finest to the coarsest, skip the ones that are not resident
+    VkDeviceSize skipped = 0;
+    for (uint32_t i = 0; i < firstLevel; ++i) {
+        skipped += levels[i].size;
+    }
+    const auto residentLevels = mipLevels - firstLevel;
+    const auto imageWidth = levels.empty() ? static_cast<uint32_t>(width) : static_cast<uint32_t>(levels[firstLevel].width);
+    const auto imageHeight = levels.empty() ? static_cast<uint32_t>(height) : static_cast<uint32_t>(levels[firstLevel].height);
+
+    auto& stagingRing = context->getStagingRing();
+    const auto staged = stagingRing.stage(data + skipped, s - skipped);
 
     texMemory = new vkExt::SharedMemory();
-    context->createImage2D(width, height, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texImage, texMemory);
-    context->transitionImageLayout(texImage.image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    if (m <= -1) {
-        staging.copyBufferToImage(context->getCommandPool(), context->getDefaultQueue(), texImage.image, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    // streamed images are the source of their replacements
+    if (generateMips || streamable()) {
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+    context->createImage2D(imageWidth, imageHeight, format, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texImage, texMemory, 0, VK_IMAGE_LAYOUT_UNDEFINED, residentLevels);
+    // recorded into the staging batch, the image is ready for the graphics queue once the batch was submitted before the next frame
+    const auto cmdBuffer = stagingRing.commandBuffer();
+    context->transitionImageLayout(texImage.image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, cmdBuffer, residentLevels);
+    std::vector<VkBufferImageCopy> copyRegions;
+    if (levels.empty()) {
+        VkBufferImageCopy region {};
+        region.bufferOffset = staged.offset;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { imageWidth, imageHeight, 1 };
+        copyRegions.push_back(region);
     } else {
-        std::vector<VkBufferImageCopy> copyRegions;
-        for (uint32_t i = 0; i < static_cast<uint32_t>(m); ++i) {
+        VkDeviceSize offset = staged.offset;
+        for (uint32_t i = firstLevel; i < static_cast<uint32_t>(levels.size()); ++i) {
             VkBufferImageCopy region {};
+            region.bufferOffset = offset;
             region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            region.imageSubresource.mipLevel = i;
+            region.imageSubresource.mipLevel = i - firstLevel;
             region.imageSubresource.baseArrayLayer = 0;
             region.imageSubresource.layerCount = 1;
-            // region.imageExtent.width =
-            // FIXME!
+            region.imageExtent = { static_cast<uint32_t>(levels[i].width), static_cast<uint32_t>(levels[i].height), 1 };
+            copyRegions.push_back(region);
+            offset += levels[i].size;
+        }
+    }
+    vkCmdCopyBufferToImage(cmdBuffer, staged.buffer, texImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+    if (generateMips) {
+        // upload queues may not support blits
+        stagingRing.releaseImage(texImage.image, residentLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        context->generateMipmaps(texImage.image, imageWidth, imageHeight, residentLevels, stagingRing.graphicsCommandBuffer());
+    } else {
+        stagingRing.releaseImage(texImage.image, residentLevels, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+
+    texImageView = context->createImageView2D(texImage.image, format, VK_IMAGE_ASPECT_COLOR_BIT, residentLevels);
+    firstResidentLevel = firstLevel;
+}
+
+uint32_t Texture::baseLevel() const
+{
+    uint32_t level = 0;
+    while (level + 1 < mipLevels && levelExtent(level) > StreamingBaseSize) {
+        ++level;
+    }
+    return level;
+}
+
+uint32_t Texture::levelExtent(uint32_t level) const
+{
+    return std::max(static_cast<uint32_t>(std::max(width, height)) >> level, 1u);
+}
+
+VkDeviceSize Texture::levelSize(uint32_t level) const
+{
+    if (level < sourceLevels.size()) {
+        return sourceLevels[level].size;
+    }
+    const VkDeviceSize extent = levelExtent(level);
+    return extent * extent * static_cast<VkDeviceSize>(channels);
+}
+
+void Texture::replaceResidentLevel(uint32_t level)
+{
+    level = std::min(level, baseLevel());
+    if (!streamable() || replacementPending() || level == firstResidentLevel) {
+        return;
+    }
+    auto context = App::getHandle().getRenderBackend();
+    auto& stagingRing = context->getStagingRing();
+
+    const auto residentLevels = mipLevels - level;
+    const auto imageWidth = static_cast<uint32_t>(sourceLevels[level].width);
+    const auto imageHeight = static_cast<uint32_t>(sourceLevels[level].height);
+    replacement.memory = new vkExt::SharedMemory();
+    context->createImage2D(imageWidth, imageHeight, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, replacement.image, replacement.memory, 0, VK_IMAGE_LAYOUT_UNDEFINED, residentLevels);
+
+    if (level < firstResidentLevel) {
+        // only the levels finer than the current image are uploaded
+        VkDeviceSize skipped = 0;
+        for (uint32_t i = 0; i < level; ++i) {
+            skipped += sourceLevels[i].size;
+        }
+        VkDeviceSize bytes = 0;
+        for (auto i = level; i < firstResidentLevel; ++i) {
+            bytes += sourceLevels[i].size;
+        }
+        const auto staged = stagingRing.stage(static_cast<const unsigned char*>(source.data()) + skipped, bytes);
+        const auto cmdBuffer = stagingRing.commandBuffer();
+        context->transitionImageLayout(replacement.image.image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, cmdBuffer, residentLevels);
+        std::vector<VkBufferImageCopy> copyRegions;
+        VkDeviceSize offset = staged.offset;
+        for (auto i = level; i < firstResidentLevel; ++i) {
+            VkBufferImageCopy region {};
+            region.bufferOffset = offset;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = i - level;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = { static_cast<uint32_t>(sourceLevels[i].width), static_cast<uint32_t>(sourceLevels[i].height), 1 };
+            copyRegions.push_back(region);
+            offset += sourceLevels[i].size;
         }
+        vkCmdCopyBufferToImage(cmdBuffer, staged.buffer, replacement.image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+        stagingRing.releaseImage(replacement.image.image, residentLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
     }
-    context->transitionImageLayout(texImage.image, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-    staging.destroy(true);
-    delete (stagingMem);
-
-    texImageView = context->createImageView2D(texImage.image, format, VK_IMAGE_ASPECT_COLOR_BIT);
-
-    VkSamplerCreateInfo samplerInfo = {
-        VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
-        nullptr,
-        0,
-        VK_FILTER_LINEAR,
-        VK_FILTER_LINEAR,
-        VK_SAMPLER_MIPMAP_MODE_LINEAR,
-        VK_SAMPLER_ADDRESS_MODE_REPEAT,
-        VK_SAMPLER_ADDRESS_MODE_REPEAT,
-        VK_SAMPLER_ADDRESS_MODE_REPEAT,
-        0.0f,
-        VK_TRUE,
-        16.0f,
-        VK_FALSE,
-        VK_COMPARE_OP_ALWAYS,
-        0.0f,
-        0.0f,
-        VK_BORDER_COLOR_INT_OPAQUE_BLACK,
-        VK_FALSE
-    };
-    if (vkCreateSampler(context->getDevice(), &samplerInfo, nullptr, &texImageSampler) != VK_SUCCESS) {
-        throw std::runtime_error("Sampler creation for texture failed!");
+
+    // the other levels are already on the gpu, upload queues may not own the current image
+    const auto cmdBuffer = stagingRing.graphicsCommandBuffer();
+    if (level >= firstResidentLevel) {
+        context->transitionImageLayout(replacement.image.image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, cmdBuffer, residentLevels);
     }
+    const auto currentLevels = mipLevels - firstResidentLevel;
+    std::vector<VkImageCopy> copyRegions;
+    for (auto i = std::max(level, firstResidentLevel); i < mipLevels; ++i) {
+        VkImageCopy region {};
+        region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - firstResidentLevel, 0, 1 };
+        region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - level, 0, 1 };
+        region.extent = { static_cast<uint32_t>(sourceLevels[i].width), static_cast<uint32_t>(sourceLevels[i].height), 1 };
+        copyRegions.push_back(region);
+    }
+    context->transitionImageLayout(texImage.image, format, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, cmdBuffer, currentLevels);
+    vkCmdCopyImage(cmdBuffer, texImage.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, replacement.image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+    context->transitionImageLayout(texImage.image, format, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, cmdBuffer, currentLevels);
+    context->transitionImageLayout(replacement.image.image, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, cmdBuffer, residentLevels);
+
+    replacement.view = context->createImageView2D(replacement.image.image, format, VK_IMAGE_ASPECT_COLOR_BIT, residentLevels);
+    replacement.level = level;
+    replacement.batch = stagingRing.batchId();
+}
+
+bool Texture::replacementReady() const
+{
+    return replacementPending() && App::getHandle().getRenderBackend()->getStagingRing().complete(replacement.batch);
 }
+
+void Texture::swapReplacement()
+{
+    if (!replacementPending()) {
+        return;
+    }
+    auto context = App::getHandle().getRenderBackend();
+    context->destroyImageView(texImageView);
+    // the replacement was copied from the image in a batch that already finished
+    context->destroyImage(texImage, false);
+    delete (texMemory);
+
+    texMemory = replacement.memory;
+    texImage = replacement.image;
+    texImageView = replacement.view;
+    firstResidentLevel = replacement.level;
+    replacement = Replacement();
+}
+
 void Texture::cleanup()
 {
     auto context = App::getHandle().getRenderBackend();
-    vkDestroySampler(context->getDevice(), texImageSampler, nullptr);
-    texMemory->free(context->getDevice());
+    // the sampler is shared, it is destroyed with the renderer
+    if (texMemory) {
+        texMemory->free(context->getDevice());
+    }
+    if (replacement.memory) {
+        replacement.memory->free(context->getDevice());
+    }
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
+#include "FileReader.h"
 #include "VulkanExtension.h"
 
 #include <assimp/texture.h>
@@ -11,7 +12,15 @@ class Texture {
 public:
     Texture(std::string filePath, size_t typeID);
     Texture(const aiTexture* tex, size_t typeID, std::string id = "");
+    /**
+     * create texture from an encoded image file in memory (png, jpg, ...)
+     */
+    Texture(const unsigned char* encoded, size_t size, size_t typeID, std::string id = "");
     Texture(void* data, int width, int height, int channels, size_t typeID, std::string id = "");
+    /**
+     * upload an image that was already decoded (e.g. on a worker thread), the image is not freed
+     */
+    Texture(const Tools::FileReader::ImageFile& image, size_t typeID, std::string id = "");
     void cleanup();
 
     VkDescriptorImageInfo descriptor() const
@@ -27,20 +36,95 @@ public:
 
     const auto type() const { return typeID; }
 
+    /**
+     * number of levels of a full mip chain down to 1x1
+     */
+    static uint32_t mipLevelCount(uint32_t width, uint32_t height);
+
+    /**
+     * levels up to this size along the larger side stay resident, streamed textures start with only these
+     */
+    static constexpr uint32_t StreamingBaseSize = 64;
+
+    /**
+     * textures with a mip chain from a dds/ktx file keep it in memory and can change their resident levels.
+     * All others, e.g. png and jpg files, keep no source data and stay fully resident
+     */
+    bool streamable() const { return !sourceLevels.empty(); }
+    uint32_t levelCount() const { return mipLevels; }
+    /**
+     * finest level of the image, levels above it are not resident
+     */
+    uint32_t residentLevel() const { return firstResidentLevel; }
+    /**
+     * coarsest level a streamed texture may be reduced to
+     */
+    uint32_t baseLevel() const;
+    /**
+     * larger side of the level in texels
+     */
+    uint32_t levelExtent(uint32_t level) const;
+    /**
+     * size of a single level as stored in the file, close to its size in device memory
+     */
+    VkDeviceSize levelSize(uint32_t level) const;
+    /**
+     * device memory bound to the image and to a pending replacement
+     */
+    VkDeviceSize residentSize() const { return (texMemory ? texMemory->size : 0) + (replacement.memory ? replacement.memory->size : 0); }
+    /**
+     * start building an image holding the levels from level on in the staging batch, the current image stays in use.
+     * Levels finer than the resident ones are uploaded from the file, the others are copied from the current image
+     */
+    void replaceResidentLevel(uint32_t level);
+    bool replacementPending() const { return replacement.memory != nullptr; }
+    /**
+     * true once the upload of the pending replacement finished on the gpu
+     */
+    bool replacementReady() const;
+    /**
+     * use the replacement and destroy the current image. The gpu must not use the texture anymore,
+     * materials referencing it have to update their descriptor sets afterwards
+     */
+    void swapReplacement();
+
 private:
     std::string filePath;
 
     size_t typeID;
 
     int width, height, channels;
+    uint32_t mipLevels = 1;
+    uint32_t firstResidentLevel = 0;
+    VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
 
-    vkExt::SharedMemory* texMemory;
+    // file contents of streamable textures, levels are uploaded from here
+    gli::texture2d source;
+    std::vector<Tools::FileReader::ImageMipLevel> sourceLevels;
+
+    vkExt::SharedMemory* texMemory = nullptr;
     vkExt::Image texImage;
     VkImageView texImageView;
-    VkSampler texImageSampler;
 
-    void initFromData(void* data, int width, int height, int channles, VkFormat imageFormat = VK_FORMAT_R8G8B8A8_UNORM, int mipLevels = -1);
-    void initFromData(void* data, VkDeviceSize size, VkFormat imageFormat, int m);
+    struct Replacement {
+        vkExt::SharedMemory* memory = nullptr;
+        vkExt::Image image;
+        VkImageView view = VK_NULL_HANDLE;
+        uint32_t level = 0;
+        uint64_t batch = 0; // staging batch that writes the image
+    } replacement;
+    VkSampler texImageSampler; // owned by the sampler cache of the renderer
+
+    void initFromImage(const Tools::FileReader::ImageFile& image);
+    void initFromData(void* data, int width, int height, int channles, VkFormat imageFormat = VK_FORMAT_R8G8B8A8_UNORM);
+    /**
+     * \param levels mip levels stored one after another in data, the chain is generated from level 0 if empty
+     */
+    void initFromData(void* data, VkDeviceSize size, VkFormat imageFormat, const std::vector<Tools::FileReader::ImageMipLevel>& levels);
+    /**
+     * create the image from the levels starting at firstLevel, data holds all levels one after another
+     */
+    void upload(const unsigned char* data, VkDeviceSize size, const std::vector<Tools::FileReader::ImageMipLevel>& levels, uint32_t firstLevel, bool generateMips);
 };
 }
 
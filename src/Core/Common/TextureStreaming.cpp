@@ -0,0 +1,136 @@
+#include "TextureStreaming.h"
+
+#include "Application.h"
+#include "Geometry.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+using namespace Sparkle;
+
+bool TextureStreaming::beginFrame()
+{
+    return ++frame % UpdateInterval == 0;
+}
+
+void TextureStreaming::reportUsage(const Texture* texture, float pixels)
+{
+    auto& used = usage[texture];
+    // the first report of this update replaces the size of older ones
+    if (used.lastUpdate != updateCount + 1) {
+        used.lastUpdate = updateCount + 1;
+        used.pixels = 0.0f;
+    }
+    used.pixels = std::max(used.pixels, pixels);
+}
+
+void TextureStreaming::update(Geometry::Scene& scene)
+{
+    const auto current = ++updateCount;
+
+    struct Request {
+        Texture* texture;
+        uint32_t level;
+        Usage used;
+    };
+    std::vector<Request> requests;
+    std::unordered_map<const Texture*, Usage> sceneUsage;
+    VkDeviceSize total = 0;
+    for (const auto& texture : scene.textureCache) {
+        if (sceneUsage.find(texture.get()) != sceneUsage.end()) {
+            continue;
+        }
+        const auto found = usage.find(texture.get());
+        const auto used = found != usage.end() ? found->second : Usage {};
+        sceneUsage[texture.get()] = used;
+        if (!texture->streamable() || texture->replacementPending()) {
+            // the resident size of a pending replacement counts both images until it is swapped in
+            total += texture->residentSize();
+            continue;
+        }
+
+        // textures that were not seen keep their levels until the budget runs out
+        Request request = { texture.get(), texture->residentLevel(), used };
+        if (used.lastUpdate == current) {
+            // coarsest level with at least one texel per pixel
+            request.level = 0;
+            while (request.level < texture->baseLevel() && static_cast<float>(texture->levelExtent(request.level + 1)) >= used.pixels) {
+                ++request.level;
+            }
+        }
+        for (auto level = request.level; level < texture->levelCount(); ++level) {
+            total += texture->levelSize(level);
+        }
+        requests.push_back(request);
+    }
+    // forget textures of previous scenes
+    usage = std::move(sceneUsage);
+
+    // the textures seen longest ago and then the smallest on screen give up their levels first
+    std::sort(requests.begin(), requests.end(), [](const Request& a, const Request& b) {
+        if (a.used.lastUpdate != b.used.lastUpdate) {
+            return a.used.lastUpdate < b.used.lastUpdate;
+        }
+        return a.used.pixels < b.used.pixels;
+    });
+    for (auto& request : requests) {
+        while (total > budget && request.level < request.texture->baseLevel()) {
+            total -= request.texture->levelSize(request.level);
+            ++request.level;
+        }
+    }
+
+    // evictions are always applied, uploads in order of importance up to the upload limit
+    VkDeviceSize uploaded = 0;
+    for (auto request = requests.rbegin(); request != requests.rend(); ++request) {
+        const auto residentLevel = request->texture->residentLevel();
+        if (request->level < residentLevel) {
+            // only the new levels are read from the file, the resident ones are copied on the gpu
+            VkDeviceSize bytes = 0;
+            for (auto level = request->level; level < residentLevel; ++level) {
+                bytes += request->texture->levelSize(level);
+            }
+            if (uploaded > 0 && uploaded + bytes > UploadLimit) {
+                continue;
+            }
+            uploaded += bytes;
+            request->texture->replaceResidentLevel(request->level);
+        } else if (request->level > residentLevel) {
+            request->texture->replaceResidentLevel(request->level);
+        }
+    }
+
+    resident = 0;
+    for (const auto& entry : usage) {
+        resident += entry.first->residentSize();
+    }
+}
+
+bool TextureStreaming::replacementsReady(const Geometry::Scene& scene) const
+{
+    return std::any_of(scene.textureCache.begin(), scene.textureCache.end(), [](const auto& texture) { return texture->replacementReady(); });
+}
+
+bool TextureStreaming::swapReady(Geometry::Scene& scene)
+{
+    std::unordered_set<const Texture*> changed;
+    for (const auto& texture : scene.textureCache) {
+        if (texture->replacementReady()) {
+            texture->swapReplacement();
+            changed.insert(texture.get());
+        }
+    }
+
+    for (const auto& material : scene.materialCache) {
+        const auto& textures = material->getTextures();
+        if (std::any_of(textures.begin(), textures.end(), [&](const auto& entry) { return changed.count(entry.second.get()) > 0; })) {
+            material->updateDescriptorSets();
+        }
+    }
+
+    resident = 0;
+    for (const auto& entry : usage) {
+        resident += entry.first->residentSize();
+    }
+    return !changed.empty();
+}
@@ -0,0 +1,75 @@
+#ifndef TEXTURE_STREAMING_H
+#define TEXTURE_STREAMING_H
+
+#include "Texture.h"
+
+#include <unordered_map>
+
+namespace Sparkle {
+namespace Geometry {
+    class Scene;
+}
+
+/**
+ * decides which mip levels of the scene textures are resident. The renderer reports how large textures
+ * appear on screen, they get the levels they need as long as all resident levels fit into the budget.
+ * Only textures with a mip chain from a dds/ktx file are streamed, see Texture::streamable.
+ */
+class TextureStreaming {
+public:
+    // frames between two residency updates, swapping in finished images waits for the frames in flight and re-records the draws
+    static constexpr uint32_t UpdateInterval = 30;
+    // bytes read from the files by one update at most, larger requests are served by the following updates
+    static constexpr VkDeviceSize UploadLimit = VkDeviceSize(64) << 20;
+
+    /**
+     * \param bytes device memory for texture levels, 0 disables streaming and keeps all levels resident
+     */
+    void setBudget(VkDeviceSize bytes) { budget = bytes; }
+    VkDeviceSize getBudget() const { return budget; }
+    bool enabled() const { return budget > 0; }
+
+    /**
+     * true once every UpdateInterval frames, the renderer reports the usage of this frame and calls update then
+     */
+    bool beginFrame();
+    /**
+     * texture is drawn about pixels large along its larger side, reported for every visible use
+     */
+    void reportUsage(const Texture* texture, float pixels);
+    /**
+     * start replacing the images of the scene textures whose resident levels change for the reported usage,
+     * the new images are built by the staging ring while the current ones stay in use
+     */
+    void update(Geometry::Scene& scene);
+    /**
+     * true if a replacement started by update finished on the gpu
+     */
+    bool replacementsReady(const Geometry::Scene& scene) const;
+    /**
+     * use the finished replacements and update the descriptor sets of the affected materials.
+     * The gpu must not use the descriptor sets anymore, recorded draws reference the old descriptors afterwards
+     * \return true if any texture changed
+     */
+    bool swapReady(Geometry::Scene& scene);
+
+    /**
+     * device memory of the scene textures after the last update
+     */
+    VkDeviceSize residentBytes() const { return resident; }
+
+private:
+    struct Usage {
+        float pixels = 0.0f;
+        uint64_t lastUpdate = 0; // update the texture was last reported for
+    };
+    std::unordered_map<const Texture*, Usage> usage;
+
+    VkDeviceSize budget = 0;
+    VkDeviceSize resident = 0;
+    uint64_t frame = 0;
+    uint64_t updateCount = 0;
+};
+}
+
+#endif // TEXTURE_STREAMING_H
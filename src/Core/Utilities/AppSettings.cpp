@@ -2,6 +2,8 @@
 
 #include "SimpleIni.h"
 
+#include <algorithm>
+
 using namespace Sparkle;
 
 bool Sparkle::Settings::load()
@@ -70,12 +72,58 @@ bool Sparkle::Settings::load()
         }
     }
 
+    // LodError: screen space error in pixels a lod may introduce
+    const auto cLod = ini.GetValue("Camera", "LodError");
+    if (cLod) {
+        try {
+            lodErrorPixels = std::max(std::stof(cLod), 0.01f);
+        } catch (std::exception& ex) {
+        }
+    }
+
     // validation layer
     const auto cVal = ini.GetValue("Engine", "Validation");
     if (cVal) {
         validation = cVal[0] == '1' || std::string(cVal) == "True";
     }
 
+    // VertexFormat: Full, Compact or Quantized layout of the vertices in the draw buffer
+    const auto cFormat = ini.GetValue("Engine", "VertexFormat");
+    if (cFormat) {
+        vertexFormat = std::string(cFormat);
+    }
+
+    // TextureCompression: block compress textures on load, compressed files are cached next to their source
+    const auto cCompress = ini.GetValue("Engine", "TextureCompression");
+    if (cCompress) {
+        textureCompression = cCompress[0] == '1' || std::string(cCompress) == "True";
+    }
+
+    // TextureBudget: megabytes of device memory streamed texture levels may use, 0 keeps all levels resident.
+    // Only dds/ktx textures with a mip chain are streamed, png and jpg textures always stay fully resident
+    const auto cTexBudget = ini.GetValue("Engine", "TextureBudget");
+    if (cTexBudget) {
+        try {
+            textureBudgetMb = std::max(std::stoi(cTexBudget), 0);
+        } catch (std::exception& ex) {
+        }
+    }
+
+    // BindlessMaterials: select material textures by index from one global array if the device supports it
+    const auto cBindless = ini.GetValue("Engine", "BindlessMaterials");
+    if (cBindless) {
+        bindlessMaterials = cBindless[0] == '1' || std::string(cBindless) == "True";
+    }
+
+    // Anisotropy: anisotropic filtering of all texture samplers, limited by the device, 1 disables it
+    const auto cAniso = ini.GetValue("Engine", "Anisotropy");
+    if (cAniso) {
+        try {
+            anisotropy = std::max(std::stof(cAniso), 1.0f);
+        } catch (std::exception& ex) {
+        }
+    }
+
     // level path
     const auto lvl = ini.GetValue("Scene", "Level");
     if (lvl) {
@@ -85,6 +133,15 @@ bool Sparkle::Settings::load()
         }
     }
 
+    // LoadBudget: milliseconds per frame spent on creating a loaded level on the gpu
+    const auto cBudget = ini.GetValue("Scene", "LoadBudget");
+    if (cBudget) {
+        try {
+            loadBudgetMs = std::max(std::stof(cBudget), 0.0f);
+        } catch (std::exception& ex) {
+        }
+    }
+
     return true;
 }
 
@@ -112,6 +169,16 @@ float Settings::getRenderDistance() const
     return renderDistance;
 }
 
+float Settings::getLodErrorPixels() const
+{
+    return lodErrorPixels;
+}
+
+float Settings::getLoadBudgetMs() const
+{
+    return loadBudgetMs;
+}
+
 float Settings::getBrightness() const
 {
     return brightness;
@@ -132,6 +199,31 @@ std::string Settings::getLevelPath() const
     return levelPath;
 }
 
+std::string Settings::getVertexFormat() const
+{
+    return vertexFormat;
+}
+
+bool Settings::getTextureCompression() const
+{
+    return textureCompression;
+}
+
+int Settings::getTextureBudgetMb() const
+{
+    return textureBudgetMb;
+}
+
+bool Settings::getBindlessMaterials() const
+{
+    return bindlessMaterials;
+}
+
+float Settings::getAnisotropy() const
+{
+    return anisotropy;
+}
+
 bool Settings::withValidationLayer() const
 {
     return validation;
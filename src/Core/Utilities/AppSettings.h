@@ -16,10 +16,17 @@ public:
     std::pair<int, int> getResolution() const;
     float getFov() const;
     float getRenderDistance() const;
+    float getLodErrorPixels() const;
+    float getLoadBudgetMs() const;
     bool getFullscreen() const;
     int getRefreshRate() const;
     float getBrightness() const;
     std::string getLevelPath() const;
+    std::string getVertexFormat() const;
+    bool getTextureCompression() const;
+    int getTextureBudgetMb() const;
+    bool getBindlessMaterials() const;
+    float getAnisotropy() const;
     bool withValidationLayer() const;
 
     void updateResolution(int w, int h);
@@ -32,11 +39,18 @@ private:
     int height = 768;
     float fov = 70.0f;
     float renderDistance = 1000.0f;
+    float lodErrorPixels = 1.0f;
+    float loadBudgetMs = 4.0f;
     int refreshRate = 60;
     float brightness = 1.0f;
     bool isFullscreen = false;
     bool validation = false;
     std::string levelPath;
+    std::string vertexFormat = "Full";
+    bool textureCompression = true;
+    int textureBudgetMb = 512;
+    bool bindlessMaterials = true;
+    float anisotropy = 16.0f;
 
     std::string filePath;
 };
@@ -6,15 +6,25 @@
 #include "stb_image.h"
 
 #include <gli/load_dds.hpp>
+#include <gli/load_ktx.hpp>
 
+#include <algorithm>
+#include <cstring>
 #include <string>
 
 #ifdef _WIN32
 #include <filesystem>
 namespace fs = std::filesystem;
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
 #elif __linux__
 #include <experimental/filesystem>
 namespace fs = std::experimental::filesystem;
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 std::vector<char> Sparkle::Tools::FileReader::readFile(const std::string& fileName)
@@ -36,6 +46,98 @@ std::vector<char> Sparkle::Tools::FileReader::readFile(const std::string& fileNa
     return buff;
 }
 
+Sparkle::Tools::FileReader::MappedFile::MappedFile(const std::string& fileName)
+{
+#ifdef _WIN32
+    fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        fileHandle = nullptr;
+        throw std::runtime_error("Failed to open file: " + fileName);
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+        close();
+        throw std::runtime_error("Unable to map empty file: " + fileName);
+    }
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle) {
+        close();
+        throw std::runtime_error("Failed to map file: " + fileName);
+    }
+    mapping = static_cast<const unsigned char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (!mapping) {
+        close();
+        throw std::runtime_error("Failed to map file: " + fileName);
+    }
+    mappedSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+    auto fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open file: " + fileName);
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        ::close(fd);
+        throw std::runtime_error("Unable to map empty file: " + fileName);
+    }
+    auto ptr = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps its own reference to the file
+    if (ptr == MAP_FAILED) {
+        throw std::runtime_error("Failed to map file: " + fileName);
+    }
+    madvise(ptr, static_cast<size_t>(fileStat.st_size), MADV_WILLNEED);
+    mapping = static_cast<const unsigned char*>(ptr);
+    mappedSize = static_cast<size_t>(fileStat.st_size);
+#endif
+}
+
+Sparkle::Tools::FileReader::MappedFile::~MappedFile()
+{
+    close();
+}
+
+Sparkle::Tools::FileReader::MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+Sparkle::Tools::FileReader::MappedFile& Sparkle::Tools::FileReader::MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other) {
+        close();
+        std::swap(mapping, other.mapping);
+        std::swap(mappedSize, other.mappedSize);
+#ifdef _WIN32
+        std::swap(fileHandle, other.fileHandle);
+        std::swap(mappingHandle, other.mappingHandle);
+#endif
+    }
+    return *this;
+}
+
+void Sparkle::Tools::FileReader::MappedFile::close()
+{
+#ifdef _WIN32
+    if (mapping) {
+        UnmapViewOfFile(mapping);
+    }
+    if (mappingHandle) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle) {
+        CloseHandle(fileHandle);
+    }
+    fileHandle = nullptr;
+    mappingHandle = nullptr;
+#else
+    if (mapping) {
+        munmap(const_cast<unsigned char*>(mapping), mappedSize);
+    }
+#endif
+    mapping = nullptr;
+    mappedSize = 0;
+}
+
 std::vector<std::string> Sparkle::Tools::FileReader::readFileLines(const std::string& fileName)
 {
     std::ifstream file(fileName); // read the file in binary back to front
@@ -58,40 +160,170 @@ void Sparkle::Tools::FileReader::ImageFile::free()
     if (imageFileType == SPARKLE_IMAGE_OTHER && imageData) {
         stbi_image_free(imageData);
     }
+    imageData = nullptr;
+}
+
+namespace {
+// header of a KTX 2.0 file up to and including the level index, all fields little endian
+struct KTX2Header {
+    uint8_t identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+static_assert(sizeof(KTX2Header) == 80, "KTX2 header layout");
+
+struct KTX2Level {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+constexpr uint8_t KTX2Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+// the values of gli::format match VkFormat up to here
+constexpr uint32_t KTX2LastGliFormat = gli::FORMAT_RGBA_ASTC_12X12_SRGB_BLOCK16;
+}
+
+/*
+ * only plain 2d textures without supercompression are supported, which is what our texture cooking produces
+ */
+static gli::texture2d loadKTX2(const unsigned char* data, size_t size, const std::string& id)
+{
+    KTX2Header header;
+    if (size < sizeof(header)) {
+        throw std::runtime_error("KTX2: File too small: " + id);
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.identifier, KTX2Identifier, sizeof(KTX2Identifier)) != 0) {
+        throw std::runtime_error("KTX2: Invalid identifier: " + id);
+    }
+    if (header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1) {
+        throw std::runtime_error("KTX2: Only 2D textures are supported: " + id);
+    }
+    if (header.supercompressionScheme != 0) {
+        throw std::runtime_error("KTX2: Supercompressed textures are not supported: " + id);
+    }
+    if (header.vkFormat == 0 || header.vkFormat > KTX2LastGliFormat) {
+        throw std::runtime_error("KTX2: Unsupported format " + std::to_string(header.vkFormat) + ": " + id);
+    }
+
+    // a level count of 0 asks the loader to generate the mips, which happens on upload anyway
+    const auto levelCount = std::max(header.levelCount, 1u);
+    if (size < sizeof(header) + levelCount * sizeof(KTX2Level)) {
+        throw std::runtime_error("KTX2: Truncated level index: " + id);
+    }
+    gli::texture2d tex(static_cast<gli::format>(header.vkFormat), gli::extent2d(header.pixelWidth, header.pixelHeight), levelCount);
+    for (uint32_t i = 0; i < levelCount; ++i) {
+        KTX2Level level;
+        std::memcpy(&level, data + sizeof(header) + i * sizeof(KTX2Level), sizeof(level));
+        if (level.byteLength != tex[i].size() || level.byteOffset + level.byteLength > size) {
+            throw std::runtime_error("KTX2: Invalid level " + std::to_string(i) + ": " + id);
+        }
+        std::memcpy(tex[i].data(), data + level.byteOffset, static_cast<size_t>(level.byteLength));
+    }
+    return tex;
+}
+
+/*
+ * decode dds, ktx and ktx2 files, returns false for all other extensions
+ */
+static bool loadPrebuilt(const fs::path& path, const char* data, size_t size, Sparkle::Tools::FileReader::ImageFile& image)
+{
+    const auto extension = path.extension();
+    if (extension.compare(".dds") == 0) {
+        image.tex = gli::texture2d(gli::load_dds(data, size));
+        image.imageFileType = Sparkle::Tools::FileReader::SPARKLE_IMAGE_DDS;
+    } else if (extension.compare(".ktx") == 0) {
+        image.tex = gli::texture2d(gli::load_ktx(data, size));
+        image.imageFileType = Sparkle::Tools::FileReader::SPARKLE_IMAGE_KTX;
+    } else if (extension.compare(".ktx2") == 0) {
+        image.tex = loadKTX2(reinterpret_cast<const unsigned char*>(data), size, path.string());
+        image.imageFileType = Sparkle::Tools::FileReader::SPARKLE_IMAGE_KTX;
+    } else {
+        return false;
+    }
+    if (image.tex.empty()) {
+        throw std::runtime_error("Unable to decode texture: " + path.string());
+    }
+    return true;
+}
+
+static void readLevels(Sparkle::Tools::FileReader::ImageFile& image)
+{
+    image.imageData = reinterpret_cast<unsigned char*>(image.tex.data());
+    auto e = image.tex[0].extent();
+    image.width = e.x;
+    image.height = e.y;
+    image.size = image.tex.size();
+    for (size_t i = 0; i < image.tex.levels(); ++i) {
+        Sparkle::Tools::FileReader::ImageMipLevel mip;
+        mip.width = image.tex[i].extent().x;
+        mip.height = image.tex[i].extent().y;
+        mip.size = image.tex[i].size();
+        image.mipLevels.push_back(mip);
+    }
+    image.mipCount = static_cast<int>(image.tex.levels());
+}
+
+bool Sparkle::Tools::FileReader::isPrebuilt(const std::string& imagePath)
+{
+    const auto extension = fs::path(imagePath).extension();
+    return extension.compare(".dds") == 0 || extension.compare(".ktx") == 0 || extension.compare(".ktx2") == 0;
 }
 
 Sparkle::Tools::FileReader::ImageFile Sparkle::Tools::FileReader::loadImage(std::string imagePath)
 {
     Sparkle::Tools::FileReader::ImageFile image;
-    image.mipCount = -1;
-    image.size = -1;
-    image.imageFileType = SPARKLE_IMAGE_OTHER;
 
     fs::path path(imagePath);
-    if (path.extension().compare(".dds") == 0) { // use gli
-        image.tex = gli::texture2d(gli::load_dds(imagePath));
-        if (image.tex.empty()) {
-            throw std::runtime_error("DDS: Unable to load texture from: " + imagePath);
-        }
-        image.imageData = reinterpret_cast<unsigned char*>(image.tex.data());
-        auto e = image.tex[0].extent();
-        image.width = e.x;
-        image.height = e.y;
-        image.size = image.tex.size();
-        for (size_t i = 0; i < image.tex.levels(); ++i) {
-            ImageMipLevel mip;
-            mip.width = image.tex[i].extent().x;
-            mip.height = image.tex[i].extent().y;
-            mip.size = image.tex[i].size();
-            image.mipLevels.push_back(mip);
-        }
-        image.mipCount = image.tex.levels();
-        image.imageFileType = SPARKLE_IMAGE_DDS;
-    } else { // try to load with stbi TODO: mip levels?
+    if (isPrebuilt(imagePath)) { // use gli
+        const auto file = readFile(imagePath);
+        loadPrebuilt(path, file.data(), file.size(), image);
+        readLevels(image);
+    } else { // try to load with stbi, mips are generated on upload
         image.imageData = stbi_load(imagePath.c_str(), &image.width, &image.height, &image.channels, STBI_rgb_alpha);
+        image.size = static_cast<size_t>(image.width) * image.height * 4;
     }
     if (!image.imageData) {
         throw std::runtime_error("STBI: Unable to load texture from: " + imagePath);
     }
     return image;
-}
\ No newline at end of file
+}
+
+Sparkle::Tools::FileReader::ImageFile Sparkle::Tools::FileReader::loadImage(const unsigned char* encoded, size_t size, const std::string& id)
+{
+    Sparkle::Tools::FileReader::ImageFile image;
+
+    fs::path path(id);
+    if (loadPrebuilt(path, reinterpret_cast<const char*>(encoded), size, image)) {
+        readLevels(image);
+    } else {
+        image.imageData = stbi_load_from_memory(encoded, static_cast<int>(size), &image.width, &image.height, &image.channels, STBI_rgb_alpha);
+        image.size = static_cast<size_t>(image.width) * image.height * 4;
+    }
+    if (!image.imageData) {
+        throw std::runtime_error("STBI: Unable to decode texture: " + id);
+    }
+    return image;
+}
+
+Sparkle::Tools::FileReader::ImageFile Sparkle::Tools::FileReader::fromTexture(gli::texture2d texture, ImageType type)
+{
+    Sparkle::Tools::FileReader::ImageFile image;
+    image.tex = std::move(texture);
+    image.imageFileType = type;
+    readLevels(image);
+    return image;
+}
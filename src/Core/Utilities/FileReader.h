@@ -11,6 +11,7 @@ namespace Tools {
     namespace FileReader {
         enum ImageType {
             SPARKLE_IMAGE_DDS = 0x100,
+            SPARKLE_IMAGE_KTX = 0x200, // ktx and ktx2
             SPARKLE_IMAGE_OTHER = 0x010
         };
         struct ImageMipLevel {
@@ -20,13 +21,16 @@ namespace Tools {
 			 * \brief ImageFile representation
 			 */
         struct ImageFile {
-            int width, height, channels, mipCount;
-            size_t size;
+            int width = 0, height = 0, channels = 0, mipCount = -1;
+            size_t size = 0;
             std::vector<ImageMipLevel> mipLevels;
-            ImageType imageFileType;
+            ImageType imageFileType = SPARKLE_IMAGE_OTHER;
 
-            unsigned char* imageData;
+            unsigned char* imageData = nullptr;
 
+            /**
+				 * \brief dds and ktx files, format and mip levels are taken from the file
+				 */
             gli::texture2d tex;
 
             /**
@@ -35,6 +39,41 @@ namespace Tools {
             void free();
         };
 
+        /**
+			 * \brief read-only memory mapping of a whole file, unmapped on destruction
+			 */
+        class MappedFile {
+        public:
+            MappedFile() = default;
+            /**
+				 * \brief map the file at the given path, throws if the file can not be mapped
+				 */
+            explicit MappedFile(const std::string& fileName);
+            ~MappedFile();
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+            MappedFile(MappedFile&& other) noexcept;
+            MappedFile& operator=(MappedFile&& other) noexcept;
+
+            const unsigned char* data() const { return mapping; }
+            size_t size() const { return mappedSize; }
+            bool valid() const { return mapping != nullptr; }
+
+            /**
+				 * \brief release the mapping, pointers into the file become invalid
+				 */
+            void close();
+
+        private:
+            const unsigned char* mapping = nullptr;
+            size_t mappedSize = 0;
+#ifdef _WIN32
+            void* fileHandle = nullptr;
+            void* mappingHandle = nullptr;
+#endif
+        };
+
         /**
 			 * \brief read file from given path into a character array
 			 * \param fileName file path to read from
@@ -47,12 +86,29 @@ namespace Tools {
 			 * \return vector with all lines from the file
 			 */
         std::vector<std::string> readFileLines(const std::string& fileName);
+        /**
+			 * \brief true for files holding gpu ready data with all mip levels (dds, ktx, ktx2)
+			 */
+        bool isPrebuilt(const std::string& imagePath);
         /**
 			 * \brief load image from path
 			 * \param imagePath image path to read from
 			 * \return @ImageFile with data read from @imagePath
 			 */
         ImageFile loadImage(std::string imagePath);
+        /**
+			 * \brief decode an image file already in memory, safe to call from worker threads
+			 * \param encoded file contents (png, jpg, dds, ...)
+			 * \param size size of @encoded in bytes
+			 * \param id name used in error messages, a .dds, .ktx or .ktx2 extension selects the gli loaders
+			 * \return @ImageFile with data decoded from @encoded
+			 */
+        ImageFile loadImage(const unsigned char* encoded, size_t size, const std::string& id);
+        /**
+			 * \brief wrap a texture created in memory, e.g. by the block compression
+			 * \param type SPARKLE_IMAGE_DDS or SPARKLE_IMAGE_KTX
+			 */
+        ImageFile fromTexture(gli::texture2d texture, ImageType type);
     }
 }
 }
@@ -0,0 +1,587 @@
+#include "TextureCompression.h"
+
+#include "Material.h"
+#include "Util.h"
+
+#include <gli/save_dds.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <filesystem>
+namespace fs = std::filesystem;
+#elif __linux__
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+using namespace Sparkle::Tools;
+
+namespace {
+// one 4x4 block as floats, pixel i = y * 4 + x
+using Block = float[16][4];
+
+// weights of the second endpoint for the 4 bit indices of bc7, in 1/64
+constexpr int BC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+void storeLE(uint8_t* out, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; ++i) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+/**
+ * packs fields starting at the least significant bit of the first byte, as the bc7 layout expects
+ */
+class BitWriter {
+public:
+    explicit BitWriter(uint8_t* out)
+        : out(out)
+    {
+        std::memset(out, 0, 16);
+    }
+    void write(uint32_t value, int bits)
+    {
+        for (int i = 0; i < bits; ++i, ++pos) {
+            out[pos >> 3] |= static_cast<uint8_t>(((value >> i) & 1u) << (pos & 7));
+        }
+    }
+
+private:
+    uint8_t* out;
+    int pos = 0;
+};
+
+/**
+ * first principal component of the block, the direction the endpoints of a block are placed on
+ */
+void principalAxis(const Block& px, int channels, float mean[4], float axis[4])
+{
+    for (int c = 0; c < 4; ++c) {
+        mean[c] = 0.0f;
+        for (int i = 0; i < 16; ++i) {
+            mean[c] += px[i][c];
+        }
+        mean[c] /= 16.0f;
+    }
+    float cov[4][4] = {};
+    for (int i = 0; i < 16; ++i) {
+        for (int a = 0; a < channels; ++a) {
+            for (int b = 0; b < channels; ++b) {
+                cov[a][b] += (px[i][a] - mean[a]) * (px[i][b] - mean[b]);
+            }
+        }
+    }
+    // a few power iterations are enough to separate the dominant direction in 4x4 pixels
+    float v[4] = { 1.0f, 1.0f, 1.0f, channels == 4 ? 1.0f : 0.0f };
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        float next[4] = {};
+        float length = 0.0f;
+        for (int a = 0; a < channels; ++a) {
+            for (int b = 0; b < channels; ++b) {
+                next[a] += cov[a][b] * v[b];
+            }
+            length = std::max(length, std::abs(next[a]));
+        }
+        if (length <= std::numeric_limits<float>::epsilon()) {
+            break;
+        }
+        for (int a = 0; a < 4; ++a) {
+            v[a] = next[a] / length;
+        }
+    }
+    float length = 0.0f;
+    for (int a = 0; a < channels; ++a) {
+        length += v[a] * v[a];
+    }
+    length = std::sqrt(length);
+    for (int a = 0; a < 4; ++a) {
+        axis[a] = a < channels && length > 0.0f ? v[a] / length : 0.0f;
+    }
+}
+
+/**
+ * endpoints at the extremes of the pixels projected on the principal axis
+ */
+void axisEndpoints(const Block& px, int channels, float e0[4], float e1[4])
+{
+    float mean[4], axis[4];
+    principalAxis(px, channels, mean, axis);
+    float tMin = std::numeric_limits<float>::max();
+    float tMax = std::numeric_limits<float>::lowest();
+    for (int i = 0; i < 16; ++i) {
+        float t = 0.0f;
+        for (int c = 0; c < channels; ++c) {
+            t += (px[i][c] - mean[c]) * axis[c];
+        }
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+    }
+    for (int c = 0; c < 4; ++c) {
+        e0[c] = std::min(std::max(mean[c] + axis[c] * tMax, 0.0f), 255.0f);
+        e1[c] = std::min(std::max(mean[c] + axis[c] * tMin, 0.0f), 255.0f);
+    }
+}
+
+/**
+ * least squares endpoints for fixed indices, weights[i] is the share of e1 in pixel i
+ * \return false if the indices do not determine both endpoints
+ */
+bool fitEndpoints(const Block& px, int channels, const float weights[16], float e0[4], float e1[4])
+{
+    float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+    float ax[4] = {}, bx[4] = {};
+    for (int i = 0; i < 16; ++i) {
+        const float b = weights[i];
+        const float a = 1.0f - b;
+        aa += a * a;
+        bb += b * b;
+        ab += a * b;
+        for (int c = 0; c < channels; ++c) {
+            ax[c] += a * px[i][c];
+            bx[c] += b * px[i][c];
+        }
+    }
+    const float det = aa * bb - ab * ab;
+    if (std::abs(det) < 1e-6f) {
+        return false;
+    }
+    for (int c = 0; c < channels; ++c) {
+        e0[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / det, 0.0f), 255.0f);
+        e1[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / det, 0.0f), 255.0f);
+    }
+    return true;
+}
+
+uint16_t to565(const float c[4])
+{
+    const auto r = static_cast<uint16_t>(std::lround(c[0] * 31.0f / 255.0f));
+    const auto g = static_cast<uint16_t>(std::lround(c[1] * 63.0f / 255.0f));
+    const auto b = static_cast<uint16_t>(std::lround(c[2] * 31.0f / 255.0f));
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void from565(uint16_t v, float c[4])
+{
+    const int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+    c[0] = static_cast<float>((r << 3) | (r >> 2));
+    c[1] = static_cast<float>((g << 2) | (g >> 4));
+    c[2] = static_cast<float>((b << 3) | (b >> 2));
+    c[3] = 255.0f;
+}
+
+/**
+ * picks the nearest bc1 palette entry for every pixel, returns the squared error
+ */
+float bc1Indices(const Block& px, uint16_t c0, uint16_t c1, uint8_t indices[16])
+{
+    float palette[4][4];
+    from565(c0, palette[0]);
+    from565(c1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+        palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+    float error = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        float best = std::numeric_limits<float>::max();
+        for (uint8_t p = 0; p < 4; ++p) {
+            float d = 0.0f;
+            for (int c = 0; c < 3; ++c) {
+                d += (px[i][c] - palette[p][c]) * (px[i][c] - palette[p][c]);
+            }
+            if (d < best) {
+                best = d;
+                indices[i] = p;
+            }
+        }
+        error += best;
+    }
+    return error;
+}
+
+float bc1Quantize(const Block& px, const float e0[4], const float e1[4], uint16_t& c0, uint16_t& c1, uint8_t indices[16])
+{
+    c0 = to565(e0);
+    c1 = to565(e1);
+    // c0 > c1 selects the four color mode, with equal endpoints every pixel takes index 0
+    if (c0 < c1) {
+        std::swap(c0, c1);
+    }
+    if (c0 == c1) {
+        std::fill(indices, indices + 16, uint8_t(0));
+        float palette[4];
+        from565(c0, palette);
+        float error = 0.0f;
+        for (int i = 0; i < 16; ++i) {
+            for (int c = 0; c < 3; ++c) {
+                error += (px[i][c] - palette[c]) * (px[i][c] - palette[c]);
+            }
+        }
+        return error;
+    }
+    return bc1Indices(px, c0, c1, indices);
+}
+
+void encodeBC1(const Block& px, uint8_t* out)
+{
+    float e0[4], e1[4];
+    axisEndpoints(px, 3, e0, e1);
+    uint16_t c0, c1;
+    uint8_t indices[16];
+    auto error = bc1Quantize(px, e0, e1, c0, c1, indices);
+
+    // refine the endpoints once for the chosen indices
+    constexpr float paletteWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+    float weights[16];
+    for (int i = 0; i < 16; ++i) {
+        weights[i] = paletteWeights[indices[i]];
+    }
+    if (error > 0.0f && fitEndpoints(px, 3, weights, e0, e1)) {
+        uint16_t r0, r1;
+        uint8_t refined[16];
+        if (bc1Quantize(px, e0, e1, r0, r1, refined) < error) {
+            c0 = r0;
+            c1 = r1;
+            std::copy(refined, refined + 16, indices);
+        }
+    }
+
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; ++i) {
+        bits |= static_cast<uint32_t>(indices[i]) << (2 * i);
+    }
+    storeLE(out, c0, 2);
+    storeLE(out + 2, c1, 2);
+    storeLE(out + 4, bits, 4);
+}
+
+/**
+ * single channel block in the eight value mode, used for bc3 alpha and both bc5 channels
+ */
+void encodeBC4(const Block& px, int channel, uint8_t* out)
+{
+    float lo = 255.0f, hi = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        lo = std::min(lo, px[i][channel]);
+        hi = std::max(hi, px[i][channel]);
+    }
+    const auto a0 = static_cast<int>(std::lround(hi));
+    const auto a1 = static_cast<int>(std::lround(lo));
+    out[0] = static_cast<uint8_t>(a0);
+    out[1] = static_cast<uint8_t>(a1);
+
+    uint64_t bits = 0;
+    if (a0 > a1) {
+        float palette[8] = { static_cast<float>(a0), static_cast<float>(a1) };
+        for (int p = 2; p < 8; ++p) {
+            palette[p] = static_cast<float>(((8 - p) * a0 + (p - 1) * a1) / 7);
+        }
+        for (int i = 0; i < 16; ++i) {
+            uint64_t index = 0;
+            float best = std::numeric_limits<float>::max();
+            for (uint64_t p = 0; p < 8; ++p) {
+                const auto d = std::abs(px[i][channel] - palette[p]);
+                if (d < best) {
+                    best = d;
+                    index = p;
+                }
+            }
+            bits |= index << (3 * i);
+        }
+    }
+    storeLE(out + 2, bits, 6);
+}
+
+float bc7Indices(const Block& px, const int e0[4], const int e1[4], uint8_t indices[16])
+{
+    float palette[16][4];
+    for (int p = 0; p < 16; ++p) {
+        for (int c = 0; c < 4; ++c) {
+            palette[p][c] = static_cast<float>(((64 - BC7Weights[p]) * e0[c] + BC7Weights[p] * e1[c] + 32) >> 6);
+        }
+    }
+    float error = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        float best = std::numeric_limits<float>::max();
+        for (uint8_t p = 0; p < 16; ++p) {
+            float d = 0.0f;
+            for (int c = 0; c < 4; ++c) {
+                d += (px[i][c] - palette[p][c]) * (px[i][c] - palette[p][c]);
+            }
+            if (d < best) {
+                best = d;
+                indices[i] = p;
+            }
+        }
+        error += best;
+    }
+    return error;
+}
+
+struct BC7Endpoints {
+    int q0[4], q1[4]; // 7 bit endpoints
+    int p0, p1; // shared lowest bit of each endpoint
+    uint8_t indices[16];
+    float error = std::numeric_limits<float>::max();
+};
+
+/**
+ * quantizes the endpoints with every combination of p bits and keeps the one with the lowest block error
+ */
+void bc7Quantize(const Block& px, const float e0[4], const float e1[4], BC7Endpoints& best)
+{
+    for (int p0 = 0; p0 < 2; ++p0) {
+        for (int p1 = 0; p1 < 2; ++p1) {
+            BC7Endpoints candidate;
+            int v0[4], v1[4];
+            for (int c = 0; c < 4; ++c) {
+                candidate.q0[c] = std::min(std::max(static_cast<int>(std::lround((e0[c] - p0) * 0.5f)), 0), 127);
+                candidate.q1[c] = std::min(std::max(static_cast<int>(std::lround((e1[c] - p1) * 0.5f)), 0), 127);
+                v0[c] = (candidate.q0[c] << 1) | p0;
+                v1[c] = (candidate.q1[c] << 1) | p1;
+            }
+            candidate.p0 = p0;
+            candidate.p1 = p1;
+            candidate.error = bc7Indices(px, v0, v1, candidate.indices);
+            if (candidate.error < best.error) {
+                best = candidate;
+            }
+        }
+    }
+}
+
+/**
+ * bc7 mode 6: a single subset with rgba endpoints of 7 bits plus a p bit and 4 bit indices
+ */
+void encodeBC7(const Block& px, uint8_t* out)
+{
+    float e0[4], e1[4];
+    axisEndpoints(px, 4, e0, e1);
+    BC7Endpoints result;
+    bc7Quantize(px, e0, e1, result);
+
+    float weights[16];
+    for (int i = 0; i < 16; ++i) {
+        weights[i] = BC7Weights[result.indices[i]] / 64.0f;
+    }
+    if (result.error > 0.0f && fitEndpoints(px, 4, weights, e0, e1)) {
+        bc7Quantize(px, e0, e1, result);
+    }
+
+    // the msb of the first index is implicit zero, mirroring the palette keeps the decoded colors
+    if (result.indices[0] >= 8) {
+        std::swap(result.q0, result.q1);
+        std::swap(result.p0, result.p1);
+        for (auto& index : result.indices) {
+            index = static_cast<uint8_t>(15 - index);
+        }
+    }
+
+    BitWriter writer(out);
+    writer.write(1u << 6, 7);
+    for (int c = 0; c < 4; ++c) {
+        writer.write(static_cast<uint32_t>(result.q0[c]), 7);
+        writer.write(static_cast<uint32_t>(result.q1[c]), 7);
+    }
+    writer.write(static_cast<uint32_t>(result.p0), 1);
+    writer.write(static_cast<uint32_t>(result.p1), 1);
+    writer.write(result.indices[0], 3);
+    for (int i = 1; i < 16; ++i) {
+        writer.write(result.indices[i], 4);
+    }
+}
+
+gli::format gliFormat(TextureCompression::BlockFormat format)
+{
+    switch (format) {
+    case TextureCompression::BlockFormat::BC1:
+        return gli::FORMAT_RGBA_DXT1_UNORM_BLOCK8;
+    case TextureCompression::BlockFormat::BC3:
+        return gli::FORMAT_RGBA_DXT5_UNORM_BLOCK16;
+    case TextureCompression::BlockFormat::BC5:
+        return gli::FORMAT_RG_ATI2N_UNORM_BLOCK16;
+    default:
+        return gli::FORMAT_RGBA_BP_UNORM_BLOCK16;
+    }
+}
+
+/**
+ * 2x2 box filter, odd edges repeat the last row or column. Normal maps are filtered as vectors and renormalized.
+ */
+std::vector<uint8_t> downsample(const std::vector<uint8_t>& src, int width, int height, bool normalMap, int& outWidth, int& outHeight)
+{
+    outWidth = std::max(width / 2, 1);
+    outHeight = std::max(height / 2, 1);
+    std::vector<uint8_t> dst(static_cast<size_t>(outWidth) * outHeight * 4);
+    for (int y = 0; y < outHeight; ++y) {
+        const int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+        for (int x = 0; x < outWidth; ++x) {
+            const int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            const uint8_t* taps[4] = {
+                &src[(static_cast<size_t>(y0) * width + x0) * 4], &src[(static_cast<size_t>(y0) * width + x1) * 4],
+                &src[(static_cast<size_t>(y1) * width + x0) * 4], &src[(static_cast<size_t>(y1) * width + x1) * 4]
+            };
+            auto out = &dst[(static_cast<size_t>(y) * outWidth + x) * 4];
+            for (int c = 0; c < 4; ++c) {
+                out[c] = static_cast<uint8_t>((taps[0][c] + taps[1][c] + taps[2][c] + taps[3][c] + 2) / 4);
+            }
+            if (normalMap) {
+                float n[3] = {};
+                for (auto tap : taps) {
+                    for (int c = 0; c < 3; ++c) {
+                        n[c] += tap[c] / 127.5f - 1.0f;
+                    }
+                }
+                const auto length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if (length > 0.0f) {
+                    for (int c = 0; c < 3; ++c) {
+                        out[c] = static_cast<uint8_t>(std::lround((n[c] / length + 1.0f) * 127.5f));
+                    }
+                }
+            }
+        }
+    }
+    return dst;
+}
+}
+
+TextureCompression::BlockFormat TextureCompression::formatForType(uint32_t texType)
+{
+    switch (texType) {
+    case TEX_TYPE_NORMAL:
+        return BlockFormat::BC5;
+    case TEX_TYPE_SPECULAR:
+        return BlockFormat::BC3;
+    case TEX_TYPE_ROUGHNESS:
+    case TEX_TYPE_METALLIC:
+        return BlockFormat::BC1;
+    default:
+        return BlockFormat::BC7;
+    }
+}
+
+std::string TextureCompression::cachePath(const std::string& sourcePath, BlockFormat format)
+{
+    static const char* extensions[] = { ".bc1.dds", ".bc3.dds", ".bc5.dds", ".bc7.dds" };
+    return sourcePath + extensions[static_cast<int>(format)];
+}
+
+FileReader::ImageFile TextureCompression::load(const std::string& path, uint32_t texType, ThreadPool& pool)
+{
+    if (FileReader::isPrebuilt(path)) {
+        return FileReader::loadImage(path);
+    }
+
+    const auto cached = cachePath(path, formatForType(texType));
+    std::error_code ec;
+    const auto sourceTime = fs::last_write_time(path, ec);
+    if (!ec && fs::exists(cached, ec) && fs::last_write_time(cached, ec) >= sourceTime && !ec) {
+        try {
+            return FileReader::loadImage(cached);
+        } catch (std::exception&) {
+            // broken cache file, compress the source again
+        }
+    }
+
+    auto image = FileReader::loadImage(path);
+    compress(image, texType, pool);
+    // levels cooked in parallel may share the texture, readers only ever see a complete cache file
+    static std::atomic<uint64_t> tempCount { 0 };
+    const auto temp = cached + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + "." + std::to_string(++tempCount) + ".tmp";
+    if (!gli::save_dds(image.tex, temp)) {
+        LOGSTDOUT("Unable to write compressed texture cache " + cached);
+        fs::remove(temp, ec);
+        return image;
+    }
+    fs::rename(temp, cached, ec);
+    if (ec) {
+        LOGSTDOUT("Unable to write compressed texture cache " + cached + ": " + ec.message());
+        fs::remove(temp, ec);
+    }
+    return image;
+}
+
+void TextureCompression::compress(FileReader::ImageFile& image, uint32_t texType, ThreadPool& pool)
+{
+    if (image.imageFileType != FileReader::SPARKLE_IMAGE_OTHER) {
+        return; // already in a gpu format
+    }
+    auto texture = compress(image.imageData, image.width, image.height, formatForType(texType), texType == TEX_TYPE_NORMAL, pool);
+    image.free();
+    image = FileReader::fromTexture(std::move(texture), FileReader::SPARKLE_IMAGE_DDS);
+}
+
+gli::texture2d TextureCompression::compress(const unsigned char* rgba, int width, int height, BlockFormat format, bool normalMap, ThreadPool& pool)
+{
+    const auto levels = static_cast<size_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+    gli::texture2d texture(gliFormat(format), gli::extent2d(width, height), levels);
+    const size_t blockSize = format == BlockFormat::BC1 ? 8 : 16;
+
+    std::vector<uint8_t> pixels(rgba, rgba + static_cast<size_t>(width) * height * 4);
+    int levelWidth = width, levelHeight = height;
+    for (size_t level = 0; level < levels; ++level) {
+        const size_t blocksX = (levelWidth + 3) / 4;
+        const size_t blocksY = (levelHeight + 3) / 4;
+        auto dst = static_cast<uint8_t*>(texture[level].data());
+        if (texture[level].size() != blocksX * blocksY * blockSize) {
+            throw std::runtime_error("Unexpected block layout of compressed texture level " + std::to_string(level));
+        }
+
+        pool.parallelFor(blocksY, [&](size_t by) {
+            uint8_t block[16 * 4];
+            for (size_t bx = 0; bx < blocksX; ++bx) {
+                // blocks over the edge repeat the last pixels, they are not visible after decoding
+                for (size_t y = 0; y < 4; ++y) {
+                    const auto sy = std::min(by * 4 + y, static_cast<size_t>(levelHeight - 1));
+                    for (size_t x = 0; x < 4; ++x) {
+                        const auto sx = std::min(bx * 4 + x, static_cast<size_t>(levelWidth - 1));
+                        std::memcpy(&block[(y * 4 + x) * 4], &pixels[(sy * levelWidth + sx) * 4], 4);
+                    }
+                }
+                encodeBlock(block, format, dst + (by * blocksX + bx) * blockSize);
+            }
+        });
+
+        if (level + 1 < levels) {
+            int nextWidth, nextHeight;
+            pixels = downsample(pixels, levelWidth, levelHeight, normalMap, nextWidth, nextHeight);
+            levelWidth = nextWidth;
+            levelHeight = nextHeight;
+        }
+    }
+    return texture;
+}
+
+void TextureCompression::encodeBlock(const uint8_t* pixels, BlockFormat format, uint8_t* out)
+{
+    Block px;
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 4; ++c) {
+            px[i][c] = pixels[i * 4 + c];
+        }
+    }
+    switch (format) {
+    case BlockFormat::BC1:
+        encodeBC1(px, out);
+        break;
+    case BlockFormat::BC3:
+        encodeBC4(px, 3, out);
+        encodeBC1(px, out + 8);
+        break;
+    case BlockFormat::BC5:
+        encodeBC4(px, 0, out);
+        encodeBC4(px, 1, out + 8);
+        break;
+    case BlockFormat::BC7:
+        encodeBC7(px, out);
+        break;
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <cstdint>
+#include <string>
+
+#include "FileReader.h"
+#include "ThreadPool.h"
+
+namespace Sparkle {
+namespace Tools {
+    /**
+		 * \brief block compression of RGBA8 images, used by the cooker and on first load
+		 * Compressed textures are cached as <source>.<format>.dds next to their source file.
+		 */
+    class TextureCompression {
+    public:
+        enum class BlockFormat {
+            BC1, // rgb, 4 bpp
+            BC3, // rgba, 8 bpp
+            BC5, // two channel normal maps, 8 bpp
+            BC7 // rgba with high quality, 8 bpp
+        };
+
+        /**
+			 * \brief block format a texture of the given TEX_TYPE_* is compressed to
+			 */
+        static BlockFormat formatForType(uint32_t texType);
+        static std::string cachePath(const std::string& sourcePath, BlockFormat format);
+
+        /**
+			 * \brief load the texture at path compressed for texType
+			 * dds and ktx files are loaded as they are, other images are compressed and written to the cache
+			 * unless an up to date cached file exists. Failing to write the cache is not an error.
+			 */
+        static FileReader::ImageFile load(const std::string& path, uint32_t texType, ThreadPool& pool);
+        /**
+			 * \brief compress an image decoded by FileReader, uncompressed images are freed and replaced
+			 */
+        static void compress(FileReader::ImageFile& image, uint32_t texType, ThreadPool& pool);
+        /**
+			 * \brief encode an RGBA8 image and its full mip chain, the blocks of every level are encoded on the pool
+			 * \param normalMap mips are renormalized and only x and y are kept
+			 */
+        static gli::texture2d compress(const unsigned char* rgba, int width, int height, BlockFormat format, bool normalMap, ThreadPool& pool);
+
+        /**
+			 * \brief encode one 4x4 block of RGBA8 pixels in row order
+			 * \param out 8 bytes for BC1, 16 bytes for the others
+			 */
+        static void encodeBlock(const uint8_t* pixels, BlockFormat format, uint8_t* out);
+    };
+}
+}
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Sparkle {
+namespace Tools {
+    /**
+		 * \brief fixed size pool of worker threads processing a shared task queue
+		 */
+    class ThreadPool {
+    public:
+        explicit ThreadPool(size_t threadCount = std::max(1u, std::thread::hardware_concurrency()))
+        {
+            for (size_t i = 0; i < std::max<size_t>(threadCount, 1); ++i) {
+                workers.emplace_back([this]() { workerLoop(); });
+            }
+        }
+
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                stopping = true;
+            }
+            queueCondition.notify_all();
+            for (auto& w : workers) {
+                w.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        size_t size() const { return workers.size(); }
+
+        /**
+			 * \brief queue a task for execution on one of the workers
+			 * \return future holding the result or exception of the task
+			 */
+        template <typename F>
+        auto submit(F&& task) -> std::future<decltype(task())>
+        {
+            using Result = decltype(task());
+            auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+            auto future = packaged->get_future();
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                tasks.emplace([packaged]() { (*packaged)(); });
+            }
+            queueCondition.notify_one();
+            return future;
+        }
+
+        /**
+			 * \brief call body(i) for every i in [0, count) and block until all calls are done
+			 * The calling thread takes part in the work, so nested calls from within a task can not deadlock.
+			 * The first exception thrown by body is rethrown after all indices have been processed.
+			 */
+        template <typename F>
+        void parallelFor(size_t count, F&& body)
+        {
+            if (count == 0) {
+                return;
+            }
+            struct State {
+                std::atomic<size_t> next { 0 };
+                size_t done = 0;
+                std::mutex mutex;
+                std::condition_variable finished;
+                std::exception_ptr error = nullptr;
+            };
+            auto state = std::make_shared<State>();
+            auto run = [state, count, &body]() {
+                size_t processed = 0;
+                for (auto i = state->next++; i < count; i = state->next++) {
+                    try {
+                        body(i);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(state->mutex);
+                        if (!state->error) {
+                            state->error = std::current_exception();
+                        }
+                    }
+                    ++processed;
+                }
+                if (processed > 0) {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->done += processed;
+                    if (state->done == count) {
+                        state->finished.notify_all();
+                    }
+                }
+            };
+
+            // helpers that start after all indices are taken return immediately and never touch body
+            const auto helpers = std::min(workers.size(), count - 1);
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                for (size_t i = 0; i < helpers; ++i) {
+                    tasks.emplace(run);
+                }
+            }
+            queueCondition.notify_all();
+
+            run();
+
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->finished.wait(lock, [&]() { return state->done == count; });
+            if (state->error) {
+                std::rethrow_exception(state->error);
+            }
+        }
+
+    private:
+        std::vector<std::thread> workers;
+        std::queue<std::function<void()>> tasks;
+        std::mutex queueMutex;
+        std::condition_variable queueCondition;
+        bool stopping = false;
+
+        void workerLoop()
+        {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(queueMutex);
+                    queueCondition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                    if (stopping && tasks.empty()) {
+                        return;
+                    }
+                    task = std::move(tasks.front());
+                    tasks.pop();
+                }
+                task();
+            }
+        }
+    };
+}
+}
+
+#endif
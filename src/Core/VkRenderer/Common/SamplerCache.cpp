@@ -0,0 +1,57 @@
+#include "SamplerCache.h"
+
+#include "VulkanExtension.h"
+#include "VulkanInitializers.h"
+
+#include <tuple>
+
+using namespace Sparkle;
+
+bool SamplerCache::State::operator<(const State& other) const
+{
+	return std::tie(filter, mipmapMode, addressMode, anisotropic) < std::tie(other.filter, other.mipmapMode, other.addressMode, other.anisotropic);
+}
+
+void SamplerCache::initialize(VkDevice device, float maxAnisotropy)
+{
+	this->device = device;
+	anisotropy = maxAnisotropy;
+}
+
+void SamplerCache::cleanup()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (const auto& entry : samplers) {
+		vkDestroySampler(device, entry.second, nullptr);
+	}
+	samplers.clear();
+}
+
+VkSampler SamplerCache::get(const State& state)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	const auto found = samplers.find(state);
+	if (found != samplers.end()) {
+		return found->second;
+	}
+
+	auto samplerInfo = vk::init::samplerCreateInfo();
+	samplerInfo.magFilter = state.filter;
+	samplerInfo.minFilter = state.filter;
+	samplerInfo.mipmapMode = state.mipmapMode;
+	samplerInfo.addressModeU = state.addressMode;
+	samplerInfo.addressModeV = state.addressMode;
+	samplerInfo.addressModeW = state.addressMode;
+	samplerInfo.anisotropyEnable = state.anisotropic && anisotropy > 1.0f ? VK_TRUE : VK_FALSE;
+	samplerInfo.maxAnisotropy = samplerInfo.anisotropyEnable ? anisotropy : 1.0f;
+	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerInfo.minLod = 0.0f;
+	// image views limit the levels, streamed textures change theirs while sharing the sampler
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+
+	VkSampler sampler;
+	VK_THROW_ON_ERROR(vkCreateSampler(device, &samplerInfo, nullptr, &sampler), "Sampler creation failed!");
+	samplers[state] = sampler;
+	return sampler;
+}
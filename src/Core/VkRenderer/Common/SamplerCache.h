@@ -0,0 +1,47 @@
+#ifndef SAMPLER_CACHE_H
+#define SAMPLER_CACHE_H
+
+#include <vulkan/vulkan.h>
+
+#include <map>
+#include <mutex>
+
+namespace Sparkle {
+/**
+ * samplers shared by all textures with the same state, created on first use and destroyed with the renderer.
+ * The anisotropy of the quality settings applies to every anisotropic sampler.
+ */
+class SamplerCache {
+public:
+	struct State {
+		VkFilter filter = VK_FILTER_LINEAR;
+		VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		bool anisotropic = true;
+
+		bool operator<(const State& other) const;
+	};
+
+	/**
+	 * \param maxAnisotropy anisotropy of anisotropic samplers, 1 or less disables anisotropic filtering
+	 */
+	void initialize(VkDevice device, float maxAnisotropy);
+	void cleanup();
+
+	/**
+	 * thread safe, textures may be created by the level loading threads
+	 */
+	VkSampler get(const State& state = State());
+
+	float getAnisotropy() const { return anisotropy; }
+	size_t size() const { return samplers.size(); }
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	float anisotropy = 1.0f;
+	std::map<State, VkSampler> samplers;
+	std::mutex mutex;
+};
+} // namespace Sparkle
+
+#endif
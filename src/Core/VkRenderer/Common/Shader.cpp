@@ -3,34 +3,14 @@
 #include "FileReader.h"
 #include "Geometry.h"
 
-void* _alignedAlloc(size_t size, size_t alignment)
-{
-	void* data = nullptr;
-#if defined(_MSC_VER)
-	data = _aligned_malloc(size, alignment);
-#else
-	int res = posix_memalign(&data, alignment, size);
-	if (res != 0)
-		data = nullptr;
-#endif
-	return data;
-}
-
-void _alignedFree(void* data)
-{
-#if defined(_MSC_VER)
-	_aligned_free(data);
-#else
-	free(data);
-#endif
-}
+#include <algorithm>
 
 using namespace Sparkle::Shaders;
 
 MRTShaderProgram::MRTShaderProgram(const std::vector<ShaderSource>& shaderSources, size_t bufferCount)
 {
 	uniformBuffers.resize(bufferCount);
-	dynamicBufferMemory = new vkExt::SharedMemory();
+	instanceBufferMemory = new vkExt::SharedMemory();
 	objectCount = 0;
 
 	for (const auto& shader : shaderSources) {
@@ -62,7 +42,7 @@ MRTShaderProgram::MRTShaderProgram(const std::vector<ShaderSource>& shaderSource
 	}
 
 	createUniformBuffer();
-	createDynamicBuffer(0);
+	createInstanceBuffer(0);
 }
 
 void MRTShaderProgram::cleanup()
@@ -78,12 +58,12 @@ void MRTShaderProgram::cleanup()
 	}
 	uniformBufferMemory.clear();
 
-	if (dynamicBuffer.buffer) {
-		dynamicBuffer.destroy(true);
+	if (instanceBuffer.buffer) {
+		instanceBuffer.destroy(true);
 	}
 
-	if (dynamicBufferMemory) {
-		delete(dynamicBufferMemory);
+	if (instanceBufferMemory) {
+		delete(instanceBufferMemory);
 	}
 }
 
@@ -99,7 +79,8 @@ void DeferredShaderProgram::updateFragmentShaderUniforms(const FragmentShaderUni
 {
 	auto& ub = uniformBuffers[index];
 	ub.map();
-	ub.copyTo(&ubo, sizeof(ubo));
+	// only the used part of the light array is uploaded
+	ub.copyTo(&ubo, offsetof(FragmentShaderUniforms, lights) + ubo.numLights * sizeof(Lights::Light));
 	ub.unmap();
 }
 
@@ -127,51 +108,58 @@ void MRTShaderProgram::createUniformBuffer()
 	}
 }
 
-void MRTShaderProgram::createDynamicBuffer(VkDeviceSize size)
+void MRTShaderProgram::createInstanceBuffer(size_t count)
 {
 	const auto& renderer = Sparkle::App::getHandle().getRenderBackend();
 
-	if (dynamicBuffer.buffer) {
-		dynamicBuffer.destroy(true);
-
-		_alignedFree(dynamicUboData);
+	if (instanceBuffer.buffer) {
+		instanceBuffer.destroy(true);
 	}
 
-	objectCount = size;
+	objectCount = count;
 
-	VkPhysicalDeviceProperties props;
-	vkGetPhysicalDeviceProperties(renderer->getPhysicalDevice(), &props);
-	const auto alignment = static_cast<uint32_t>(props.limits.minUniformBufferOffsetAlignment);
+	// if buffer is initialized with empty geometry (objectCount of 0), use 1 instance as initial size.
+	instanceData.resize(objectCount > 0 ? objectCount : 1);
+	const auto bufferSize = instanceData.size() * sizeof(InstanceData);
 
-	dUboAlignment = static_cast<uint32_t>(sizeof(InstancedUniformBufferObject));
-	if (alignment > 0) {
-		dUboAlignment = (dUboAlignment + alignment - 1) & ~(alignment - 1);
-	}
-	// if buffer is initialized with empty geometry (objectCount of 0), use 1 alignment as initial size.
-	dynamicUboDataSize = objectCount > 0 ? objectCount * dUboAlignment : dUboAlignment;
-	dynamicUboData = (InstancedUniformBufferObject*)_alignedAlloc(dynamicUboDataSize, dUboAlignment);
+	renderer->createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, instanceBuffer, instanceBufferMemory);
 
-	renderer->createBuffer(dynamicUboDataSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, dynamicBuffer, dynamicBufferMemory);
+	instanceBuffer.map();
 
-	dynamicBuffer.map();
-
-	dynamicBufferDirty = true;
-	// getDescriptorInfos();
+	instanceBufferDirty = true;
 }
 
-void MRTShaderProgram::updateDynamicUniformBufferObject(const std::vector<std::shared_ptr<Sparkle::Geometry::Node>>& meshes)
+void MRTShaderProgram::updateInstanceBuffer(const std::vector<std::shared_ptr<Sparkle::Geometry::Node>>& meshes, bool changedOnly)
 {
-	if (!(dynamicBuffer.buffer) || meshes.size() * dUboAlignment > dynamicUboDataSize) {
-		createDynamicBuffer(meshes.size());
+	bool recreated = false;
+	if (!(instanceBuffer.buffer) || meshes.size() > instanceData.size()) {
+		// scenes are filled incrementally, grow geometrically to avoid reallocating every frame
+		createInstanceBuffer(std::max(meshes.size(), 2 * instanceData.size()));
+		recreated = true;
 	}
+	instanceNodes.resize(meshes.size(), nullptr);
+	size_t first = meshes.size();
+	size_t last = 0;
 	for (auto i = 0u; i < meshes.size(); ++i) {
+		if (changedOnly && instanceNodes[i] == meshes[i].get()) {
+			continue;
+		}
+		instanceNodes[i] = meshes[i].get();
+		first = std::min<size_t>(first, i);
+		last = i + 1;
 		const auto modelMat = meshes[i]->accumModel();
-		const auto iUbo = (InstancedUniformBufferObject*)((uint64_t)dynamicUboData + i * (uint64_t)dUboAlignment);
-		iUbo->model = glm::mat4(modelMat);
-		iUbo->normal = glm::mat4(glm::transpose(glm::inverse(glm::mat3(modelMat))));
+		const auto mesh = std::dynamic_pointer_cast<Sparkle::Geometry::Mesh, Sparkle::Geometry::Node>(meshes[i]);
+		// quantized positions are scaled back to object space together with the model transform
+		instanceData[i].model = mesh ? modelMat * mesh->bufferOffset.positionTransform : glm::mat4(modelMat);
+		instanceData[i].normal = glm::mat4(glm::transpose(glm::inverse(glm::mat3(modelMat))));
+		instanceData[i].material = glm::uvec4(mesh && mesh->getMaterial() ? mesh->getMaterial()->getBindlessIndex() : 0u);
+	}
+	if (recreated) {
+		instanceBuffer.copyTo(instanceData.data(), instanceData.size() * sizeof(InstanceData));
+	} else if (first < last) {
+		instanceBuffer.copyTo(instanceData.data() + first, (last - first) * sizeof(InstanceData), first * sizeof(InstanceData));
 	}
-	dynamicBuffer.copyTo(dynamicUboData, dynamicUboDataSize);
-	dynamicBuffer.flush();
+	instanceBuffer.flush();
 }
 
 VkDescriptorBufferInfo MRTShaderProgram::getDescriptorInfos(size_t index) const
@@ -50,9 +50,13 @@ namespace Shaders {
 			glm::mat4 projection;
 		};
 
-		struct InstancedUniformBufferObject {
+		/**
+		 * per instance data in the instance storage buffer, indexed by the instance index of the draw
+		 */
+		struct InstanceData {
 			glm::mat4 model;
 			glm::mat4 normal;
+			glm::uvec4 material; // x: Material::getBindlessIndex of the mesh, read by bindless draws
 		};
 
 		MRTShaderProgram(const std::vector<Shaders::ShaderSource>& shaderSources, size_t bufferCount);
@@ -60,33 +64,33 @@ namespace Shaders {
 		void cleanup();
 
 		void updateUniformBufferObject(const UniformBufferObject& ubo, size_t index);
-		void updateDynamicUniformBufferObject(const std::vector<std::shared_ptr<Geometry::Node>>& meshes);
-
-		auto getDynamicAlignment() const { return dUboAlignment; }
+		/**
+		 * \param changedOnly only write entries that held another node before, e.g. after meshes were appended to the scene
+		 */
+		void updateInstanceBuffer(const std::vector<std::shared_ptr<Geometry::Node>>& meshes, bool changedOnly = false);
 
 		std::vector<VkPipelineShaderStageCreateInfo> getShaderStages() const;
 
 		VkDescriptorBufferInfo getDescriptorInfos(size_t index) const;
 
 		std::vector<vkExt::Buffer> uniformBuffers;
-		vkExt::Buffer dynamicBuffer;
+		vkExt::Buffer instanceBuffer;
 
-		bool dynamicBufferDirty = true;
+		bool instanceBufferDirty = true;
 
 	private:
 		ShaderProgramBase shaderModules;
 
 		std::vector<vkExt::SharedMemory*> uniformBufferMemory;
-		vkExt::SharedMemory* dynamicBufferMemory;
+		vkExt::SharedMemory* instanceBufferMemory;
 
 		size_t objectCount;
-		uint32_t dUboAlignment {};
 
-		InstancedUniformBufferObject* dynamicUboData;
-		VkDeviceSize dynamicUboDataSize {};
+		std::vector<InstanceData> instanceData;
+		std::vector<const Geometry::Node*> instanceNodes; // node written to each entry
 
 		void createUniformBuffer();
-		void createDynamicBuffer(VkDeviceSize size);
+		void createInstanceBuffer(size_t count);
 	};
 
 	class DeferredShaderProgram {
@@ -97,6 +101,10 @@ namespace Shaders {
 			float exposure = 1.0f;
 			float gamma = 2.2f;
 			float _pad;
+			glm::mat4 view; // light culling works in view space
+			glm::vec4 clusterProjection; // near, far, projection[0][0], projection[1][1]
+			glm::uvec4 clusterGrid; // tiles x, tiles y, depth slices, tile size in pixels
+			glm::vec4 screenSize; // width, height, 1 / width, 1 / height
 			Lights::Light lights[SPARKLE_SHADER_LIMIT_LIGHTS];
 		};
 
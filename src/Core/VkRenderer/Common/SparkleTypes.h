@@ -21,6 +21,9 @@ namespace Vulkan {
 		int graphicsFamily = -1;
 		int presentFamily = -1;
 		int computeFamily = -1;
+		// uploads prefer a transfer only family and fall back to a second queue or the queue of the graphics family
+		int transferFamily = -1;
+		uint32_t transferQueueIndex = 0;
 
 		bool allPresent() const
 		{
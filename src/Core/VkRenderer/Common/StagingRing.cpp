@@ -0,0 +1,316 @@
+#include "StagingRing.h"
+
+#include "Application.h"
+#include "VulkanInitializers.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+using namespace Sparkle;
+
+namespace {
+void beginCommandBuffer(VkCommandBuffer cmdBuffer)
+{
+	vkResetCommandBuffer(cmdBuffer, 0);
+	auto beginInfo = vk::init::commandBufferBeginInfo();
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VK_THROW_ON_ERROR(vkBeginCommandBuffer(cmdBuffer, &beginInfo), "Begin staging command buffer failed!");
+}
+} // namespace
+
+void StagingRing::initialize(VkQueue uploadQueue, uint32_t uploadFamily, VkQueue graphicsQueue, uint32_t graphicsFamily)
+{
+	const auto& renderer = App::getHandle().getRenderBackend();
+	device = renderer->getDevice();
+	this->uploadQueue = uploadQueue;
+	this->uploadFamily = uploadFamily;
+	this->graphicsQueue = graphicsQueue;
+	this->graphicsFamily = graphicsFamily;
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(renderer->getPhysicalDevice(), &props);
+	// block compressed copies need offsets of whole blocks, 16 bytes cover all formats
+	alignment = std::max<VkDeviceSize>(16, props.limits.optimalBufferCopyOffsetAlignment);
+
+	ringMemory = new vkExt::SharedMemory();
+	renderer->createBuffer(BatchSize * BatchCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, ringBuffer, ringMemory);
+	ringBuffer.map();
+
+	VkCommandPoolCreateInfo cmdPoolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, uploadFamily };
+	VK_THROW_ON_ERROR(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &uploadPool), "CommandPool creation for staging failed!");
+	std::array<VkCommandBuffer, BatchCount> cmdBuffers;
+	auto allocInfo = vk::init::commandBufferInfo(uploadPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, BatchCount);
+	VK_THROW_ON_ERROR(vkAllocateCommandBuffers(device, &allocInfo, cmdBuffers.data()), "CommandBuffer allocation for staging failed!");
+
+	std::array<VkCommandBuffer, BatchCount> graphicsCmdBuffers = {};
+	if (separateQueue()) {
+		cmdPoolInfo.queueFamilyIndex = graphicsFamily;
+		VK_THROW_ON_ERROR(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &graphicsPool), "CommandPool creation for staging failed!");
+		allocInfo.commandPool = graphicsPool;
+		VK_THROW_ON_ERROR(vkAllocateCommandBuffers(device, &allocInfo, graphicsCmdBuffers.data()), "CommandBuffer allocation for staging failed!");
+	}
+
+	for (uint32_t i = 0; i < BatchCount; ++i) {
+		batches[i].cmdBuffer = cmdBuffers[i];
+		batches[i].graphicsCmdBuffer = graphicsCmdBuffers[i];
+		VkFenceCreateInfo fenceInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, nullptr, 0 };
+		VK_THROW_ON_ERROR(vkCreateFence(device, &fenceInfo, nullptr, &batches[i].fence), "Fence creation for staging failed!");
+		if (separateQueue()) {
+			auto semaphoreInfo = vk::init::semaphoreInfo();
+			VK_THROW_ON_ERROR(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &batches[i].uploaded), "Semaphore creation for staging failed!");
+		}
+	}
+	current = 0;
+}
+
+void StagingRing::cleanup()
+{
+	for (auto& batch : batches) {
+		wait(batch);
+		vkDestroyFence(device, batch.fence, nullptr);
+		if (batch.uploaded) {
+			vkDestroySemaphore(device, batch.uploaded, nullptr);
+		}
+		batch = Batch();
+	}
+	// destroying the pools frees their command buffers
+	vkDestroyCommandPool(device, uploadPool, nullptr);
+	if (graphicsPool) {
+		vkDestroyCommandPool(device, graphicsPool, nullptr);
+	}
+	uploadPool = VK_NULL_HANDLE;
+	graphicsPool = VK_NULL_HANDLE;
+
+	ringBuffer.destroy(true);
+	delete (ringMemory);
+	ringMemory = nullptr;
+}
+
+StagingRing::Allocation StagingRing::stage(const void* data, VkDeviceSize size)
+{
+	if (size > BatchSize) {
+		commandBuffer();
+		vkExt::Buffer buffer;
+		auto* memory = new vkExt::SharedMemory();
+		App::getHandle().getRenderBackend()->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, memory);
+		buffer.map();
+		buffer.copyTo(data, size);
+		buffer.unmap();
+		batches[current].dedicated.emplace_back(buffer, memory);
+		return { buffer.buffer, 0 };
+	}
+
+	auto offset = (batches[current].used + alignment - 1) / alignment * alignment;
+	if (batches[current].recording && offset + size > BatchSize) {
+		flush();
+		offset = 0;
+	}
+	commandBuffer();
+	auto& batch = batches[current];
+	batch.used = offset + size;
+
+	const auto ringOffset = current * BatchSize + offset;
+	std::memcpy(static_cast<unsigned char*>(ringMemory->mapped) + ringOffset, data, static_cast<size_t>(size));
+	return { ringBuffer.buffer, ringOffset };
+}
+
+VkCommandBuffer StagingRing::commandBuffer()
+{
+	if (!batches[current].recording) {
+		begin();
+	}
+	return batches[current].cmdBuffer;
+}
+
+VkCommandBuffer StagingRing::graphicsCommandBuffer()
+{
+	if (!separateQueue()) {
+		return commandBuffer();
+	}
+	commandBuffer();
+	auto& batch = batches[current];
+	if (!batch.graphicsRecording) {
+		beginCommandBuffer(batch.graphicsCmdBuffer);
+		batch.graphicsRecording = true;
+	}
+	acquire(batch);
+	return batch.graphicsCmdBuffer;
+}
+
+void StagingRing::copyToBuffer(const void* data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset)
+{
+	if (size == 0) {
+		return;
+	}
+	const auto staged = stage(data, size);
+	const VkBufferCopy region = { staged.offset, dstOffset, size };
+	vkCmdCopyBuffer(commandBuffer(), staged.buffer, dst, 1, &region);
+
+	if (ownershipTransfer()) {
+		auto& batch = batches[current];
+		VkBufferMemoryBarrier barrier = vk::init::bufferMemoryBarrier();
+		barrier.buffer = dst;
+		barrier.offset = dstOffset;
+		barrier.size = size;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		barrier.srcQueueFamilyIndex = uploadFamily;
+		barrier.dstQueueFamilyIndex = graphicsFamily;
+		batch.bufferReleases.push_back(barrier);
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		batch.bufferAcquires.push_back(barrier);
+	}
+}
+
+void StagingRing::releaseImage(VkImage image, uint32_t mipLevels, VkImageLayout newLayout)
+{
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = newLayout;
+	barrier.image = image;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	// images that stay in TRANSFER_DST_OPTIMAL get their mip levels blitted
+	const VkAccessFlags dstAccess = newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL ? VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT;
+
+	if (!ownershipTransfer()) {
+		barrier.dstAccessMask = dstAccess;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		vkCmdPipelineBarrier(commandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		return;
+	}
+
+	// release and acquire describe the same layout transition
+	auto& batch = batches[current];
+	barrier.dstAccessMask = 0;
+	barrier.srcQueueFamilyIndex = uploadFamily;
+	barrier.dstQueueFamilyIndex = graphicsFamily;
+	batch.imageReleases.push_back(barrier);
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = dstAccess;
+	batch.imageAcquires.push_back(barrier);
+}
+
+void StagingRing::flush()
+{
+	auto& batch = batches[current];
+	if (!batch.recording) {
+		return;
+	}
+
+	if (!batch.bufferReleases.empty() || !batch.imageReleases.empty()) {
+		vkCmdPipelineBarrier(batch.cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+		    static_cast<uint32_t>(batch.bufferReleases.size()), batch.bufferReleases.data(),
+		    static_cast<uint32_t>(batch.imageReleases.size()), batch.imageReleases.data());
+		batch.bufferReleases.clear();
+		batch.imageReleases.clear();
+	}
+	// the commands of later submits may read everything written by this batch
+	VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT };
+	if (!separateQueue()) {
+		vkCmdPipelineBarrier(batch.cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+	VK_THROW_ON_ERROR(vkEndCommandBuffer(batch.cmdBuffer), "End staging command buffer failed!");
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &batch.cmdBuffer;
+	if (!separateQueue()) {
+		VK_THROW_ON_ERROR(vkQueueSubmit(uploadQueue, 1, &submitInfo, batch.fence), "Staging submit failed!");
+	} else {
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &batch.uploaded;
+		VK_THROW_ON_ERROR(vkQueueSubmit(uploadQueue, 1, &submitInfo, VK_NULL_HANDLE), "Staging submit failed!");
+
+		// the graphics queue waits for the upload, its later submits wait for these commands
+		if (!batch.graphicsRecording) {
+			beginCommandBuffer(batch.graphicsCmdBuffer);
+		}
+		acquire(batch);
+		barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+		vkCmdPipelineBarrier(batch.graphicsCmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		VK_THROW_ON_ERROR(vkEndCommandBuffer(batch.graphicsCmdBuffer), "End staging command buffer failed!");
+
+		const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		VkSubmitInfo graphicsSubmitInfo = {};
+		graphicsSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		graphicsSubmitInfo.waitSemaphoreCount = 1;
+		graphicsSubmitInfo.pWaitSemaphores = &batch.uploaded;
+		graphicsSubmitInfo.pWaitDstStageMask = &waitStage;
+		graphicsSubmitInfo.commandBufferCount = 1;
+		graphicsSubmitInfo.pCommandBuffers = &batch.graphicsCmdBuffer;
+		VK_THROW_ON_ERROR(vkQueueSubmit(graphicsQueue, 1, &graphicsSubmitInfo, batch.fence), "Staging submit failed!");
+		batch.graphicsRecording = false;
+	}
+	batch.recording = false;
+	batch.submitted = true;
+
+	current = (current + 1) % BatchCount;
+}
+
+void StagingRing::finish()
+{
+	flush();
+	for (auto& batch : batches) {
+		wait(batch);
+	}
+}
+
+uint64_t StagingRing::batchId()
+{
+	commandBuffer();
+	return batches[current].id;
+}
+
+bool StagingRing::complete(uint64_t id) const
+{
+	for (const auto& batch : batches) {
+		if (batch.id == id) {
+			return !batch.recording && (!batch.submitted || vkGetFenceStatus(device, batch.fence) == VK_SUCCESS);
+		}
+	}
+	// the batch was waited for before it was reused
+	return true;
+}
+
+void StagingRing::begin()
+{
+	auto& batch = batches[current];
+	wait(batch);
+
+	beginCommandBuffer(batch.cmdBuffer);
+	batch.used = 0;
+	batch.id = ++lastId;
+	batch.recording = true;
+}
+
+void StagingRing::acquire(Batch& batch)
+{
+	if (batch.bufferAcquires.empty() && batch.imageAcquires.empty()) {
+		return;
+	}
+	vkCmdPipelineBarrier(batch.graphicsCmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+	    static_cast<uint32_t>(batch.bufferAcquires.size()), batch.bufferAcquires.data(),
+	    static_cast<uint32_t>(batch.imageAcquires.size()), batch.imageAcquires.data());
+	batch.bufferAcquires.clear();
+	batch.imageAcquires.clear();
+}
+
+void StagingRing::wait(Batch& batch)
+{
+	if (batch.submitted) {
+		VK_THROW_ON_ERROR(vkWaitForFences(device, 1, &batch.fence, VK_TRUE, std::numeric_limits<uint64_t>::max()), "Waiting for staging fence failed!");
+		vkResetFences(device, 1, &batch.fence);
+		batch.submitted = false;
+	}
+	for (auto& dedicated : batch.dedicated) {
+		dedicated.first.destroy(true);
+		delete (dedicated.second);
+	}
+	batch.dedicated.clear();
+}
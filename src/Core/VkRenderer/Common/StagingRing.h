@@ -0,0 +1,118 @@
+#ifndef STAGING_RING_H
+#define STAGING_RING_H
+
+#include "VulkanExtension.h"
+
+#include <array>
+#include <utility>
+#include <vector>
+
+namespace Sparkle {
+/**
+ * persistently mapped staging memory for uploads to device local buffers and images. Copies are recorded into the
+ * command buffer of the current batch and submitted together, a batch is reused once its fence signaled.
+ * With an upload queue apart from the graphics queue the batch signals a semaphore that a graphics queue submit waits
+ * for, resources of another queue family are released by the upload queue and acquired by that submit.
+ * Only used by the thread that owns the renderer.
+ */
+class StagingRing {
+public:
+	// staging memory of one batch, larger uploads get a buffer of their own that is freed with their batch
+	static constexpr VkDeviceSize BatchSize = VkDeviceSize(16) << 20;
+	// batches in flight before staging waits for the oldest one
+	static constexpr uint32_t BatchCount = 4;
+
+	struct Allocation {
+		VkBuffer buffer;
+		VkDeviceSize offset;
+	};
+
+	void initialize(VkQueue uploadQueue, uint32_t uploadFamily, VkQueue graphicsQueue, uint32_t graphicsFamily);
+	void cleanup();
+
+	/**
+	 * copy data into staging memory of the current batch, a full batch is flushed first.
+	 * Commands reading the allocation are recorded into commandBuffer() after staging.
+	 */
+	Allocation stage(const void* data, VkDeviceSize size);
+	/**
+	 * command buffer of the current batch on the upload queue, which may only support transfer commands
+	 */
+	VkCommandBuffer commandBuffer();
+	/**
+	 * command buffer of the current batch on the graphics queue, runs after the upload commands and owns the images
+	 * released until now. Same as commandBuffer() without a separate upload queue.
+	 */
+	VkCommandBuffer graphicsCommandBuffer();
+	void copyToBuffer(const void* data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset = 0);
+	/**
+	 * hand an image written by commandBuffer() in TRANSFER_DST_OPTIMAL over to the graphics queue in newLayout
+	 */
+	void releaseImage(VkImage image, uint32_t mipLevels, VkImageLayout newLayout);
+
+	/**
+	 * submit the recorded commands, later submits to the graphics queue see their results
+	 */
+	void flush();
+	/**
+	 * flush and wait for all batches, before staged resources are destroyed or read by another queue
+	 */
+	void finish();
+
+	/**
+	 * id of the batch that commands are recorded into now, starts a batch if none is recording
+	 */
+	uint64_t batchId();
+	/**
+	 * true once the batch with this id finished on the gpu, does not wait
+	 */
+	bool complete(uint64_t id) const;
+
+private:
+	struct Batch {
+		VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+		VkCommandBuffer graphicsCmdBuffer = VK_NULL_HANDLE;
+		VkSemaphore uploaded = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		VkDeviceSize used = 0;
+		uint64_t id = 0;
+		bool recording = false;
+		bool graphicsRecording = false;
+		bool submitted = false;
+		std::vector<std::pair<vkExt::Buffer, vkExt::SharedMemory*>> dedicated;
+		// ownership transfers, released at the end of the upload commands and acquired by the graphics commands
+		std::vector<VkBufferMemoryBarrier> bufferReleases;
+		std::vector<VkImageMemoryBarrier> imageReleases;
+		std::vector<VkBufferMemoryBarrier> bufferAcquires;
+		std::vector<VkImageMemoryBarrier> imageAcquires;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueue uploadQueue = VK_NULL_HANDLE;
+	VkQueue graphicsQueue = VK_NULL_HANDLE;
+	uint32_t uploadFamily = 0;
+	uint32_t graphicsFamily = 0;
+	VkCommandPool uploadPool = VK_NULL_HANDLE;
+	VkCommandPool graphicsPool = VK_NULL_HANDLE;
+	VkDeviceSize alignment = 16;
+
+	vkExt::Buffer ringBuffer;
+	vkExt::SharedMemory* ringMemory = nullptr;
+
+	std::array<Batch, BatchCount> batches;
+	uint32_t current = 0;
+	uint64_t lastId = 0;
+
+	bool separateQueue() const { return uploadQueue != graphicsQueue; }
+	bool ownershipTransfer() const { return uploadFamily != graphicsFamily; }
+
+	/**
+	 * wait until the current batch finished on the gpu and begin recording it again
+	 */
+	void begin();
+	void acquire(Batch& batch);
+	void wait(Batch& batch);
+};
+} // namespace Sparkle
+
+#endif
@@ -108,6 +108,18 @@ namespace vk {
 			return write;
 		}
 
+		inline VkWriteDescriptorSet writeDescriptorSet(VkDescriptorSet targetSet, VkDescriptorType type, uint32_t binding, const VkDescriptorImageInfo* imageInfo, uint32_t count = 1)
+		{
+			VkWriteDescriptorSet write = {};
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = targetSet;
+			write.descriptorType = type;
+			write.dstBinding = binding;
+			write.pImageInfo = imageInfo;
+			write.descriptorCount = count;
+			return write;
+		}
+
 		inline VkCommandBufferBeginInfo commandBufferBeginInfo()
 		{
 			VkCommandBufferBeginInfo info = {};
@@ -10,7 +10,7 @@ void ComputePipeline::initialize(uint32_t queueIndex, uint32_t cmdBuffCount)
 {
 	auto device = App::getHandle().getRenderBackend()->getDevice();
 	std::array<VkDescriptorPoolSize, 2> poolSizes = {
-		vk::init::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3),
+		vk::init::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5),
 		vk::init::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1)
 	};
 
@@ -24,11 +24,13 @@ void ComputePipeline::initialize(uint32_t queueIndex, uint32_t cmdBuffCount)
 	queueInfo.queueCount = 1;
 	vkGetDeviceQueue(device, queueIndex, 0, &queue);
 
-	std::array<VkDescriptorSetLayoutBinding, 4> setLayoutBindings = {
+	std::array<VkDescriptorSetLayoutBinding, 6> setLayoutBindings = {
 		vk::init::setLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
 		vk::init::setLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
 		vk::init::setLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
-		vk::init::setLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3)
+		vk::init::setLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+		vk::init::setLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+		vk::init::setLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5)
 	};
 
 	auto setLayoutInfo = vk::init::setLayoutInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
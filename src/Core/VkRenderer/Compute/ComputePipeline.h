@@ -12,14 +12,43 @@ struct ComputePipeline {
 		glm::vec4 frustumPlanes[6];
 		glm::vec3 cameraPos;
 		uint32_t meshCount;
+		float lodScale; // see Geometry::Mesh::selectLod
+		uint32_t clusterDrawCount; // invocations, one per cluster and instance
 	} ubo;
 
+	/**
+	 * one entry per instance, lod ranges are absolute in the index buffer (Geometry::Mesh::MaxLods entries)
+	 */
 	struct MeshData {
 		glm::mat4 model;
 		Geometry::BoundingSphere boundingSphere;
-		uint32_t firstIndex;
+		glm::uvec4 lodFirstIndex;
+		glm::uvec4 lodIndexCount;
+		glm::vec4 lodError;
+		uint32_t lodCount;
+		uint32_t firstCluster; // ClusterData of lod 0
+		uint32_t pad[2];
+	};
+	static_assert(Geometry::Mesh::MaxLods == 4, "MeshData stores the lods in 4 component vectors");
+
+	/**
+	 * one entry per cluster of every uploaded geometry, shared by its instances
+	 */
+	struct ClusterData {
+		uint32_t firstIndex; // absolute in the index buffer
 		uint32_t indexCount;
-		glm::vec2 pad;
+		uint32_t pad[2];
+		glm::vec4 boundingSphere; // center xyz, radius
+		glm::vec4 cone;
+	};
+
+	/**
+	 * one invocation of the cull shader, instance index into MeshData and cluster relative to MeshData::firstCluster
+	 * invocation i writes indirect draw command i
+	 */
+	struct ClusterDraw {
+		uint32_t instance;
+		uint32_t cluster;
 	};
 
 	VkQueue queue;
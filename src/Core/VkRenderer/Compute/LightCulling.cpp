@@ -0,0 +1,141 @@
+#include "LightCulling.h"
+
+#include "Application.h"
+#include "FileReader.h"
+#include "VulkanInitializers.h"
+
+using namespace Sparkle;
+
+// matches local_size_x of lightcull.comp
+static constexpr uint32_t ClustersPerGroup = 64;
+
+void LightCulling::initialize(VkExtent2D extent, const Shaders::DeferredShaderProgram& program, size_t imageCount)
+{
+	const auto& renderer = App::getHandle().getRenderBackend();
+	auto device = renderer->getDevice();
+
+	grid = glm::uvec4((extent.width + TileSize - 1) / TileSize, (extent.height + TileSize - 1) / TileSize, DepthSlices, TileSize);
+	const auto setCount = static_cast<uint32_t>(imageCount);
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes = {
+		vk::init::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, setCount),
+		vk::init::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * setCount)
+	};
+	auto descPoolInfo = vk::init::descriptorPoolInfo(poolSizes.data(), static_cast<uint32_t>(poolSizes.size()), setCount);
+	VK_THROW_ON_ERROR(vkCreateDescriptorPool(device, &descPoolInfo, nullptr, &descPool), "DescriptorPool creation for light culling failed!");
+
+	std::array<VkDescriptorSetLayoutBinding, 3> setLayoutBindings = {
+		vk::init::setLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+		vk::init::setLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		vk::init::setLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2)
+	};
+	auto setLayoutInfo = vk::init::setLayoutInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+	VK_THROW_ON_ERROR(vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &descSetLayout), "DescriptorSetLayout creation for light culling failed!");
+
+	auto pipeLayoutInfo = vk::init::pipelineLayoutInfo(&descSetLayout);
+	VK_THROW_ON_ERROR(vkCreatePipelineLayout(device, &pipeLayoutInfo, nullptr, &pipelineLayout), "PipelineLayout creation for light culling failed!");
+
+	auto pipeCreateInfo = vk::init::computePipelineCreateInfo(pipelineLayout);
+	shader = Shaders::createShaderModule(Tools::FileReader::readFile("shaders/lightcull.comp.spv"));
+	pipeCreateInfo.stage = vk::init::shaderStageInfo(shader, VK_SHADER_STAGE_COMPUTE_BIT);
+	VK_THROW_ON_ERROR(vkCreateComputePipelines(device, nullptr, 1, &pipeCreateInfo, nullptr, &pipeline), "Light culling pipeline creation failed!");
+
+	const VkDeviceSize clusterSize = static_cast<VkDeviceSize>(grid.x) * grid.y * grid.z * ClusterStride * sizeof(uint32_t);
+	clusterBuffers.resize(imageCount);
+	overflowBuffers.resize(imageCount);
+	descSets.resize(imageCount);
+	for (size_t i = 0; i < imageCount; ++i) {
+		clusterMemory.push_back(new vkExt::SharedMemory());
+		renderer->createBuffer(clusterSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, clusterBuffers[i], clusterMemory.back());
+		overflowMemory.push_back(new vkExt::SharedMemory());
+		renderer->createBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, overflowBuffers[i], overflowMemory.back());
+		*static_cast<uint32_t*>(overflowBuffers[i].mapped()) = 0;
+
+		auto allocInfo = vk::init::descriptorSetAllocateInfo(descPool, &descSetLayout, 1);
+		VK_THROW_ON_ERROR(vkAllocateDescriptorSets(device, &allocInfo, &descSets[i]), "DescriptorSet allocation for light culling failed!");
+
+		const auto uboInfo = program.getDescriptorInfos(i);
+		const auto clusterInfo = getDescriptorInfo(i);
+		std::array<VkWriteDescriptorSet, 3> writes = {
+			vk::init::writeDescriptorSet(descSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uboInfo),
+			vk::init::writeDescriptorSet(descSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &clusterInfo),
+			vk::init::writeDescriptorSet(descSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &overflowBuffers[i].descriptor)
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+}
+
+void LightCulling::cleanup()
+{
+	auto device = App::getHandle().getRenderBackend()->getDevice();
+
+	vkDestroyPipeline(device, pipeline, nullptr);
+	vkDestroyShaderModule(device, shader, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, descSetLayout, nullptr);
+	vkDestroyDescriptorPool(device, descPool, nullptr);
+	descSets.clear();
+
+	for (auto& buffer : clusterBuffers) {
+		buffer.destroy(true);
+	}
+	for (auto mem : clusterMemory) {
+		delete (mem);
+	}
+	clusterBuffers.clear();
+	clusterMemory.clear();
+
+	for (auto& buffer : overflowBuffers) {
+		buffer.destroy(true);
+	}
+	for (auto mem : overflowMemory) {
+		delete (mem);
+	}
+	overflowBuffers.clear();
+	overflowMemory.clear();
+}
+
+void LightCulling::record(VkCommandBuffer cmdBuffer, size_t index) const
+{
+	// the previous frame on this image may still read the clusters in its deferred pass
+	VkBufferMemoryBarrier bufferBarrier = vk::init::bufferMemoryBarrier();
+	bufferBarrier.buffer = clusterBuffers[index].buffer;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+	bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descSets[index], 0, nullptr);
+	const auto clusterCount = grid.x * grid.y * grid.z;
+	vkCmdDispatch(cmdBuffer, (clusterCount + ClustersPerGroup - 1) / ClustersPerGroup, 1, 1);
+
+	bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+	// takeOverflow reads the counter on the host once the frame fence signaled
+	VkBufferMemoryBarrier overflowBarrier = vk::init::bufferMemoryBarrier();
+	overflowBarrier.buffer = overflowBuffers[index].buffer;
+	overflowBarrier.size = VK_WHOLE_SIZE;
+	overflowBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	overflowBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	overflowBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	overflowBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &overflowBarrier, 0, nullptr);
+}
+
+VkDescriptorBufferInfo LightCulling::getDescriptorInfo(size_t index) const
+{
+	return { clusterBuffers[index].buffer, 0, VK_WHOLE_SIZE };
+}
+
+uint32_t LightCulling::takeOverflow(size_t index)
+{
+	auto counter = static_cast<uint32_t*>(overflowBuffers[index].mapped());
+	const auto clusters = *counter;
+	*counter = 0;
+	return clusters;
+}
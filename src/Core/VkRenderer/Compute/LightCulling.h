@@ -0,0 +1,53 @@
+#ifndef LIGHT_CULLING_H
+#define LIGHT_CULLING_H
+
+#include "VulkanExtension.h"
+
+#include "Shader.h"
+
+namespace Sparkle {
+/**
+ * bins the lights of the deferred fragment shader uniforms into clusters of screen tiles and exponential depth slices,
+ * the deferred pass only shades the lights of the cluster a fragment falls into
+ */
+struct LightCulling {
+	static constexpr uint32_t TileSize = 64; // pixels
+	static constexpr uint32_t DepthSlices = 16;
+	// lights of a cluster beyond this limit are not shaded, the clusters that dropped lights are counted per frame
+	// and reported by takeOverflow. 256 uints per cluster take about 8 MB per swapchain image at 1920x1080
+	static constexpr uint32_t MaxLightsPerCluster = 255;
+	// uints per cluster, the light count followed by the light indices
+	static constexpr uint32_t ClusterStride = MaxLightsPerCluster + 1;
+
+	VkDescriptorPool descPool;
+	VkDescriptorSetLayout descSetLayout;
+	std::vector<VkDescriptorSet> descSets; // one per swapchain image, like the uniform buffers
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+	VkShaderModule shader;
+
+	std::vector<vkExt::Buffer> clusterBuffers;
+	std::vector<vkExt::SharedMemory*> clusterMemory;
+	// host visible counter of the clusters that exceeded MaxLightsPerCluster
+	std::vector<vkExt::Buffer> overflowBuffers;
+	std::vector<vkExt::SharedMemory*> overflowMemory;
+
+	glm::uvec4 grid; // tiles x, tiles y, depth slices, tile size
+
+	void initialize(VkExtent2D extent, const Shaders::DeferredShaderProgram& program, size_t imageCount);
+	void cleanup();
+
+	/**
+	 * records the culling for swapchain image index, the cluster buffer is ready for the fragment shader afterwards
+	 */
+	void record(VkCommandBuffer cmdBuffer, size_t index) const;
+	VkDescriptorBufferInfo getDescriptorInfo(size_t index) const;
+	/**
+	 * clusters that dropped lights in the last culling of swapchain image index, resets the counter.
+	 * Called before the image is submitted again
+	 */
+	uint32_t takeOverflow(size_t index);
+};
+} // namespace Sparkle
+
+#endif
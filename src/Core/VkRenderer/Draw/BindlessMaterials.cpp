@@ -0,0 +1,164 @@
+#include "BindlessMaterials.h"
+
+#include "Application.h"
+#include "Geometry.h"
+#include "VulkanInitializers.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <unordered_map>
+
+using namespace Sparkle;
+
+void BindlessMaterials::initialize(uint32_t textureCount)
+{
+	const auto& renderer = App::getHandle().getRenderBackend();
+	auto device = renderer->getDevice();
+	textureCapacity = textureCount;
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes = {
+		vk::init::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCapacity),
+		vk::init::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1)
+	};
+	auto descPoolInfo = vk::init::descriptorPoolInfo(poolSizes.data(), static_cast<uint32_t>(poolSizes.size()), 1);
+	descPoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	VK_THROW_ON_ERROR(vkCreateDescriptorPool(device, &descPoolInfo, nullptr, &descPool), "DescriptorPool creation for bindless materials failed!");
+
+	std::array<VkDescriptorSetLayoutBinding, 2> setLayoutBindings = {
+		vk::init::setLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0, textureCapacity),
+		vk::init::setLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)
+	};
+	// only the slots of the current scene textures are written, new ones while recorded draws use the others
+	std::array<VkDescriptorBindingFlagsEXT, 2> bindingFlags = {
+		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT,
+		0
+	};
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+	bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+	auto setLayoutInfo = vk::init::setLayoutInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+	setLayoutInfo.pNext = &bindingFlagsInfo;
+	setLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	VK_THROW_ON_ERROR(vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &descSetLayout), "DescriptorSetLayout creation for bindless materials failed!");
+
+	auto allocInfo = vk::init::descriptorSetAllocateInfo(descPool, &descSetLayout, 1);
+	VK_THROW_ON_ERROR(vkAllocateDescriptorSets(device, &allocInfo, &descSet), "DescriptorSet allocation for bindless materials failed!");
+
+	// the materials buffer is never replaced, its descriptor stays valid for the recorded draws
+	createMaterialBuffer(textureCapacity);
+}
+
+void BindlessMaterials::cleanup()
+{
+	auto device = App::getHandle().getRenderBackend()->getDevice();
+
+	vkDestroyDescriptorSetLayout(device, descSetLayout, nullptr);
+	vkDestroyDescriptorPool(device, descPool, nullptr);
+
+	if (materialBuffer.buffer) {
+		materialBuffer.destroy(true);
+	}
+	delete (materialMemory);
+	materialMemory = nullptr;
+	materialCapacity = 0;
+	writtenTextures.clear();
+	writtenMaterials.clear();
+}
+
+bool BindlessMaterials::update(const Geometry::Scene& scene)
+{
+	std::unordered_map<const Texture*, uint32_t> textureIndices;
+	std::vector<VkDescriptorImageInfo> imageInfos;
+	const auto textureIndex = [&](const std::shared_ptr<Texture>& texture) {
+		const auto found = textureIndices.find(texture.get());
+		if (found != textureIndices.end()) {
+			return found->second;
+		}
+		const auto index = static_cast<uint32_t>(imageInfos.size());
+		textureIndices[texture.get()] = index;
+		imageInfos.push_back(texture->descriptor());
+		return index;
+	};
+
+	std::vector<MaterialData> materials;
+	materials.reserve(scene.materialCache.size());
+	for (const auto& material : scene.materialCache) {
+		const auto& textures = material->getTextures();
+		// missing textures are replaced by the specular map, like in Material::updateDescriptorSets
+		const auto placeholder = textures.find(TEX_TYPE_SPECULAR);
+		if (placeholder == textures.end()) {
+			throw std::runtime_error("Only textured material supported");
+		}
+		MaterialData data = {};
+		for (uint32_t slot = 0; slot < MaterialTextures; ++slot) {
+			// texture types and binding slots share their numbering
+			const auto texture = textures.find(slot);
+			data.textures[slot] = textureIndex(texture != textures.end() ? texture->second : placeholder->second);
+		}
+		data.features = material->getUniforms().features;
+		materials.push_back(data);
+	}
+	if (imageInfos.size() > textureCapacity || materials.size() > materialCapacity) {
+		return false;
+	}
+	for (size_t i = 0; i < scene.materialCache.size(); ++i) {
+		scene.materialCache[i]->setBindlessIndex(static_cast<uint32_t>(i));
+	}
+
+	// the indices are assigned in scene order, appended meshes leave the slots of the existing ones unchanged
+	auto device = App::getHandle().getRenderBackend()->getDevice();
+	writtenTextures.resize(std::max(writtenTextures.size(), imageInfos.size()));
+	for (size_t i = 0; i < imageInfos.size();) {
+		if (sameDescriptor(writtenTextures[i], imageInfos[i])) {
+			++i;
+			continue;
+		}
+		auto end = i + 1;
+		while (end < imageInfos.size() && !sameDescriptor(writtenTextures[end], imageInfos[end])) {
+			++end;
+		}
+		auto write = vk::init::writeDescriptorSet(descSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageInfos[i], static_cast<uint32_t>(end - i));
+		write.dstArrayElement = static_cast<uint32_t>(i);
+		vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+		std::copy(imageInfos.begin() + i, imageInfos.begin() + end, writtenTextures.begin() + i);
+		i = end;
+	}
+
+	const auto writtenCount = writtenMaterials.size();
+	writtenMaterials.resize(std::max(writtenCount, materials.size()));
+	for (size_t i = 0; i < materials.size(); ++i) {
+		if (i >= writtenCount || std::memcmp(&writtenMaterials[i], &materials[i], sizeof(MaterialData)) != 0) {
+			std::memcpy(static_cast<MaterialData*>(materialBuffer.mapped()) + i, &materials[i], sizeof(MaterialData));
+			writtenMaterials[i] = materials[i];
+		}
+	}
+	return true;
+}
+
+bool BindlessMaterials::sameDescriptor(const VkDescriptorImageInfo& a, const VkDescriptorImageInfo& b)
+{
+	return a.imageView == b.imageView && a.sampler == b.sampler && a.imageLayout == b.imageLayout;
+}
+
+void BindlessMaterials::createMaterialBuffer(size_t count)
+{
+	const auto& renderer = App::getHandle().getRenderBackend();
+
+	if (materialBuffer.buffer) {
+		materialBuffer.destroy(true);
+	}
+	delete (materialMemory);
+	materialMemory = new vkExt::SharedMemory();
+	materialCapacity = count;
+
+	const VkDeviceSize bufferSize = materialCapacity * sizeof(MaterialData);
+	renderer->createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, materialBuffer, materialMemory);
+	materialBuffer.map();
+
+	const VkDescriptorBufferInfo bufferInfo = { materialBuffer.buffer, 0, bufferSize };
+	auto write = vk::init::writeDescriptorSet(descSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &bufferInfo);
+	vkUpdateDescriptorSets(renderer->getDevice(), 1, &write, 0, nullptr);
+}
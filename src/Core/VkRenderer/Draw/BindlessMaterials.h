@@ -0,0 +1,61 @@
+#ifndef BINDLESS_MATERIALS_H
+#define BINDLESS_MATERIALS_H
+
+#include "VulkanExtension.h"
+
+#include "Material.h"
+
+#include <vector>
+
+namespace Sparkle {
+namespace Geometry {
+	class Scene;
+}
+
+/**
+ * one descriptor set with the textures of all scene materials and a storage buffer of the materials,
+ * the MRT pass selects the material of an instance by its index instead of binding a set per draw
+ */
+struct BindlessMaterials {
+	// upper bound of the texture array, lowered to the update after bind sampler limits of the device.
+	// The materials buffer has as many entries, larger scenes fall back to a descriptor set per material
+	static constexpr uint32_t TextureLimit = 4096;
+	static constexpr uint32_t MaterialTextures = 5; // diffuse, spec, normal, roughness, metallic
+
+	// matches MaterialData of MRT.frag.hlsl
+	struct MaterialData {
+		uint32_t textures[MaterialTextures]; // texture array indices, in the order of the BINDING_* slots
+		Material::MaterialFeatures features;
+		uint32_t pad[2];
+	};
+
+	VkDescriptorPool descPool;
+	VkDescriptorSetLayout descSetLayout;
+	VkDescriptorSet descSet;
+	uint32_t textureCapacity = 0;
+
+	vkExt::Buffer materialBuffer;
+	vkExt::SharedMemory* materialMemory = nullptr;
+	size_t materialCapacity = 0;
+
+	void initialize(uint32_t textureCount);
+	void cleanup();
+
+	/**
+	 * assign indices to the materials of the scene and write the textures and entries that changed.
+	 * Recorded draws stay valid, only the slots of replaced textures must not be used by frames in flight
+	 * \return false without writing anything if the scene has more textures or materials than the set
+	 */
+	bool update(const Geometry::Scene& scene);
+
+private:
+	// contents of the set, only changed slots are written
+	std::vector<VkDescriptorImageInfo> writtenTextures;
+	std::vector<MaterialData> writtenMaterials;
+
+	void createMaterialBuffer(size_t count);
+	static bool sameDescriptor(const VkDescriptorImageInfo& a, const VkDescriptorImageInfo& b);
+};
+} // namespace Sparkle
+
+#endif
@@ -1,6 +1,7 @@
 #include "GraphicsPipeline.h"
 #include "Application.h"
 #include "Geometry.h"
+#include "VertexPacking.h"
 #include "Material.h"
 
 #include "VulkanInitializers.h"
@@ -191,8 +192,9 @@ void DeferredDraw::initPipelines()
 		VK_THROW_ON_ERROR(vkCreateRenderPass(device, &renderPassInfo, nullptr, &deferredRenderPass), "RenderPass creation failed!");
 
 		// create shader modules
-		Shaders::ShaderSource vtx = { Shaders::ShaderType::Vertex, "shaders/MRT.vert.hlsl.spv" };
-		Shaders::ShaderSource frag = { Shaders::ShaderType::Fragment, "shaders/MRT.frag.hlsl.spv" };
+		const auto vertexFormat = renderer->getVertexFormat();
+		Shaders::ShaderSource vtx = { Shaders::ShaderType::Vertex, vertexFormat == Geometry::VertexFormat::Full ? "shaders/MRT.vert.hlsl.spv" : "shaders/MRT.compact.vert.hlsl.spv" };
+		Shaders::ShaderSource frag = { Shaders::ShaderType::Fragment, renderer->bindlessMaterialsEnabled() ? "shaders/MRT.bindless.frag.hlsl.spv" : "shaders/MRT.frag.hlsl.spv" };
 		std::vector<Shaders::ShaderSource> shaders = { vtx, frag };
 		mrtProgram = std::make_unique<Shaders::MRTShaderProgram>(shaders, imageViewsRef.size());
 
@@ -201,12 +203,13 @@ void DeferredDraw::initPipelines()
 		Shaders::ShaderSource dFrg = { Shaders::ShaderType::Fragment, "shaders/deferred.frag.hlsl.spv" };
 		std::vector<Shaders::ShaderSource> dShaders = { dVtx, dFrg };
 		deferredProgram = std::make_unique<Shaders::DeferredShaderProgram>(dShaders, imageViewsRef.size());
+		lightCulling.initialize(extent, *deferredProgram, imageViewsRef.size());
 
 		auto mrtStages = mrtProgram->getShaderStages();
 		auto defStages = deferredProgram->getShaderStages();
 
-		auto bindingDescription = Geometry::Vertex::getBindingDescriptions();
-		auto attributeDescriptions = Geometry::Vertex::getAttributeDescriptions();
+		auto bindingDescription = Geometry::VertexPacking::getBindingDescriptions(vertexFormat);
+		auto attributeDescriptions = Geometry::VertexPacking::getAttributeDescriptions(vertexFormat);
 
 		VkPipelineVertexInputStateCreateInfo vtxInputInfo = {};
 		vtxInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -265,7 +268,7 @@ void DeferredDraw::initPipelines()
 
 		const VkDescriptorSetLayoutBinding modelBinding = {
 			1,
-			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 			1,
 			VK_SHADER_STAGE_VERTEX_BIT,
 			nullptr
@@ -313,6 +316,14 @@ void DeferredDraw::initPipelines()
 			nullptr
 		};
 		deferredBindings.push_back(pbrTexBinding);
+		const VkDescriptorSetLayoutBinding clusterLightsBinding = {
+			5,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			1,
+			VK_SHADER_STAGE_FRAGMENT_BIT,
+			nullptr
+		};
+		deferredBindings.push_back(clusterLightsBinding);
 
 		VkDescriptorSetLayoutCreateInfo layoutInfo = {
 			VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
@@ -335,8 +346,8 @@ void DeferredDraw::initPipelines()
 			2u * bufferSetCount
 		};
 		sizes[1] = {
-			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
-			1u * bufferSetCount
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			2u * bufferSetCount
 		};
 		sizes[2] = {
 			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
@@ -386,7 +397,8 @@ void DeferredDraw::initPipelines()
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = 2;
 		pipelineLayoutInfo.pSetLayouts = descLayouts;
-		pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+		// bindless materials read their features from the materials buffer
+		pipelineLayoutInfo.pushConstantRangeCount = renderer->bindlessMaterialsEnabled() ? 0 : static_cast<uint32_t>(pushConstantRanges.size());
 		pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
 		;
 
@@ -509,20 +521,20 @@ void DeferredDraw::updateMRTDescriptorSets() const
 		};
 		write.push_back(ubo);
 
-		if (mrtProgram->dynamicBuffer.buffer) {
-			const VkWriteDescriptorSet dyn = {
+		if (mrtProgram->instanceBuffer.buffer) {
+			const VkWriteDescriptorSet instances = {
 				VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
 				nullptr,
 				descSet,
 				1,
 				0,
 				1,
-				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				nullptr,
-				&mrtProgram->dynamicBuffer.descriptor,
+				&mrtProgram->instanceBuffer.descriptor,
 				nullptr
 			};
-			write.push_back(dyn);
+			write.push_back(instances);
 		}
 
 		vkUpdateDescriptorSets(App::getHandle().getRenderBackend()->getDevice(), static_cast<uint32_t>(write.size()), write.data(), 0, nullptr);
@@ -625,6 +637,21 @@ void DeferredDraw::updateDeferredDescriptorSets() const
 		};
 		write.push_back(pbr);
 
+		auto clusterInfo = lightCulling.getDescriptorInfo(i);
+		const VkWriteDescriptorSet clusterLights = {
+			VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			nullptr,
+			descSet,
+			5,
+			0,
+			1,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			nullptr,
+			&clusterInfo,
+			nullptr
+		};
+		write.push_back(clusterLights);
+
 		vkUpdateDescriptorSets(App::getHandle().getRenderBackend()->getDevice(), static_cast<uint32_t>(write.size()), write.data(), 0, nullptr);
 		++i;
 	}
@@ -674,6 +701,7 @@ void DeferredDraw::cleanup()
 
 	vkDestroySampler(device, colorSampler, nullptr);
 
+	lightCulling.cleanup();
 	mrtProgram->cleanup();
 	deferredProgram->cleanup();
 	mrtProgram.reset();
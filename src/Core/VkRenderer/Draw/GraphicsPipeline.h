@@ -2,6 +2,7 @@
 #include <vector>
 #include <vulkan/vulkan.h>
 
+#include "LightCulling.h"
 #include "Shader.h"
 #include "VulkanExtension.h"
 
@@ -52,15 +53,17 @@ public:
 	auto getMRTPipelineLayoutPtr() const { return mrtPipelineLayout; }
 	auto getMRTDescriptorSetPtr(size_t index)
 	{
-		if (mrtProgram->dynamicBufferDirty) {
+		if (mrtProgram->instanceBufferDirty) {
 			updateMRTDescriptorSets();
-			mrtProgram->dynamicBufferDirty = false;
+			mrtProgram->instanceBufferDirty = false;
 		}
 		return mrtDescriptorSets[index];
 	}
 
 	auto getMRTShaderProgramPtr() const { return mrtProgram; }
 	auto getDeferredShaderProgramPtr() const { return deferredProgram; }
+	const auto& getLightCulling() const { return lightCulling; }
+	auto& getLightCulling() { return lightCulling; }
 
 	void cleanup();
 
@@ -95,6 +98,8 @@ private:
 	std::shared_ptr<Sparkle::Shaders::MRTShaderProgram> mrtProgram;
 	std::shared_ptr<Sparkle::Shaders::DeferredShaderProgram> deferredProgram;
 
+	LightCulling lightCulling {};
+
 	void initAttachment(VkFormat format, VkImageUsageFlagBits usage, FrameBufferAtt* attachment);
 };
 } // namespace Sparkle
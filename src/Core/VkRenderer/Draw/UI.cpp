@@ -291,6 +291,14 @@ void GUI::updateFrame(GUI::FrameData frameData)
 		ImGui::End();
 	}
 
+	if (frameData.lightOverflowClusters > 0) {
+		ImGui::SetNextWindowPos(ImVec2(10, windowHeight - 40));
+		ImGui::Begin("LightOverflow", nullptr, flags);
+		auto overflow = "Light clusters over limit: " + std::to_string(frameData.lightOverflowClusters);
+		ImGui::TextUnformatted(overflow.c_str());
+		ImGui::End();
+	}
+
 	// Todo: ImGui windows etc
 
 	if (assimpProgress.isLoading) {
@@ -20,6 +20,7 @@ public:
     struct FrameData {
         size_t fps;
 		int drawCount;
+		int lightOverflowClusters; // clusters whose lights exceed LightCulling::MaxLightsPerCluster
     };
     struct ProgressData {
         bool isLoading;
@@ -1,10 +1,13 @@
 #include "RenderBackend.h"
 
+#include <algorithm>
+#include <cmath>
 #include <map>
 #include <set>
 
 #include <future>
 
+#include "Util.h"
 #include "VulkanInitializers.h"
 
 using namespace Sparkle;
@@ -34,8 +37,10 @@ void RenderBackend::setupVulkan()
 	createSwapChain();
 	createImageViews();
 	createCommandPool();
+	stagingRing.initialize(pTransferQueue, static_cast<uint32_t>(deviceQueueFamilies.transferFamily), pGraphicsQueue, static_cast<uint32_t>(deviceQueueFamilies.graphicsFamily));
 	createDepthResources();
 	createDrawBuffer();
+	createSamplerCache();
 	createMaterialDescriptorSetLayout();
 	createPipeline();
 	createComputePipeline();
@@ -58,13 +63,20 @@ void RenderBackend::initialize(std::shared_ptr<Settings> settings, bool withVali
 	enableValidationLayers = withValidation;
 	requiredFeatures.samplerAnisotropy = VK_TRUE;
 	requiredFeatures.textureCompressionBC = VK_TRUE;
+	// culled indirect draws select their instance transform through firstInstance
+	requiredFeatures.drawIndirectFirstInstance = VK_TRUE;
 
 	auto [width, height] = settings->getResolution();
 	viewportWidth = width;
 	viewportHeight = height;
+	lodErrorPixels = settings->getLodErrorPixels();
+	vertexFormat = Geometry::VertexPacking::parseFormat(settings->getVertexFormat());
+	textureStreaming.setBudget(static_cast<VkDeviceSize>(settings->getTextureBudgetMb()) << 20);
+	bindlessRequested = settings->getBindlessMaterials();
+	anisotropy = settings->getAnisotropy();
 
 	setupVulkan();
-	setupLights();
+	updateLights();
 
 	updateGeometry = true;
 }
@@ -75,8 +87,15 @@ void RenderBackend::draw(double deltaT)
 		std::cout << "frame fence not ready: " << frameCounter << std::endl;
 		return;
 	}
+	if (drawBufferReplaced) {
+		// uploads while a level is activated may grow the draw buffer before the throttled rebuild of the draws
+		recreateDrawCmdBuffers();
+	}
 	vkResetFences(pVulkanDevice, 1, &inFlightFences[frameCounter]);
 
+	// uploads recorded since the last frame run before its commands
+	stagingRing.flush();
+
 	uint32_t imageIndex;
 	auto result = vkAcquireNextImageKHR(pVulkanDevice, pSwapChain, std::numeric_limits<uint64_t>::max(),
 	    semImageAvailable[frameCounter], VK_NULL_HANDLE, &imageIndex);
@@ -103,6 +122,18 @@ void RenderBackend::draw(double deltaT)
 		throw std::runtime_error("Aquisation of SwapChain Image failed");
 	}
 
+	if (!computeEnabled) {
+		// written per image like the uniforms below
+		writeCpuDrawCommands(imageIndex);
+	}
+
+	// light culling of the previous frame on this image
+	const auto overflow = pGraphicsPipeline->getLightCulling().takeOverflow(imageIndex);
+	if (overflow > 0 && lightOverflowClusters == 0) {
+		LOGSTDOUT(std::to_string(overflow) + " light clusters exceed " + std::to_string(LightCulling::MaxLightsPerCluster) + " lights, the remaining lights are not shaded");
+	}
+	lightOverflowClusters = overflow;
+
 	{
 		VkSubmitInfo renderInfo {};
 		renderInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -358,6 +389,7 @@ void RenderBackend::draw(double deltaT)
 void RenderBackend::updateUiData(GUI::FrameData uiData)
 {
 	uiData.drawCount = drawCount;
+	uiData.lightOverflowClusters = static_cast<int>(lightOverflowClusters);
 	pUi->updateFrame(uiData);
 }
 
@@ -368,6 +400,14 @@ void RenderBackend::updateUniforms(bool updatedCam /*= false*/)
 	fragmentUBO.cameraPos = glm::vec4(pCamera->getPosition(), 0.0f);
 	fragmentUBO.gamma = pUi->getGamma();
 	fragmentUBO.exposure = pUi->getExposure();
+	fragmentUBO.view = pCamera->getView();
+	const auto& projection = pCamera->getProjection();
+	fragmentUBO.clusterProjection = glm::vec4(pCamera->nearPlane(), pCamera->farPlane(), projection[0][0], projection[1][1]);
+	fragmentUBO.clusterGrid = pGraphicsPipeline->getLightCulling().grid;
+	fragmentUBO.screenSize = glm::vec4(swapChainExtent.width, swapChainExtent.height, 1.0f / swapChainExtent.width, 1.0f / swapChainExtent.height);
+	if (pScene && pScene->takeLightsDirty()) {
+		updateLights();
+	}
 
 	if (updatedCam || updateGeometry) {
 
@@ -376,24 +416,29 @@ void RenderBackend::updateUniforms(bool updatedCam /*= false*/)
 
 	//	vkDeviceWaitIdle(pVulkanDevice);
 		if (updateGeometry && pScene) {
-			mrtShaderProg->updateDynamicUniformBufferObject(pScene->getRenderableScene());
+			mrtShaderProg->updateInstanceBuffer(pScene->getRenderableScene());
 			updateGeometry = false;
 		}
 
+		// a world space error e at distance d covers e * lodScale / d times the pixel threshold
+		// the camera may flip y in the projection, only the magnitude matters here
+		const auto lodScale = std::abs(mrtUBO.projection[1][1]) * 0.5f * static_cast<float>(swapChainExtent.height) / lodErrorPixels;
+		const auto frustum = Geometry::Bounds::frustumPlanes(mrtUBO.projection * mrtUBO.view);
+		if (!computeEnabled && pScene) {
+			// lods and visible batches are written into the draw commands of each frame
+			pScene->selectLods(pCamera->getPosition(), lodScale);
+			pScene->cullBatches(frustum);
+		}
+
 		if (computeEnabled) {
-			// frustum
-			auto vp = mrtUBO.projection * mrtUBO.view;
-			compute.ubo.frustumPlanes[0] = /*glm::normalize*/ (glm::vec4(vp[0][3] + vp[0][0], vp[1][3] + vp[1][0], vp[2][3] + vp[2][0], vp[3][3] + vp[3][0])); // left
-			compute.ubo.frustumPlanes[1] = /*glm::normalize*/ (glm::vec4(vp[0][3] - vp[0][0], vp[1][3] - vp[1][0], vp[2][3] - vp[2][0], vp[3][3] - vp[3][0])); // right
-			compute.ubo.frustumPlanes[2] = /*glm::normalize*/ (glm::vec4(vp[0][3] + vp[0][1], vp[1][3] + vp[1][1], vp[2][3] + vp[2][1], vp[3][3] + vp[3][1])); // bottom
-			compute.ubo.frustumPlanes[3] = /*glm::normalize*/ (glm::vec4(vp[0][3] - vp[0][1], vp[1][3] - vp[1][1], vp[2][3] - vp[2][1], vp[3][3] - vp[3][1])); // top
-			compute.ubo.frustumPlanes[4] = /*glm::normalize*/ (glm::vec4(vp[0][3] + vp[0][2], vp[1][3] + vp[1][2], vp[2][3] + vp[2][2], vp[3][3] + vp[3][2])); // near
-			compute.ubo.frustumPlanes[5] = /*glm::normalize*/ (glm::vec4(vp[0][3] - vp[0][2], vp[1][3] - vp[1][2], vp[2][3] - vp[2][2], vp[3][3] - vp[3][2])); // far
+			std::copy(frustum.begin(), frustum.end(), compute.ubo.frustumPlanes);
 			compute.ubo.cameraPos = pCamera->getPosition();
+			compute.ubo.lodScale = lodScale;
 
 			compute.updateUBO(compute.ubo);
 		}
 	}
+	streamTextures();
 }
 
 void RenderBackend::cleanupSwapChain()
@@ -472,6 +517,15 @@ void RenderBackend::cleanup()
 		pIndirectDrawCountBuffer.destroy(true);
 		delete (ppIndirectDrawCountMemory);
 	}
+	createCpuDrawBuffers(0);
+	if (pClusterBuffer.buffer) {
+		pClusterBuffer.destroy(true);
+		delete (ppClusterMemory);
+	}
+	if (pClusterDrawBuffer.buffer) {
+		pClusterDrawBuffer.destroy(true);
+		delete (ppClusterDrawMemory);
+	}
 	if (pInstanceBuffer.buffer)
 		pInstanceBuffer.destroy(true);
 	if (ppDrawMemory)
@@ -487,7 +541,13 @@ void RenderBackend::cleanup()
 		vkDestroyImage(pVulkanDevice, image, nullptr);
 	}
 
-	vkDestroyDescriptorSetLayout(pVulkanDevice, pMaterialDescriptorSetLayout, nullptr);
+	if (bindless) {
+		bindlessMaterials.cleanup();
+	} else {
+		vkDestroyDescriptorSetLayout(pVulkanDevice, pMaterialDescriptorSetLayout, nullptr);
+	}
+	samplerCache.cleanup();
+	stagingRing.cleanup();
 	vkDestroyCommandPool(pVulkanDevice, pCommandPool, nullptr);
 
 	pScene.reset();
@@ -523,6 +583,19 @@ void RenderBackend::createVulkanInstance()
 	createInfo.pApplicationInfo = &appInfo;
 
 	auto extensions = getRequiredExtensions();
+	if (bindlessRequested) {
+		// descriptor indexing features are queried through vkGetPhysicalDeviceFeatures2KHR on a 1.0 instance
+		uint32_t extensionCount = 0;
+		vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> instanceExtensions(extensionCount);
+		vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, instanceExtensions.data());
+		physicalDeviceProperties2 = std::any_of(instanceExtensions.begin(), instanceExtensions.end(), [](const VkExtensionProperties& ext) {
+			return strcmp(ext.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0;
+		});
+		if (physicalDeviceProperties2) {
+			extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+		}
+	}
 	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
 	createInfo.ppEnabledExtensionNames = extensions.data();
 
@@ -569,15 +642,16 @@ void RenderBackend::createVulkanDevice()
 	const auto queueFamilyIndices = getQueueFamilies(pPhysicalDevice);
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<int> uniqueQueueFamilies = { queueFamilyIndices.graphicsFamily, queueFamilyIndices.presentFamily };
+	std::set<int> uniqueQueueFamilies = { queueFamilyIndices.graphicsFamily, queueFamilyIndices.presentFamily, queueFamilyIndices.transferFamily };
 
-	auto queuePriority = 1.0f;
+	const float queuePriorities[] = { 1.0f, 1.0f };
 	for (auto& queueFamily : uniqueQueueFamilies) {
 		VkDeviceQueueCreateInfo queueCreateInfo = {};
 		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 		queueCreateInfo.queueFamilyIndex = queueFamily;
-		queueCreateInfo.queueCount = 1;
-		queueCreateInfo.pQueuePriorities = &queuePriority;
+		// the upload queue is the second queue of the graphics family if there is no transfer only family
+		queueCreateInfo.queueCount = queueFamily == queueFamilyIndices.transferFamily ? queueFamilyIndices.transferQueueIndex + 1 : 1;
+		queueCreateInfo.pQueuePriorities = queuePriorities;
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
@@ -585,13 +659,54 @@ void RenderBackend::createVulkanDevice()
 		requiredFeatures.multiDrawIndirect = VK_TRUE;
 	}
 
+	auto extensions = requiredExtensions;
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	bindless = false;
+	if (bindlessRequested && physicalDeviceProperties2) {
+		uint32_t extensionCount = 0;
+		vkEnumerateDeviceExtensionProperties(pPhysicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> deviceExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(pPhysicalDevice, nullptr, &extensionCount, deviceExtensions.data());
+		std::set<std::string> indexingExtensions = { VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME, VK_KHR_MAINTENANCE3_EXTENSION_NAME };
+		for (const auto& ext : deviceExtensions) {
+			indexingExtensions.erase(ext.extensionName);
+		}
+
+		const auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(pVulkanInstance, "vkGetPhysicalDeviceFeatures2KHR");
+		if (indexingExtensions.empty() && getFeatures2) {
+			VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported = {};
+			supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+			VkPhysicalDeviceFeatures2KHR features2 = {};
+			features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+			features2.pNext = &supported;
+			getFeatures2(pPhysicalDevice, &features2);
+			// the texture array is written while recorded draws and frames in flight use other slots
+			bindless = supported.runtimeDescriptorArray && supported.descriptorBindingPartiallyBound && supported.shaderSampledImageArrayNonUniformIndexing
+			    && supported.descriptorBindingSampledImageUpdateAfterBind && supported.descriptorBindingUpdateUnusedWhilePending;
+		}
+		if (bindless) {
+			indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+			indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+			indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+			indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+			indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+			extensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+			extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		}
+	}
+	if (bindlessRequested) {
+		LOGSTDOUT(bindless ? "Bindless materials enabled" : "Descriptor indexing not supported, using a descriptor set per material");
+	}
+
 	VkDeviceCreateInfo deviceCreateInfo = {};
 	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	deviceCreateInfo.pNext = bindless ? &indexingFeatures : nullptr;
 	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
 	deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	deviceCreateInfo.pEnabledFeatures = &requiredFeatures;
-	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(requiredExtensions.size());
-	deviceCreateInfo.ppEnabledExtensionNames = requiredExtensions.data();
+	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	deviceCreateInfo.ppEnabledExtensionNames = extensions.data();
 
 	if (enableValidationLayers) {
 		deviceCreateInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -608,6 +723,14 @@ void RenderBackend::createVulkanDevice()
 
 	vkGetDeviceQueue(pVulkanDevice, queueFamilyIndices.graphicsFamily, 0, &pGraphicsQueue);
 	vkGetDeviceQueue(pVulkanDevice, queueFamilyIndices.presentFamily, 0, &pPresentQueue);
+	vkGetDeviceQueue(pVulkanDevice, queueFamilyIndices.transferFamily, queueFamilyIndices.transferQueueIndex, &pTransferQueue);
+	if (queueFamilyIndices.transferFamily != queueFamilyIndices.graphicsFamily) {
+		LOGSTDOUT("Uploads use a transfer queue family");
+	} else if (pTransferQueue != pGraphicsQueue) {
+		LOGSTDOUT("Uploads use a second graphics queue");
+	} else {
+		LOGSTDOUT("Uploads share the graphics queue");
+	}
 }
 
 void RenderBackend::createSurface()
@@ -701,6 +824,24 @@ void RenderBackend::createImageViews()
 
 void RenderBackend::createMaterialDescriptorSetLayout()
 {
+	if (bindless) {
+		// the texture array is an update after bind binding, it is bounded by the limits of those
+		VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProps = {};
+		indexingProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+		VkPhysicalDeviceProperties2KHR props2 = {};
+		props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+		props2.pNext = &indexingProps;
+		const auto getProperties2 = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(pVulkanInstance, "vkGetPhysicalDeviceProperties2KHR");
+		getProperties2(pPhysicalDevice, &props2);
+		// combined image samplers count as samplers and sampled images, the stage also uses the materials buffer and 4 render targets
+		const auto textureCount = std::min({ BindlessMaterials::TextureLimit,
+		    indexingProps.maxPerStageDescriptorUpdateAfterBindSamplers, indexingProps.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		    indexingProps.maxDescriptorSetUpdateAfterBindSamplers, indexingProps.maxDescriptorSetUpdateAfterBindSampledImages,
+		    indexingProps.maxPerStageUpdateAfterBindResources - 5 });
+		bindlessMaterials.initialize(textureCount);
+		return;
+	}
+
 	std::vector<VkDescriptorSetLayoutBinding> textureBindings;
 	uint32_t texBinding = TEX_BINDING_OFFSET;
 	for (size_t i = 0; i < materialTextureLimit; ++i) {
@@ -719,6 +860,13 @@ void RenderBackend::createMaterialDescriptorSetLayout()
 	    "DescriptorSetLayout creation failed!");
 }
 
+void RenderBackend::createSamplerCache()
+{
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(pPhysicalDevice, &props);
+	samplerCache.initialize(pVulkanDevice, std::min(anisotropy, props.limits.maxSamplerAnisotropy));
+}
+
 void RenderBackend::createPipeline()
 {
 	VkViewport viewport = {
@@ -727,7 +875,7 @@ void RenderBackend::createPipeline()
 	std::cout << __FUNCTION__ << "-> main rendering pipeline" << std::endl;
 	pGraphicsPipeline = std::make_unique<DeferredDraw>(viewport);
 	auto meshes = pScene ? pScene->getRenderableScene() : std::vector<std::shared_ptr<Geometry::Node>>();
-	pGraphicsPipeline->getMRTShaderProgramPtr()->updateDynamicUniformBufferObject(meshes);
+	pGraphicsPipeline->getMRTShaderProgramPtr()->updateInstanceBuffer(meshes);
 }
 
 void RenderBackend::createComputePipeline()
@@ -735,19 +883,89 @@ void RenderBackend::createComputePipeline()
 	compute.initialize(deviceQueueFamilies.computeFamily, pGraphicsPipeline->getDeferredFramebufferPtrs().size());
 }
 
+void RenderBackend::uploadStorageBuffer(const void* data, VkDeviceSize size, vkExt::Buffer& buffer, vkExt::SharedMemory*& memory)
+{
+	if (buffer.buffer) {
+		buffer.destroy(true);
+		delete (memory);
+	}
+	memory = new vkExt::SharedMemory();
+	// buffers can not be empty, the descriptor still needs one if the scene has no clusters
+	createBuffer(std::max(size, VkDeviceSize(16)), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+
+	if (size > 0) {
+		stagingRing.copyToBuffer(data, size, buffer.buffer);
+	}
+}
+
+void RenderBackend::createCpuDrawBuffers(size_t batchCount)
+{
+	cpuDrawCount = batchCount;
+	if (batchCount > 0 && batchCount <= cpuDrawCapacity && pCpuDrawBuffers.size() == mrtCommandBuffers.size()) {
+		return;
+	}
+	for (size_t i = 0; i < pCpuDrawBuffers.size(); ++i) {
+		pCpuDrawBuffers[i].destroy(true);
+		delete (ppCpuDrawMemory[i]);
+	}
+	pCpuDrawBuffers.clear();
+	ppCpuDrawMemory.clear();
+	cpuDrawCapacity = 0;
+	if (batchCount == 0) {
+		return;
+	}
+
+	// leave room for meshes attached later on
+	cpuDrawCapacity = std::max(batchCount * 2, size_t(64));
+	pCpuDrawBuffers.resize(mrtCommandBuffers.size());
+	ppCpuDrawMemory.resize(mrtCommandBuffers.size());
+	for (size_t i = 0; i < pCpuDrawBuffers.size(); ++i) {
+		ppCpuDrawMemory[i] = new vkExt::SharedMemory();
+		createBuffer(cpuDrawCapacity * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, pCpuDrawBuffers[i], ppCpuDrawMemory[i]);
+	}
+}
+
+void RenderBackend::writeCpuDrawCommands(uint32_t imageIndex)
+{
+	if (!pScene || cpuDrawCount == 0 || imageIndex >= pCpuDrawBuffers.size()) {
+		return;
+	}
+	const auto& batches = pScene->getDrawBatches();
+	const auto count = std::min(cpuDrawCount, batches.size());
+	auto commands = static_cast<VkDrawIndexedIndirectCommand*>(pCpuDrawBuffers[imageIndex].mapped());
+	for (size_t b = 0; b < count; ++b) {
+		const auto& batch = batches[b];
+		const auto& mesh = batch.mesh;
+		const auto& lod = mesh->getLods()[batch.lod];
+		commands[b].indexCount = lod.indexCount;
+		// culled batches keep their draw with no instances
+		commands[b].instanceCount = batch.visible ? batch.instanceCount : 0;
+		commands[b].firstIndex = static_cast<uint32_t>(mesh->bufferOffset.indexOffs) + lod.firstIndex;
+		commands[b].vertexOffset = 0;
+		commands[b].firstInstance = batch.firstInstance;
+	}
+}
+
 void RenderBackend::recordComputeCmdBuffers()
 {
-	auto workGroupSize = 16u;
-	auto workGroupCount = pScene ? pScene->objectCount() >= workGroupSize ? pScene->objectCount() / workGroupSize : 1u : 0u;
-	if (pScene && pScene->objectCount() > workGroupSize && pScene->objectCount() % workGroupSize > 0) {
-		workGroupCount++;
+	// one invocation per cluster of every instance
+	size_t clusterDrawCount = 0;
+	if (pScene) {
+		for (const auto& batch : pScene->getDrawBatches()) {
+			clusterDrawCount += batch.commandCount;
+		}
 	}
+	auto workGroupSize = 16u;
+	auto workGroupCount = static_cast<uint32_t>((clusterDrawCount + workGroupSize - 1) / workGroupSize);
 
 	if (pScene && pScene->objectCount() > 0) {
-		vkExt::SharedMemory* stagingMem = new vkExt::SharedMemory();
-		vkExt::Buffer staging;
-
 		std::vector<ComputePipeline::MeshData> meshData;
+		std::vector<ComputePipeline::ClusterData> clusterData;
+		std::vector<ComputePipeline::ClusterDraw> clusterDraws;
+		clusterDraws.reserve(clusterDrawCount);
+		// instances share the clusters of their geometry
+		std::map<const std::vector<Geometry::Mesh::Cluster>*, uint32_t> firstCluster;
 
 		for (const auto& node : pScene->getRenderableScene()) {
 			if (!node->drawable()) {
@@ -757,30 +975,40 @@ void RenderBackend::recordComputeCmdBuffers()
 			ComputePipeline::MeshData data = {};
 			data.model = mesh->accumModel();
 			data.boundingSphere = mesh->getBounds();
-			data.indexCount = mesh->size();
-			data.firstIndex = mesh->bufferOffset.indexOffs;
+			const auto& lods = mesh->getLods();
+			data.lodCount = static_cast<uint32_t>(lods.size());
+			for (uint32_t l = 0; l < data.lodCount; ++l) {
+				data.lodFirstIndex[l] = static_cast<uint32_t>(mesh->bufferOffset.indexOffs) + lods[l].firstIndex;
+				data.lodIndexCount[l] = lods[l].indexCount;
+				data.lodError[l] = lods[l].error;
+			}
+			const auto& clusters = mesh->getClusters();
+			const auto known = firstCluster.emplace(&clusters, static_cast<uint32_t>(clusterData.size()));
+			if (known.second) {
+				for (const auto& cluster : clusters) {
+					ComputePipeline::ClusterData c = {};
+					c.firstIndex = static_cast<uint32_t>(mesh->bufferOffset.indexOffs) + cluster.firstIndex;
+					c.indexCount = cluster.indexCount;
+					c.boundingSphere = glm::vec4(cluster.boundingSphere.center, cluster.boundingSphere.radius);
+					c.cone = cluster.cone;
+					clusterData.push_back(c);
+				}
+			}
+			data.firstCluster = known.first->second;
+			for (uint32_t c = 0; c < static_cast<uint32_t>(clusters.size()); ++c) {
+				clusterDraws.push_back({ static_cast<uint32_t>(meshData.size()), c });
+			}
 			meshData.push_back(data);
 		}
 
 		compute.ubo.meshCount = static_cast<uint32_t>(meshData.size());
+		compute.ubo.clusterDrawCount = static_cast<uint32_t>(clusterDraws.size());
 
-		VkDeviceSize stSize = meshData.size() * sizeof(ComputePipeline::MeshData);
-		createBuffer(stSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging, stagingMem);
-
-		if (pInstanceBuffer.buffer) {
-			pInstanceBuffer.destroy(true);
-			delete (ppInstanceMemory);
-		}
-		ppInstanceMemory = new vkExt::SharedMemory();
-		createBuffer(stSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pInstanceBuffer, ppInstanceMemory);
-
-		staging.map();
-		staging.copyTo(meshData.data(), stSize);
-		staging.unmap();
-		pInstanceBuffer.copyToBuffer(pCommandPool, pGraphicsQueue, staging, stSize);
-		//	pInstanceBuffer.flush();
-		staging.destroy(true);
-		delete (stagingMem);
+		uploadStorageBuffer(meshData.data(), meshData.size() * sizeof(ComputePipeline::MeshData), pInstanceBuffer, ppInstanceMemory);
+		uploadStorageBuffer(clusterData.data(), clusterData.size() * sizeof(ComputePipeline::ClusterData), pClusterBuffer, ppClusterMemory);
+		uploadStorageBuffer(clusterDraws.data(), clusterDraws.size() * sizeof(ComputePipeline::ClusterDraw), pClusterDrawBuffer, ppClusterDrawMemory);
+		// the compute queue does not wait for staging submits to the graphics queue
+		stagingRing.finish();
 
 		if (pIndirectCommandsBuffer.buffer) {
 			pIndirectCommandsBuffer.destroy(true);
@@ -792,7 +1020,7 @@ void RenderBackend::recordComputeCmdBuffers()
 			delete (ppIndirectDrawCountMemory);
 		}
 
-		VkDeviceSize idcSize = /*meshData.size()*/ workGroupCount * workGroupSize * sizeof(VkDrawIndexedIndirectCommand);
+		VkDeviceSize idcSize = /*meshData.size()*/ std::max(workGroupCount, 1u) * workGroupSize * sizeof(VkDrawIndexedIndirectCommand);
 		VkDeviceSize statSize = sizeof(uint32_t);
 
 		ppIndirectCommandMemory = new vkExt::SharedMemory();
@@ -801,9 +1029,9 @@ void RenderBackend::recordComputeCmdBuffers()
 		ppIndirectDrawCountMemory = new vkExt::SharedMemory();
 		createBuffer(idcSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, pIndirectDrawCountBuffer, ppIndirectDrawCountMemory);
 
-		indirectCommandsSize = meshData.size();
+		indirectCommandsSize = clusterDraws.size();
 
-		std::array<VkWriteDescriptorSet, 4> writes = {
+		std::array<VkWriteDescriptorSet, 6> writes = {
 			vk::init::writeDescriptorSet(compute.descSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0,
 			    &pInstanceBuffer.descriptor),
 			vk::init::writeDescriptorSet(compute.descSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
@@ -811,7 +1039,11 @@ void RenderBackend::recordComputeCmdBuffers()
 			vk::init::writeDescriptorSet(compute.descSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2,
 			    &compute.uboBuff.descriptor),
 			vk::init::writeDescriptorSet(compute.descSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3,
-			    &pIndirectDrawCountBuffer.descriptor)
+			    &pIndirectDrawCountBuffer.descriptor),
+			vk::init::writeDescriptorSet(compute.descSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4,
+			    &pClusterBuffer.descriptor),
+			vk::init::writeDescriptorSet(compute.descSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5,
+			    &pClusterDrawBuffer.descriptor)
 		};
 
 		vkUpdateDescriptorSets(pVulkanDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
@@ -896,19 +1128,45 @@ void RenderBackend::destroyCommandBuffers()
 void RenderBackend::updateScenePtr(std::shared_ptr<Geometry::Scene> scene)
 {
 	if (pScene) {
+		// frames in flight sample the old textures, their bindless slots are rewritten for the new scene
+		vkWaitForFences(pVulkanDevice, MAX_FRAMES_IN_FLIGHT, inFlightFences.data(), VK_TRUE, uint64_t(5e+9));
 		pScene->cleanup();
 	}
 	pScene = scene;
+	pScene->takeLightsDirty();
+	updateLights();
 	updateDrawCommand();
 }
 
 void RenderBackend::updateDrawCommand()
 {
 	assert(pScene);
-	pGraphicsPipeline->getMRTShaderProgramPtr()->updateDynamicUniformBufferObject(pScene->getRenderableScene());
+	// indices of new materials are written to the instance buffer
+	updateBindlessMaterials();
+	// the instance buffer grows with the scene, frames in flight still read the old one
+	vkDeviceWaitIdle(pVulkanDevice);
+	// appended meshes leave the existing instances in place, only their entries are written
+	pGraphicsPipeline->getMRTShaderProgramPtr()->updateInstanceBuffer(pScene->getRenderableScene(), true);
 	recreateDrawCmdBuffers();
 }
 
+void RenderBackend::updateBindlessMaterials()
+{
+	if (!bindless || bindlessMaterials.update(*pScene)) {
+		return;
+	}
+	LOGSTDOUT("Scene exceeds the " + std::to_string(bindlessMaterials.textureCapacity) + " textures or materials of bindless materials, using a descriptor set per material");
+	// the pipelines are rebuilt for the per material sets like after reloading the shaders
+	vkDeviceWaitIdle(pVulkanDevice);
+	bindlessMaterials.cleanup();
+	bindless = false;
+	createMaterialDescriptorSetLayout();
+	for (const auto& material : pScene->materialCache) {
+		material->createDescriptorSet();
+	}
+	recreateSwapChain();
+}
+
 void RenderBackend::recreateDrawCmdBuffers()
 {
 	vkWaitForFences(pVulkanDevice, MAX_FRAMES_IN_FLIGHT, inFlightFences.data(), VK_TRUE, uint64_t(5e+9));
@@ -961,20 +1219,9 @@ void RenderBackend::createScreenQuad()
 		screenQuadMemory = new vkExt::SharedMemory();
 	}
 
-	auto stagingMem = new vkExt::SharedMemory();
-	vkExt::Buffer stagingBuffer;
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMem);
-
-	stagingBuffer.map();
-	stagingBuffer.copyTo(vertices.data(), indexOffset);
-	stagingBuffer.copyTo(indices, 6 * sizeof(uint32_t), indexOffset);
-	stagingBuffer.unmap();
-
 	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, screenQuadBuffer, screenQuadMemory);
-	screenQuadBuffer.copyToBuffer(pCommandPool, pGraphicsQueue, stagingBuffer, bufferSize);
-
-	stagingBuffer.destroy(true);
-	delete (stagingMem);
+	stagingRing.copyToBuffer(vertices.data(), indexOffset, screenQuadBuffer.buffer);
+	stagingRing.copyToBuffer(indices, 6 * sizeof(uint32_t), screenQuadBuffer.buffer, indexOffset);
 
 	screenQuad.indexOffset = indexOffset;
 	screenQuad.size = 6;
@@ -1008,6 +1255,7 @@ void RenderBackend::createCommandBuffers()
 // Record Command Buffers for main geometry
 void RenderBackend::recordDrawCmdBuffers()
 {
+	drawBufferReplaced = false;
 	auto mrtFramebuffersRef = pGraphicsPipeline->getMRTFramebufferPtrs();
 	auto swapChainFramebuffersRef = pGraphicsPipeline->getDeferredFramebufferPtrs();
 
@@ -1052,45 +1300,66 @@ void RenderBackend::recordDrawCmdBuffers()
 
 		vkCmdBindPipeline(mrtCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
 		    pGraphicsPipeline->getMRTPipelinePtr());
+		if (bindless) {
+			// instances select their material from the instance buffer, the sets stay bound for all batches
+			std::array<VkDescriptorSet, 2> sets = { pGraphicsPipeline->getMRTDescriptorSetPtr(i), bindlessMaterials.descSet };
+			vkCmdBindDescriptorSets(mrtCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
+			    pGraphicsPipeline->getMRTPipelineLayoutPtr(), 0,
+			    static_cast<uint32_t>(sets.size()), sets.data(), 0, nullptr);
+		}
 		if (pDrawBuffer.buffer) {
 			VkBuffer vtxBuffers[] = { pDrawBuffer.buffer };
-			vkCmdBindIndexBuffer(mrtCommandBuffers[i], pDrawBuffer.buffer, indexBufferOffset, VK_INDEX_TYPE_UINT32);
-
-			const auto shaderProgram = pGraphicsPipeline->getMRTShaderProgramPtr();
-			const auto meshes = pScene ? pScene->getRenderableScene() : std::vector<std::shared_ptr<Geometry::Node>>();
-
-			uint32_t j = 0;
-			for (auto& node : meshes) {
-				if (!node->drawable())
-					continue;
-
-				auto mesh = std::static_pointer_cast<Geometry::Mesh, Geometry::Node>(node);
-
-				VkDeviceSize offsets[] = { mesh->bufferOffset.vertexOffs };
-				vkCmdBindVertexBuffers(mrtCommandBuffers[i], 0, 1, vtxBuffers, offsets);
-
-				std::array<uint32_t, 1> dynamicOffsets = { j * shaderProgram->getDynamicAlignment() };
-
-				std::vector<VkDescriptorSet> sets;
-				sets.push_back(pGraphicsPipeline->getMRTDescriptorSetPtr(i));
-				sets.push_back(mesh->getMaterial()->getDescriptorSet());
-				if (pCamera) {
-					auto pc = mesh->getMaterial()->getUniforms();
-					vkCmdPushConstants(mrtCommandBuffers[i], pGraphicsPipeline->getMRTPipelineLayoutPtr(),
-					    VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-					    static_cast<uint32_t>(sizeof(Material::MaterialUniforms)), &pc);
-					vkCmdBindDescriptorSets(mrtCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
-					    pGraphicsPipeline->getMRTPipelineLayoutPtr(), 0,
-					    static_cast<uint32_t>(sets.size()), sets.data(),
-					    static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
-					if (computeEnabled) {
-						vkCmdDrawIndexedIndirect(mrtCommandBuffers[i], pIndirectCommandsBuffer.buffer, j * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
-					} else {
-						vkCmdDrawIndexed(mrtCommandBuffers[i], static_cast<uint32_t>(mesh->size()), 1,
-						    static_cast<uint32_t>(mesh->bufferOffset.indexOffs), 0, 0);
+
+			if (pScene) {
+				const auto& batches = pScene->getDrawBatches();
+				if (i == 0) {
+					createCpuDrawBuffers(batches.size());
+				}
+				// instances of a batch are consecutive in the instance buffer and in the indirect commands,
+				// batches are grouped by index type so the index buffer is rebound once
+				auto boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+				for (size_t b = 0; b < batches.size(); ++b) {
+					const auto& batch = batches[b];
+					const auto& mesh = batch.mesh;
+
+					if (mesh->bufferOffset.indexType != boundIndexType) {
+						boundIndexType = mesh->bufferOffset.indexType;
+						vkCmdBindIndexBuffer(mrtCommandBuffers[i], pDrawBuffer.buffer,
+						    boundIndexType == VK_INDEX_TYPE_UINT16 ? shortIndexBufferOffset : indexBufferOffset, boundIndexType);
+					}
+
+					VkDeviceSize offsets[] = { mesh->bufferOffset.vertexOffs };
+					vkCmdBindVertexBuffers(mrtCommandBuffers[i], 0, 1, vtxBuffers, offsets);
+
+					if (pCamera) {
+						if (!bindless) {
+							std::vector<VkDescriptorSet> sets;
+							sets.push_back(pGraphicsPipeline->getMRTDescriptorSetPtr(i));
+							sets.push_back(mesh->getMaterial()->getDescriptorSet());
+							auto pc = mesh->getMaterial()->getUniforms();
+							vkCmdPushConstants(mrtCommandBuffers[i], pGraphicsPipeline->getMRTPipelineLayoutPtr(),
+							    VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+							    static_cast<uint32_t>(sizeof(Material::MaterialUniforms)), &pc);
+							vkCmdBindDescriptorSets(mrtCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
+							    pGraphicsPipeline->getMRTPipelineLayoutPtr(), 0,
+							    static_cast<uint32_t>(sets.size()), sets.data(), 0, nullptr);
+						}
+						if (computeEnabled) {
+							// the cull shader writes one command per cluster and instance, culled ones have an instanceCount of 0
+							const auto offset = batch.firstCommand * sizeof(VkDrawIndexedIndirectCommand);
+							if (requiredFeatures.multiDrawIndirect == VK_TRUE) {
+								vkCmdDrawIndexedIndirect(mrtCommandBuffers[i], pIndirectCommandsBuffer.buffer, offset, batch.commandCount, sizeof(VkDrawIndexedIndirectCommand));
+							} else {
+								for (uint32_t k = 0; k < batch.commandCount; ++k) {
+									vkCmdDrawIndexedIndirect(mrtCommandBuffers[i], pIndirectCommandsBuffer.buffer, offset + k * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+								}
+							}
+						} else {
+							// lod and visibility are selected per frame by writeCpuDrawCommands
+							vkCmdDrawIndexedIndirect(mrtCommandBuffers[i], pCpuDrawBuffers[i].buffer, b * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+						}
 					}
 				}
-				++j;
 			}
 		}
 		vkCmdEndRenderPass(mrtCommandBuffers[i]);
@@ -1099,6 +1368,9 @@ void RenderBackend::recordDrawCmdBuffers()
 
 		VK_THROW_ON_ERROR(vkBeginCommandBuffer(deferredCommandBuffers[i], &info), "Begin command buffer recording failed!");
 
+		// lights are binned per frame, the uniforms of this image are updated before the submit
+		pGraphicsPipeline->getLightCulling().record(deferredCommandBuffers[i], i);
+
 		transitionImageLayout(swapChainImages[i], swapChainImageFormat, VK_IMAGE_LAYOUT_UNDEFINED,
 		    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, deferredCommandBuffers[i]);
 		vkCmdClearColorImage(deferredCommandBuffers[i], swapChainImages[i], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &cClearColor,
@@ -1163,37 +1435,81 @@ void RenderBackend::createSyncObjects()
 	}
 }
 
-void RenderBackend::initLight(Lights::Light* light, glm::vec3 pos, glm::vec3 col, float radius, Lights::LType type)
+void RenderBackend::updateLights()
 {
-	light->mVec = glm::vec4(pos, 0.0f);
-	light->mColor = glm::vec4(col, 0.0f);
-	light->mRadius = radius;
+	// levels without authored lights get a single sun instead of rendering black
+	std::vector<Lights::Light> fallback;
+	const auto* lights = pScene ? &pScene->getLights() : &fallback;
+	if (lights->empty()) {
+		fallback.push_back(Lights::directionalLight(glm::vec3(-0.3f, -1.0f, -0.2f), glm::vec3(3.0f)));
+		lights = &fallback;
+	}
+	if (lights->size() > SPARKLE_SHADER_LIMIT_LIGHTS) {
+		LOGSTDOUT("Scene has " + std::to_string(lights->size()) + " lights, only the first " + std::to_string(SPARKLE_SHADER_LIMIT_LIGHTS) + " are used");
+	}
+	fragmentUBO.numLights = static_cast<uint32_t>(std::min<size_t>(lights->size(), SPARKLE_SHADER_LIMIT_LIGHTS));
+	std::copy_n(lights->begin(), fragmentUBO.numLights, fragmentUBO.lights);
+	for (uint32_t i = 0; i < fragmentUBO.numLights; ++i) {
+		fragmentUBO.lights[i].mRange = Lights::influenceRange(fragmentUBO.lights[i]);
+	}
 }
 
-// todo: this should be part of scene not renderer!
-void RenderBackend::setupLights()
+void RenderBackend::streamTextures()
 {
-	// light setup for sponza base idea from https://github.com/SaschaWillems/VulkanSponza
-	// todo -> lights from level loader
-	std::array<glm::vec3, 5> lightColors;
-	lightColors[0] = glm::vec3(100.0f, 70.0f, 70.0f);
-	lightColors[1] = glm::vec3(100.0f, 0.0f, 0.0f);
-	lightColors[2] = glm::vec3(0.0f, 0.0f, 100.0f);
-	lightColors[3] = glm::vec3(0.0f, 100.0f, 0.0f);
-	lightColors[4] = glm::vec3(100.0f, 70.0f, 70.0f);
-
-	for (int32_t i = 0; i < lightColors.size(); i++) {
-		initLight(&fragmentUBO.lights[i], glm::vec4((-78.0f + (float)i * 33.0f), 10.0f, -4.3f, 0.0f), lightColors[i],
-		    120.0f);
+	if (!pScene || !textureStreaming.enabled()) {
+		return;
 	}
-
-	// Fire bowls
-	initLight(&fragmentUBO.lights[5], { 48.75f, 16.0f, -21.8f }, { 100.0f, 60.0f, 0.0f }, 45.0f);
-	initLight(&fragmentUBO.lights[6], { 48.75f, 16.0f, 15.4f }, { 100.0f, 60.0f, 0.0f }, 45.0f);
-	initLight(&fragmentUBO.lights[7], { -62.0f, 16.0f, -21.8f }, { 100.0f, 60.0f, 0.0f }, 45.0f);
-	initLight(&fragmentUBO.lights[8], { -62.0f, 16.0f, 15.4f }, { 100.0f, 60.0f, 0.0f }, 45.0f);
-
-	fragmentUBO.numLights = 9;
+	if (textureStreaming.replacementsReady(*pScene)) {
+		// the frames in flight sample the current images through the recorded descriptor sets
+		vkWaitForFences(pVulkanDevice, MAX_FRAMES_IN_FLIGHT, inFlightFences.data(), VK_TRUE, uint64_t(5e+9));
+		if (textureStreaming.swapReady(*pScene)) {
+			if (bindless) {
+				// the texture array still holds the replaced image views, writing it keeps the recorded draws valid
+				bindlessMaterials.update(*pScene);
+			} else {
+				// only the draws bind material descriptor sets, the culling commands stay valid
+				for (auto& cmdBuff : mrtCommandBuffers) {
+					vkResetCommandBuffer(cmdBuff, VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT);
+				}
+				for (auto& cmdBuff : deferredCommandBuffers) {
+					vkResetCommandBuffer(cmdBuff, VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT);
+				}
+				recordDrawCmdBuffers();
+			}
+		}
+	}
+	if (!textureStreaming.beginFrame()) {
+		return;
+	}
+	// the texel density of the meshes is unknown, a texture is assumed to cover its mesh once
+	const auto pixelScale = std::abs(mrtUBO.projection[1][1]) * 0.5f * static_cast<float>(swapChainExtent.height);
+	const auto frustum = Geometry::Bounds::frustumPlanes(mrtUBO.projection * mrtUBO.view);
+	const auto cameraPos = pCamera->getPosition();
+	const auto nodes = pScene->getRenderableScene();
+	for (const auto& batch : pScene->getDrawBatches()) {
+		const auto material = batch.mesh->getMaterial();
+		if (!material) {
+			continue;
+		}
+		float pixels = 0.0f;
+		for (uint32_t i = 0; i < batch.instanceCount; ++i) {
+			const auto mesh = std::static_pointer_cast<Geometry::Mesh, Geometry::Node>(nodes[batch.firstInstance + i]);
+			const auto bounds = Geometry::Bounds::transform(mesh->getBounds(), mesh->accumModel());
+			if (!Geometry::Bounds::intersects(frustum, bounds)) {
+				continue;
+			}
+			// the camera inside the bounds may see the texture over the whole screen
+			const auto distance = glm::length(bounds.center - cameraPos) - bounds.radius;
+			pixels = std::max(pixels, distance > 0.0f ? 2.0f * bounds.radius * pixelScale / distance : std::numeric_limits<float>::max());
+		}
+		if (pixels > 0.0f) {
+			for (const auto& texture : material->getTextures()) {
+				textureStreaming.reportUsage(texture.second.get(), pixels);
+			}
+		}
+	}
+	// the new images are swapped in by a later frame once their uploads finished
+	textureStreaming.update(*pScene);
 }
 
 void RenderBackend::setupGui()
@@ -1219,10 +1535,12 @@ void RenderBackend::setupDebugCallback()
 
 void RenderBackend::createDrawBuffer()
 {
-	const auto size = maxVertexSize + maxIndexSize;
+	const auto size = maxVertexSize + maxIndexSize + maxShortIndexSize;
 	indexBufferOffset = maxVertexSize;
+	shortIndexBufferOffset = indexBufferOffset + maxIndexSize;
 	lastVertexOffset = 0;
 	lastIndexOffset = 0;
+	lastShortIndexOffset = 0;
 
 	ppDrawMemory = new vkExt::SharedMemory();
 	createBuffer(size,
@@ -1230,13 +1548,16 @@ void RenderBackend::createDrawBuffer()
 	    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pDrawBuffer, ppDrawMemory);
 }
 
-void RenderBackend::increaseDrawBufferSize(VkDeviceSize newVertLimit, VkDeviceSize newIndexLimit)
+void RenderBackend::increaseDrawBufferSize(VkDeviceSize newVertLimit, VkDeviceSize newIndexLimit, VkDeviceSize newShortIndexLimit)
 {
 	const auto oldIndexOffset = indexBufferOffset;
+	const auto oldShortIndexOffset = shortIndexBufferOffset;
 	maxVertexSize = newVertLimit;
 	maxIndexSize = newIndexLimit;
+	maxShortIndexSize = newShortIndexLimit;
 	indexBufferOffset = maxVertexSize;
-	const auto size = maxVertexSize + maxIndexSize;
+	shortIndexBufferOffset = indexBufferOffset + maxIndexSize;
+	const auto size = maxVertexSize + maxIndexSize + maxShortIndexSize;
 
 	vkExt::Buffer temp;
 	auto* tempMem = new vkExt::SharedMemory();
@@ -1245,6 +1566,9 @@ void RenderBackend::increaseDrawBufferSize(VkDeviceSize newVertLimit, VkDeviceSi
 	    VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
 	    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, temp, tempMem);
 
+	// staged uploads into the old buffer complete and belong to the graphics queue, which copies them.
+	// Growing is rare enough to wait for the frames still drawing from the old buffer
+	stagingRing.finish();
 	if (lastVertexOffset > 0) {
 		temp.copyToBuffer(pCommandPool, pGraphicsQueue, pDrawBuffer, lastVertexOffset);
 	}
@@ -1252,7 +1576,14 @@ void RenderBackend::increaseDrawBufferSize(VkDeviceSize newVertLimit, VkDeviceSi
 		temp.copyToBuffer(pCommandPool, pGraphicsQueue, pDrawBuffer, lastIndexOffset, oldIndexOffset,
 		    indexBufferOffset);
 	}
+	if (lastShortIndexOffset > 0) {
+		temp.copyToBuffer(pCommandPool, pGraphicsQueue, pDrawBuffer, lastShortIndexOffset, oldShortIndexOffset,
+		    shortIndexBufferOffset);
+	}
 
+	// the recorded draws still bind the old buffer, they are re-recorded before the next frame is submitted
+	vkWaitForFences(pVulkanDevice, MAX_FRAMES_IN_FLIGHT, inFlightFences.data(), VK_TRUE, uint64_t(5e+9));
+	drawBufferReplaced = true;
 	pDrawBuffer.destroy(true);
 	const auto pOldMem = ppDrawMemory;
 	ppDrawMemory = tempMem;
@@ -1266,50 +1597,52 @@ void RenderBackend::increaseDrawBufferSize(VkDeviceSize newVertLimit, VkDeviceSi
 	pDrawBuffer.setupDescriptor();
 }
 
-Geometry::Mesh::BufferOffset RenderBackend::uploadMeshGPU(const Geometry::Mesh* mesh)
+Geometry::Mesh::BufferOffset RenderBackend::uploadMeshGPU(const Geometry::Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount)
 {
-	const auto indexOffset = lastIndexOffset / sizeof(uint32_t);
+	// every index of a mesh with at most 65536 vertices fits into 16 bit
+	const auto shortIndices = vertexCount <= 0x10000;
+	const auto indexSize = shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+	auto& lastRegionOffset = shortIndices ? lastShortIndexOffset : lastIndexOffset;
+	const auto indexOffset = lastRegionOffset / indexSize;
 	const auto vertexOffset = lastVertexOffset;
+	if (vertexCount == 0 || indexCount == 0) {
+		// nothing to upload, the mesh draws no triangles from the current end of the buffers
+		return { vertexOffset, indexOffset, shortIndices ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32 };
+	}
 
-	const auto vertSize = mesh->vertices.size() * sizeof(Geometry::Vertex);
-	const auto indSize = mesh->indices.size() * sizeof(uint32_t);
-	const auto totalVertSize = vertSize + lastVertexOffset;
-	const auto totalIndexSize = indSize + lastIndexOffset;
-	if (totalVertSize > maxVertexSize || totalIndexSize > maxIndexSize) {
-		increaseDrawBufferSize(2 * totalVertSize, 2 * totalIndexSize);
+	// quantized positions use the full 16 bit range within the bounds of the mesh
+	const auto box = vertexFormat == Geometry::VertexFormat::Quantized ? Geometry::Bounds::computeAABB(&vertices[0].position, vertexCount, sizeof(Geometry::Vertex)) : Geometry::AABB();
+	const void* vertexData = vertices;
+	std::vector<unsigned char> packedVertices;
+	if (vertexFormat != Geometry::VertexFormat::Full) {
+		Geometry::VertexPacking::pack(vertices, vertexCount, vertexFormat, box, packedVertices);
+		vertexData = packedVertices.data();
 	}
 
-	vkExt::Buffer stagingBuffer;
-	auto* stagingMemory = new vkExt::SharedMemory();
+	const auto vertSize = vertexCount * Geometry::VertexPacking::stride(vertexFormat);
+	const auto indSize = indexCount * indexSize;
+	const auto totalVertSize = vertSize + lastVertexOffset;
+	const auto totalIndexSize = (shortIndices ? 0 : indSize) + lastIndexOffset;
+	const auto totalShortIndexSize = (shortIndices ? indSize : 0) + lastShortIndexOffset;
+	if (totalVertSize > maxVertexSize || totalIndexSize > maxIndexSize || totalShortIndexSize > maxShortIndexSize) {
+		const auto grow = [](VkDeviceSize limit, VkDeviceSize required) { return required > limit ? 2 * required : limit; };
+		increaseDrawBufferSize(grow(maxVertexSize, totalVertSize), grow(maxIndexSize, totalIndexSize), grow(maxShortIndexSize, totalShortIndexSize));
+	}
 
-	createBuffer(vertSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-	    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer,
-	    stagingMemory);
-	// fill data
-	stagingBuffer.map();
-	stagingBuffer.copyTo(mesh->vertices.data(), (size_t)vertSize);
-	stagingBuffer.unmap();
+	const void* indexData = indices;
+	std::vector<uint16_t> shortIndexData;
+	if (shortIndices) {
+		shortIndexData.assign(indices, indices + indexCount);
+		indexData = shortIndexData.data();
+	}
 
-	pDrawBuffer.copyToBuffer(pCommandPool, pGraphicsQueue, stagingBuffer, vertSize, 0, lastVertexOffset);
+	stagingRing.copyToBuffer(vertexData, vertSize, pDrawBuffer.buffer, lastVertexOffset);
 	lastVertexOffset += vertSize;
 
-	stagingBuffer.destroy(true);
-	createBuffer(indSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-	    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer,
-	    stagingMemory);
+	stagingRing.copyToBuffer(indexData, indSize, pDrawBuffer.buffer, (shortIndices ? shortIndexBufferOffset : indexBufferOffset) + lastRegionOffset);
+	lastRegionOffset += indSize;
 
-	stagingBuffer.map();
-	stagingBuffer.copyTo(mesh->indices.data(), (size_t)indSize);
-	stagingBuffer.unmap();
-
-	pDrawBuffer.copyToBuffer(pCommandPool, pGraphicsQueue, stagingBuffer, indSize, 0,
-	    indexBufferOffset + lastIndexOffset);
-	lastIndexOffset += indSize;
-
-	stagingBuffer.destroy(true);
-	delete (stagingMemory);
-
-	Geometry::Mesh::BufferOffset offset = { vertexOffset, indexOffset };
+	Geometry::Mesh::BufferOffset offset = { vertexOffset, indexOffset, shortIndices ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32, Geometry::VertexPacking::positionTransform(vertexFormat, box) };
 	return offset;
 }
 
@@ -1404,7 +1737,7 @@ void RenderBackend::allocateMemory(VkDeviceSize size, VkMemoryPropertyFlags prop
 void RenderBackend::createImage2D(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
     VkImageUsageFlags usage, VkMemoryPropertyFlags properties, vkExt::Image& image,
     vkExt::SharedMemory* imageMemory, VkDeviceSize memOffset,
-    VkImageLayout initialLayout /*= VK_IMAGE_LAYOUT_UNDEFINED*/)
+    VkImageLayout initialLayout /*= VK_IMAGE_LAYOUT_UNDEFINED*/, uint32_t mipLevels /*= 1*/)
 {
 	VkImage vkimage;
 
@@ -1417,7 +1750,7 @@ void RenderBackend::createImage2D(uint32_t width, uint32_t height, VkFormat form
 		VK_IMAGE_TYPE_2D,
 		format,
 		{ width, height, 1 },
-		1,
+		mipLevels,
 		1,
 		VK_SAMPLE_COUNT_1_BIT,
 		tiling,
@@ -1461,7 +1794,7 @@ void RenderBackend::createImage2D(uint32_t width, uint32_t height, VkFormat form
 	}
 }
 
-VkImageView RenderBackend::createImageView2D(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
+VkImageView RenderBackend::createImageView2D(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels /*= 1*/)
 {
 	VkImageViewCreateInfo createInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
 		nullptr,
@@ -1471,7 +1804,7 @@ VkImageView RenderBackend::createImageView2D(VkImage image, VkFormat format, VkI
 		format,
 		{ VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
 		    VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY },
-		{ aspectFlags, 0, 1, 0, 1 } };
+		{ aspectFlags, 0, mipLevels, 0, 1 } };
 
 	VkImageView view;
 	if (vkCreateImageView(pVulkanDevice, &createInfo, nullptr, &view) != VK_SUCCESS) {
@@ -1481,8 +1814,31 @@ VkImageView RenderBackend::createImageView2D(VkImage image, VkFormat format, VkI
 	return view;
 }
 
+void RenderBackend::destroyImage(vkExt::Image& image, bool waitForUploads)
+{
+	if (waitForUploads) {
+		// uploads into the image may still be pending
+		stagingRing.finish();
+	}
+	image.destroy(true);
+	auto i = std::find(deviceCreatedImages.begin(), deviceCreatedImages.end(), image.image);
+	if (i != deviceCreatedImages.end()) {
+		deviceCreatedImages.erase(i);
+	}
+	image.image = nullptr;
+}
+
+void RenderBackend::destroyImageView(VkImageView view)
+{
+	vkDestroyImageView(pVulkanDevice, view, nullptr);
+	auto i = std::find(deviceCreatedImageViews.begin(), deviceCreatedImageViews.end(), view);
+	if (i != deviceCreatedImageViews.end()) {
+		deviceCreatedImageViews.erase(i);
+	}
+}
+
 void RenderBackend::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout,
-    VkImageLayout newLayout, VkCommandBuffer commandBuff /* = nullptr */) const
+    VkImageLayout newLayout, VkCommandBuffer commandBuff /* = nullptr */, uint32_t mipLevels /* = 1 */) const
 {
 	VkCommandBuffer cmdbuff = commandBuff ? commandBuff : beginOneTimeCommand();
 	VkImageMemoryBarrier barrier = {};
@@ -1500,7 +1856,7 @@ void RenderBackend::transitionImageLayout(VkImage image, VkFormat format, VkImag
 	    : VK_IMAGE_ASPECT_COLOR_BIT;
 
 	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.levelCount = mipLevels;
 	barrier.subresourceRange.baseArrayLayer = 0;
 	barrier.subresourceRange.layerCount = 1;
 
@@ -1549,6 +1905,19 @@ void RenderBackend::transitionImageLayout(VkImage image, VkFormat format, VkImag
 
 		srcStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
 		dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	} else if (oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+		// earlier frames may still sample the image
+		barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		srcStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	} else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 	} else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
 		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
@@ -1584,6 +1953,68 @@ void RenderBackend::transitionImageLayout(VkImage image, VkFormat format, VkImag
 	}
 }
 
+bool RenderBackend::supportsLinearBlit(VkFormat format) const
+{
+	VkFormatProperties props;
+	vkGetPhysicalDeviceFormatProperties(pPhysicalDevice, format, &props);
+	const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (props.optimalTilingFeatures & required) == required;
+}
+
+void RenderBackend::generateMipmaps(VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels, VkCommandBuffer commandBuff /* = nullptr */) const
+{
+	VkCommandBuffer cmdbuff = commandBuff ? commandBuff : beginOneTimeCommand();
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	auto mipWidth = static_cast<int32_t>(width);
+	auto mipHeight = static_cast<int32_t>(height);
+	for (uint32_t level = 1; level < mipLevels; ++level) {
+		// the previous level is complete, read it as blit source
+		barrier.subresourceRange.baseMipLevel = level - 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(cmdbuff, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		const auto nextWidth = std::max(mipWidth / 2, 1);
+		const auto nextHeight = std::max(mipHeight / 2, 1);
+		VkImageBlit blit = {};
+		blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+		blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
+		blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+		blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+		vkCmdBlitImage(cmdbuff, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(cmdbuff, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		mipWidth = nextWidth;
+		mipHeight = nextHeight;
+	}
+
+	// the last level was only written
+	barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmdbuff, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	if (!commandBuff) {
+		endOneTimeCommand(cmdbuff);
+	}
+}
+
 Vulkan::RequiredQueueFamilyIndices RenderBackend::getQueueFamilies(VkPhysicalDevice device) const
 {
 	Vulkan::RequiredQueueFamilyIndices indices;
@@ -1618,6 +2049,19 @@ Vulkan::RequiredQueueFamilyIndices RenderBackend::getQueueFamilies(VkPhysicalDev
 		++i;
 	}
 
+	// copy engines behind a transfer only family run next to rendering
+	for (uint32_t f = 0; f < queueFamCount; ++f) {
+		const auto flags = queueFamilies[f].queueFlags;
+		if (queueFamilies[f].queueCount > 0 && (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+			indices.transferFamily = static_cast<int>(f);
+			break;
+		}
+	}
+	if (indices.transferFamily < 0 && indices.graphicsFamily >= 0) {
+		indices.transferFamily = indices.graphicsFamily;
+		indices.transferQueueIndex = queueFamilies[indices.graphicsFamily].queueCount > 1 ? 1 : 0;
+	}
+
 	return indices;
 }
 
@@ -1733,6 +2177,9 @@ size_t RenderBackend::checkDeviceRequirements(VkPhysicalDevice device) const
 	if (requiredFeatures.textureCompressionBC > feats.textureCompressionBC) {
 		return DEVICE_NOT_SUITABLE;
 	}
+	if (requiredFeatures.drawIndirectFirstInstance > feats.drawIndirectFirstInstance) {
+		return DEVICE_NOT_SUITABLE;
+	}
 
 	VkSurfaceCapabilitiesKHR capabilities;
 	const auto res = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, pSurface, &capabilities);
@@ -15,13 +15,18 @@
 #include <future>
 
 #include "AppSettings.h"
+#include "BindlessMaterials.h"
 #include "Camera.h"
 #include "ComputePipeline.h"
 #include "Geometry.h"
 #include "GraphicsPipeline.h"
+#include "SamplerCache.h"
 #include "SparkleTypes.h"
+#include "StagingRing.h"
 #include "UI.h"
 #include "SceneLoader.h"
+#include "TextureStreaming.h"
+#include "VertexPacking.h"
 
 //#define MAX_FRAMES_IN_FLIGHT 2
 #define MAX_FRAMES_IN_FLIGHT 2
@@ -47,8 +52,13 @@ public:
 	void reloadShaders();
 	void toggleComputeEnabled() { computeEnabled = !computeEnabled; }
 	void toggleCPUCullEnabled() { cullCPU = !cullCPU; }
+	/**
+	 * re-record the draws after meshes were added to the current scene, waits for the device.
+	 * Called at most once per rebuild window while a level is activated.
+	 */
+	void updateDrawCommand();
 
-	Geometry::Mesh::BufferOffset uploadMeshGPU(const Geometry::Mesh* mesh);
+	Geometry::Mesh::BufferOffset uploadMeshGPU(const Geometry::Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount);
 
 	std::shared_ptr<GUI> getUiHandle() const { return pUi; }
 
@@ -64,8 +74,16 @@ public:
 	VkExtent2D getSwapChainExtent() const { return swapChainExtent; }
 	const std::vector<VkImageView>& getSwapChainImageViewsRef() const { return swapChainImageViews; }
 	const std::vector<VkImageView>& getDepthImageViewsRef() const { return depthImageViews; }
-	const VkDescriptorSetLayout& getMaterialDescriptorSetLayout() const { return pMaterialDescriptorSetLayout; }
+	const VkDescriptorSetLayout& getMaterialDescriptorSetLayout() const { return bindless ? bindlessMaterials.descSetLayout : pMaterialDescriptorSetLayout; }
 	const size_t getMaterialTextureLimit() const { return materialTextureLimit; }
+	/**
+	 * materials are selected per instance from one texture array and materials buffer instead of a descriptor set per material
+	 */
+	bool bindlessMaterialsEnabled() const { return bindless; }
+	Geometry::VertexFormat getVertexFormat() const { return vertexFormat; }
+	TextureStreaming& getTextureStreaming() { return textureStreaming; }
+	SamplerCache& getSamplerCache() { return samplerCache; }
+	StagingRing& getStagingRing() { return stagingRing; }
 
 	/*
 		* Vulkan Resource creation
@@ -73,9 +91,27 @@ public:
 	void allocateMemory(VkDeviceSize size, VkMemoryPropertyFlags properties, uint32_t memoryTypeFilterBits, vkExt::SharedMemory* memory) const;
 	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, vkExt::Buffer& buffer, vkExt::SharedMemory* bufferMemory) const;
 
-	void createImage2D(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, vkExt::Image& image, vkExt::SharedMemory* imageMemory, VkDeviceSize memOffset = 0, VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED);
-	VkImageView createImageView2D(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
-	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandBuffer commandBuff = nullptr) const;
+	void createImage2D(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, vkExt::Image& image, vkExt::SharedMemory* imageMemory, VkDeviceSize memOffset = 0, VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED, uint32_t mipLevels = 1);
+	VkImageView createImageView2D(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels = 1);
+	/**
+	 * destroy an image of createImage2D and free its memory before the renderer shuts down, the gpu must not use it anymore
+	 * \param waitForUploads finish the staging batches first, not needed if the uploads of the image are known to be complete
+	 */
+	void destroyImage(vkExt::Image& image, bool waitForUploads = true);
+	void destroyImageView(VkImageView view);
+	/**
+	 * transitions all mip levels of the image
+	 */
+	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandBuffer commandBuff = nullptr, uint32_t mipLevels = 1) const;
+	/**
+	 * true if the format can be the source of a linear filtered blit, required by generateMipmaps
+	 */
+	bool supportsLinearBlit(VkFormat format) const;
+	/**
+	 * fills mip levels 1..mipLevels-1 by repeatedly halving level 0 with linear blits
+	 * all levels are expected in TRANSFER_DST_OPTIMAL and end up in SHADER_READ_ONLY_OPTIMAL
+	 */
+	void generateMipmaps(VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels, VkCommandBuffer commandBuff = nullptr) const;
 
 	VkCommandBuffer beginOneTimeCommand() const;
 	void endOneTimeCommand(VkCommandBuffer buffer) const;
@@ -112,11 +148,25 @@ private:
 	std::shared_ptr<DeferredDraw> pGraphicsPipeline;
 
 	ComputePipeline compute;
+	TextureStreaming textureStreaming;
+	SamplerCache samplerCache;
+	StagingRing stagingRing;
+	float anisotropy = 16.0f; // requested by the settings, limited by the device when the sampler cache is created
+	BindlessMaterials bindlessMaterials;
+	// bindless materials are requested by the settings and enabled if the device supports descriptor indexing,
+	// disabled again if a scene exceeds the texture array
+	bool bindlessRequested = false;
+	bool bindless = false;
+	bool physicalDeviceProperties2 = false;
 	bool computeEnabled = false;
 	bool cullCPU = false;
+	float lodErrorPixels = 1.0f;
+	// layout meshes are converted to on upload, fixed for the lifetime of the draw buffer and the mrt pipeline
+	Geometry::VertexFormat vertexFormat = Geometry::VertexFormat::Full;
 
 	VkQueue pGraphicsQueue;
 	VkQueue pPresentQueue;
+	VkQueue pTransferQueue;
 
 	// Buffer and associated memory for Geometry used in the main draw pass
 	vkExt::Buffer pDrawBuffer;
@@ -130,15 +180,27 @@ private:
 	} screenQuad;
 
 	// some attributes used for the shared vertex and index buffer memory
+	// layout: vertices | 32 bit indices | 16 bit indices of meshes with at most 65536 vertices
 	VkDeviceSize maxVertexSize = INITIAL_VERTEX_COUNT * sizeof(Geometry::Vertex);
 	VkDeviceSize lastVertexOffset;
 	VkDeviceSize maxIndexSize = INITIAL_VERTEX_COUNT * sizeof(uint32_t);
 	VkDeviceSize indexBufferOffset;
 	VkDeviceSize lastIndexOffset;
+	VkDeviceSize maxShortIndexSize = INITIAL_VERTEX_COUNT * sizeof(uint16_t);
+	VkDeviceSize shortIndexBufferOffset;
+	VkDeviceSize lastShortIndexOffset;
+	// the draw buffer grew since the draws were recorded, they bind the destroyed one
+	bool drawBufferReplaced = false;
 
 	vkExt::Buffer pInstanceBuffer;
 	vkExt::SharedMemory* ppInstanceMemory = nullptr;
 
+	// cluster bounds and the (instance, cluster) pairs culled by the compute pass
+	vkExt::Buffer pClusterBuffer;
+	vkExt::SharedMemory* ppClusterMemory = nullptr;
+	vkExt::Buffer pClusterDrawBuffer;
+	vkExt::SharedMemory* ppClusterDrawMemory = nullptr;
+
 	VkDeviceSize indirectCommandsSize;
 	vkExt::Buffer pIndirectCommandsBuffer;
 	vkExt::SharedMemory* ppIndirectCommandMemory = nullptr;
@@ -146,6 +208,13 @@ private:
 	vkExt::Buffer pIndirectDrawCountBuffer;
 	vkExt::SharedMemory* ppIndirectDrawCountMemory = nullptr;
 
+	// one draw command per batch and swapchain image for draws without gpu culling, written by the host before the
+	// submit so lod and visibility changes do not re-record the command buffers
+	std::vector<vkExt::Buffer> pCpuDrawBuffers;
+	std::vector<vkExt::SharedMemory*> ppCpuDrawMemory;
+	size_t cpuDrawCapacity = 0;
+	size_t cpuDrawCount = 0; // batches recorded into the command buffers
+
 	// Synchronization objects
 	std::vector<VkSemaphore> semImageAvailable;
 	std::vector<VkSemaphore> semOffScreenFinished;
@@ -202,6 +271,7 @@ private:
 
 	bool updateGeometry = true;
 	int drawCount = -1;
+	uint32_t lightOverflowClusters = 0; // clusters that dropped lights in the last frame
 
 	void setupVulkan();
 
@@ -218,26 +288,46 @@ private:
 	void createCommandPool();
 	void createDepthResources();
 	void createMaterialDescriptorSetLayout();
+	void createSamplerCache();
 	void createPipeline();
 	void createComputePipeline();
 	void createDrawBuffer();
 	void createCommandBuffers();
 	void recordDrawCmdBuffers();
+	/**
+	 * grow the host visible draw command buffers to one command per batch, the gpu must not use them
+	 */
+	void createCpuDrawBuffers(size_t batchCount);
+	/**
+	 * write the selected lod and visibility of every recorded batch into the draw commands of the swapchain image
+	 */
+	void writeCpuDrawCommands(uint32_t imageIndex);
 	void recordComputeCmdBuffers();
+	void uploadStorageBuffer(const void* data, VkDeviceSize size, vkExt::Buffer& buffer, vkExt::SharedMemory*& memory);
 	void createSyncObjects();
 	void setupGui();
-	void setupLights();
-	void increaseDrawBufferSize(VkDeviceSize newVertLimit, VkDeviceSize newIndexLimit);
+	/**
+	 * copy the lights of the current scene into the deferred pass uniforms
+	 */
+	void updateLights();
+	/**
+	 * swap in streamed textures whose uploads finished, then report the screen size of the textures
+	 * of visible draws and start uploads for their new resident levels
+	 */
+	void streamTextures();
+	/**
+	 * write the scene materials into the bindless set, falls back to a descriptor set per material
+	 * and rebuilds the pipelines if the scene does not fit into it
+	 */
+	void updateBindlessMaterials();
+	void increaseDrawBufferSize(VkDeviceSize newVertLimit, VkDeviceSize newIndexLimit, VkDeviceSize newShortIndexLimit);
 	void cleanupSwapChain();
 	void recreateSwapChain();
 	void destroyCommandBuffers();
 	void recreateDrawCmdBuffers();
 	void recreateAllCmdBuffers();
-	void updateDrawCommand();
 	void createScreenQuad();
 
-	void initLight(Lights::Light* light, glm::vec3 pos, glm::vec3 col, float radius, Lights::LType type = Lights::LTypeFlags::SPARKLE_LIGHT_TYPE_POINT);
-
 	Vulkan::RequiredQueueFamilyIndices getQueueFamilies(VkPhysicalDevice device) const;
 	Vulkan::SwapChainSupportInfo getSwapChainSupportInfo(VkPhysicalDevice device) const;
 	size_t checkDeviceRequirements(VkPhysicalDevice device) const;
@@ -0,0 +1,338 @@
+#include "AssimpConverter.h"
+
+#include <assimp/material.h>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Bounds.h"
+#include "Util.h"
+
+#ifdef _WIN32
+#include <filesystem>
+namespace fs = std::filesystem;
+#elif __linux__
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+using namespace Sparkle;
+using namespace Geometry;
+
+static glm::mat4 toGlm(const aiMatrix4x4& m)
+{
+	const float tvals[16] = {
+		static_cast<float>(m.a1), static_cast<float>(m.b1), static_cast<float>(m.c1), static_cast<float>(m.d1),
+		static_cast<float>(m.a2), static_cast<float>(m.b2), static_cast<float>(m.c2), static_cast<float>(m.d2),
+		static_cast<float>(m.a3), static_cast<float>(m.b3), static_cast<float>(m.c3), static_cast<float>(m.d3),
+		static_cast<float>(m.a4), static_cast<float>(m.b4), static_cast<float>(m.c4), static_cast<float>(m.d4)
+	};
+	return glm::make_mat4(tvals);
+}
+
+Import::AssimpConverter::AssimpConverter(const aiScene* scene, const std::string& rootDirectory)
+    : scene(scene)
+    , rootDirectory(rootDirectory)
+{
+	try {
+		for (const auto& file : fs::directory_iterator(rootDirectory.empty() ? "." : rootDirectory)) {
+			if (fs::is_directory(file.path()))
+				continue;
+			auto ext = file.path().extension();
+			if (IO::isImageExtension(ext.string())) {
+				textureFiles[file.path().stem().string()] = (file.path().filename().string());
+			}
+		}
+	} catch (std::exception& ex) {
+		LOGSTDOUT(ex.what());
+	}
+}
+
+Import::LevelData Import::AssimpConverter::convert(Tools::ThreadPool* pool)
+{
+	level = LevelData();
+	textureLookup.clear();
+	materialLookup.clear();
+	materialRemap.clear();
+	nodeLookup.clear();
+
+	textureLookup.reserve(scene->mNumMaterials * LevelFormat::TextureSlots);
+	materialLookup.reserve(scene->mNumMaterials);
+	materialRemap.reserve(scene->mNumMaterials);
+	for (size_t i = 0; i < scene->mNumMaterials; ++i) {
+		convertMaterial(scene->mMaterials[i]);
+	}
+
+	// every mesh only writes its own pre-allocated entry, so they can be converted independently
+	level.meshes.resize(scene->mNumMeshes);
+	std::vector<MeshOptimizer::Report> reports(scene->mNumMeshes);
+	const auto convertMeshAt = [this, &reports](size_t i) {
+		convertMesh(scene->mMeshes[i], level.meshes[i]);
+		reports[i] = MeshOptimizer::optimize(level.meshes[i].data);
+		MeshSimplifier::generateLods(level.meshes[i].data);
+		MeshClusterizer::buildClusters(level.meshes[i].data);
+	};
+	if (pool) {
+		pool->parallelFor(scene->mNumMeshes, convertMeshAt);
+	} else {
+		for (size_t i = 0; i < scene->mNumMeshes; ++i) {
+			convertMeshAt(i);
+		}
+	}
+	optimizerReport = MeshOptimizer::Report();
+	for (const auto& report : reports) {
+		optimizerReport += report;
+	}
+
+	if (scene->mRootNode) {
+		convertNode(scene->mRootNode, LevelFormat::InvalidIndex);
+	}
+	convertLights();
+
+	return std::move(level);
+}
+
+std::string Import::AssimpConverter::normalizePath(const std::string& path)
+{
+	// exporters reference the same file as "./tex\a.png", "tex//a.png" or "sub/../tex/a.png"
+	std::vector<std::string> parts;
+	size_t start = 0;
+	while (start <= path.size()) {
+		auto end = path.find_first_of("/\\", start);
+		end = end == std::string::npos ? path.size() : end;
+		const auto part = path.substr(start, end - start);
+		if (part == "..") {
+			if (!parts.empty() && parts.back() != "..") {
+				parts.pop_back();
+			} else {
+				parts.push_back(part);
+			}
+		} else if (!part.empty() && part != ".") {
+			parts.push_back(part);
+		}
+		start = end + 1;
+	}
+
+	std::string normalized;
+	normalized.reserve(path.size());
+	for (const auto& part : parts) {
+		if (!normalized.empty()) {
+			normalized += '/';
+		}
+		normalized += part;
+	}
+	return normalized;
+}
+
+uint32_t Import::AssimpConverter::addTextureFile(const std::string& relativePath, uint32_t typeID)
+{
+	// the same image can be bound with different meanings, materials map textures by their type
+	const auto key = relativePath + '#' + std::to_string(typeID);
+	const auto cached = textureLookup.find(key);
+	if (cached != textureLookup.end()) {
+		return cached->second;
+	}
+	const auto index = static_cast<uint32_t>(level.textures.size());
+	level.textures.push_back({ relativePath, typeID, {}, {} });
+	textureLookup[key] = index;
+	return index;
+}
+
+uint32_t Import::AssimpConverter::addTexture(const aiString& path, uint32_t typeID)
+{
+	auto strPtr = path.C_Str();
+	if (*strPtr == '*') { // embedded texture!
+		const auto key = std::string(strPtr) + '#' + std::to_string(typeID);
+		const auto cached = textureLookup.find(key);
+		if (cached != textureLookup.end()) {
+			return cached->second;
+		}
+		try {
+			auto index = static_cast<unsigned int>(std::stoi(strPtr + 1));
+			if (index >= scene->mNumTextures) {
+				return LevelFormat::InvalidIndex;
+			}
+			auto texData = scene->mTextures[index];
+			if (texData->mHeight != 0) {
+				LOGSTDOUT("Uncompressed embedded textures are not supported, skipping " + std::string(strPtr));
+				return LevelFormat::InvalidIndex;
+			}
+			LevelData::TextureEntry entry;
+			entry.type = typeID;
+			auto data = reinterpret_cast<const unsigned char*>(texData->pcData);
+			entry.embedded.assign(data, data + texData->mWidth);
+			entry.embeddedExtension = std::string(texData->achFormatHint);
+			entry.path = texData->mFilename.length > 0 ? std::string(texData->mFilename.C_Str()) : std::string(strPtr);
+
+			const auto texIndex = static_cast<uint32_t>(level.textures.size());
+			level.textures.push_back(std::move(entry));
+			textureLookup[key] = texIndex;
+			return texIndex;
+		} catch (std::exception& ex) {
+			LOGSTDOUT(ex.what());
+			return LevelFormat::InvalidIndex;
+		}
+	}
+
+	return addTextureFile(normalizePath(strPtr), typeID);
+}
+
+void Import::AssimpConverter::convertMaterial(const aiMaterial* material)
+{
+	LevelData::MaterialEntry entry;
+	entry.name = std::string(material->GetName().C_Str());
+	entry.textures.fill(LevelFormat::InvalidIndex);
+
+	const std::pair<aiTextureType, uint32_t> slots[] = {
+		{ aiTextureType_DIFFUSE, TEX_TYPE_DIFFUSE },
+		{ aiTextureType_SPECULAR, TEX_TYPE_SPECULAR },
+		{ aiTextureType_HEIGHT, TEX_TYPE_NORMAL },
+		{ aiTextureType_NORMALS, TEX_TYPE_NORMAL },
+		{ aiTextureType_SHININESS, TEX_TYPE_ROUGHNESS },
+		{ aiTextureType_AMBIENT, TEX_TYPE_METALLIC },
+	};
+	for (const auto& [aiType, typeID] : slots) {
+		if (entry.textures[typeID] != LevelFormat::InvalidIndex || material->GetTextureCount(aiType) == 0) {
+			continue;
+		}
+		aiString str;
+		if (material->GetTexture(aiType, 0, &str) == AI_SUCCESS) {
+			entry.textures[typeID] = addTexture(str, typeID);
+		}
+	}
+
+	if (entry.textures[TEX_TYPE_DIFFUSE] == LevelFormat::InvalidIndex) { // workaround for blender exports without texture references
+		auto matName = entry.name.substr(0, entry.name.find_first_of('.'));
+		for (const auto& t : texFileNames) {
+			const auto file = textureFiles.find(matName + t.first);
+			if (file != textureFiles.end() && entry.textures[t.second] == LevelFormat::InvalidIndex) {
+				entry.textures[t.second] = addTextureFile(file->second, t.second);
+			}
+		}
+	}
+
+	const auto cached = materialLookup.find(entry.textures);
+	if (cached != materialLookup.end()) {
+		materialRemap.push_back(cached->second);
+		return;
+	}
+	const auto index = static_cast<uint32_t>(level.materials.size());
+	materialLookup[entry.textures] = index;
+	materialRemap.push_back(index);
+	level.materials.push_back(std::move(entry));
+}
+
+void Import::AssimpConverter::convertMesh(const aiMesh* mesh, LevelData::MeshEntry& entry) const
+{
+	entry.name = std::string(mesh->mName.C_Str());
+	entry.material = mesh->mMaterialIndex < materialRemap.size() ? materialRemap[mesh->mMaterialIndex] : LevelFormat::InvalidIndex;
+	if (!(mesh->mPrimitiveTypes & aiPrimitiveType_TRIANGLE) || mesh->mNumVertices == 0) {
+		return;
+	}
+
+	auto& data = entry.data;
+	data.vertices.resize(mesh->mNumVertices);
+
+	for (size_t j = 0; j < mesh->mNumVertices; ++j) {
+		auto& vtx = data.vertices[j];
+		const auto& aiVtx = mesh->mVertices[j];
+		vtx.position = glm::vec3(aiVtx.x, aiVtx.y, aiVtx.z);
+		if (mesh->mNormals) {
+			const auto& norm = mesh->mNormals[j];
+			vtx.normal = glm::vec3(norm.x, norm.y, norm.z);
+		} else {
+			vtx.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+		}
+		if (mesh->mTangents && mesh->mBitangents) {
+			const auto& tang = mesh->mTangents[j];
+			vtx.tangent = glm::vec3(tang.x, tang.y, tang.z);
+			const auto& btang = mesh->mBitangents[j];
+			vtx.bitangent = glm::vec3(btang.x, btang.y, btang.z);
+		} else {
+			vtx.tangent = glm::vec3(0.0f);
+			vtx.bitangent = vtx.tangent;
+		}
+		if (mesh->mTextureCoords[0]) {
+			const auto& tc = mesh->mTextureCoords[0][j];
+			vtx.texCoord = glm::vec2(tc.x, tc.y);
+		} else {
+			vtx.texCoord = glm::vec2(0.0f);
+		}
+	}
+
+	// SortByPType may leave points and lines in mixed meshes, only triangles are kept
+	data.indices.resize(static_cast<size_t>(mesh->mNumFaces) * 3);
+	size_t count = 0;
+	for (size_t j = 0; j < mesh->mNumFaces; ++j) {
+		const auto& face = mesh->mFaces[j];
+		if (face.mNumIndices != 3) {
+			continue;
+		}
+		data.indices[count++] = face.mIndices[0];
+		data.indices[count++] = face.mIndices[1];
+		data.indices[count++] = face.mIndices[2];
+	}
+	data.indices.resize(count);
+
+	data.boundingSphere = Bounds::computeSphere(&data.vertices[0].position, data.vertices.size(), sizeof(Vertex));
+}
+
+void Import::AssimpConverter::convertNode(const aiNode* node, uint32_t parent)
+{
+	LevelData::NodeEntry entry;
+	entry.model = toGlm(node->mTransformation);
+	entry.parent = parent;
+	for (size_t i = 0; i < node->mNumMeshes; ++i) {
+		const auto meshIndex = node->mMeshes[i];
+		if (meshIndex < level.meshes.size() && !level.meshes[meshIndex].data.indices.empty()) {
+			entry.meshes.push_back(meshIndex);
+		}
+	}
+
+	const auto index = static_cast<uint32_t>(level.nodes.size());
+	level.nodes.push_back(std::move(entry));
+	nodeLookup.emplace(std::string(node->mName.C_Str()), index);
+
+	for (size_t i = 0; i < node->mNumChildren; ++i) {
+		convertNode(node->mChildren[i], index);
+	}
+}
+
+void Import::AssimpConverter::convertLights()
+{
+	level.lights.reserve(scene->mNumLights);
+	for (size_t i = 0; i < scene->mNumLights; ++i) {
+		const auto light = scene->mLights[i];
+		const auto name = std::string(light->mName.C_Str());
+
+		// position and direction of a light are relative to the node of the same name
+		glm::mat4 world(1.0f);
+		const auto node = nodeLookup.find(name);
+		if (node != nodeLookup.end()) {
+			for (auto n = node->second; n != LevelFormat::InvalidIndex; n = level.nodes[n].parent) {
+				world = level.nodes[n].model * world;
+			}
+		}
+
+		const auto color = glm::vec3(light->mColorDiffuse.r, light->mColorDiffuse.g, light->mColorDiffuse.b);
+		switch (light->mType) {
+		case aiLightSource_DIRECTIONAL: {
+			const auto direction = glm::vec3(world * glm::vec4(light->mDirection.x, light->mDirection.y, light->mDirection.z, 0.0f));
+			if (glm::dot(direction, direction) > 0.0f) {
+				level.lights.push_back(Lights::directionalLight(direction, color));
+			}
+			break;
+		}
+		case aiLightSource_POINT:
+		case aiLightSource_SPOT: { // the deferred pass has no cone, spot lights are lit like point lights
+			const auto position = glm::vec3(world * glm::vec4(light->mPosition.x, light->mPosition.y, light->mPosition.z, 1.0f));
+			// blinn phong attenuates with radius / (d^2 + 1), which matches 1 / (quadratic * d^2) at a distance
+			const auto radius = light->mAttenuationQuadratic > 0.0f ? 1.0f / light->mAttenuationQuadratic : 1.0f;
+			level.lights.push_back(Lights::pointLight(position, color, radius));
+			break;
+		}
+		default:
+			LOGSTDOUT("Unsupported type of light " + name + ", skipping");
+			break;
+		}
+	}
+}
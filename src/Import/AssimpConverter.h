@@ -0,0 +1,79 @@
+#ifndef ASSIMP_CONVERTER_H
+#define ASSIMP_CONVERTER_H
+
+#include <map>
+#include <string>
+#include <unordered_map>
+
+#include <assimp/scene.h>
+
+#include "LevelData.h"
+#include "MeshClusterizer.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ThreadPool.h"
+
+namespace Sparkle {
+namespace Import {
+	/**
+	 * converts an imported aiScene into LevelData, does not require a renderer
+	 */
+	class AssimpConverter {
+	public:
+		/**
+		 * \param rootDirectory directory of the source file, texture paths are stored relative to it
+		 */
+		AssimpConverter(const aiScene* scene, const std::string& rootDirectory);
+
+		/**
+		 * \param pool optional worker pool, meshes are converted in parallel when given
+		 */
+		LevelData convert(Tools::ThreadPool* pool = nullptr);
+
+		/**
+		 * vertex cache statistics of all meshes of the last convert, before and after optimization
+		 */
+		const MeshOptimizer::Report& getOptimizerReport() const { return optimizerReport; }
+
+	private:
+		const aiScene* scene;
+		std::string rootDirectory;
+
+		LevelData level;
+		MeshOptimizer::Report optimizerReport;
+		/**
+		 * level texture index by normalized path and TEX_TYPE_*
+		 */
+		std::unordered_map<std::string, uint32_t> textureLookup;
+		/**
+		 * level material index by texture set, materials only differing by name are merged
+		 */
+		std::unordered_map<std::array<uint32_t, LevelFormat::TextureSlots>, uint32_t, TextureSetHash> materialLookup;
+		/**
+		 * level material index per aiScene material
+		 */
+		std::vector<uint32_t> materialRemap;
+		/**
+		 * image files in the level directory by file stem
+		 * used for materials exported without texture references (blender)
+		 */
+		std::map<std::string, std::string> textureFiles;
+		/**
+		 * first level node by aiNode name, lights reference the node that places them by name
+		 */
+		std::unordered_map<std::string, uint32_t> nodeLookup;
+		const std::vector<std::pair<std::string, int>> texFileNames = { { "_albedo", TEX_TYPE_DIFFUSE }, { "_metallic", TEX_TYPE_METALLIC }, { "_normal", TEX_TYPE_NORMAL }, { "_roughness", TEX_TYPE_ROUGHNESS } };
+
+		static std::string normalizePath(const std::string& path);
+
+		uint32_t addTexture(const aiString& path, uint32_t typeID);
+		uint32_t addTextureFile(const std::string& relativePath, uint32_t typeID);
+		void convertMaterial(const aiMaterial* material);
+		void convertMesh(const aiMesh* mesh, LevelData::MeshEntry& entry) const;
+		void convertNode(const aiNode* node, uint32_t parent);
+		void convertLights();
+	};
+} // namespace Import
+} // namespace Sparkle
+
+#endif
@@ -8,36 +8,41 @@
 #include <assimp/scene.h>
 
 #include "Geometry.h"
+#include "LevelData.h"
+#include "SceneBuilder.h"
+#include "ThreadPool.h"
 
 namespace Sparkle {
 namespace Import {
 	class AssimpLoader {
 	public:
-		void loadFromFile(const std::string& fileName);
-		std::unique_ptr<Geometry::Scene> processAssimp();
+		/**
+		 * \param compressTextures block compress the textures of the level, see TextureCompression::load
+		 */
+		void loadFromFile(const std::string& fileName, bool compressTextures = true);
+		/**
+		 * queue the scene creation into activation, the loader has to outlive it
+		 */
+		void processAssimp(SceneActivation& activation);
 		bool isLoaded() const { return loaded; }
 	private:
 		std::atomic_bool loaded = false;
 
 		std::future<void> levelLoadFuture;
-		std::vector<std::shared_ptr<Texture>> textureCache;
-		std::map<std::string, std::string> textureFiles;
-		std::vector<std::shared_ptr<Material>> materialCache;
-
-		std::vector<std::pair<std::string, int>> texFileNames = { { "_albedo", TEX_TYPE_DIFFUSE }, { "_metallic", TEX_TYPE_METALLIC }, { "_normal", TEX_TYPE_NORMAL }, { "_roughness", TEX_TYPE_ROUGHNESS } };
+		/**
+		 * meshes are converted and textures decoded on these workers while the level loads,
+		 * only scene creation and GPU uploads remain for the activation
+		 */
+		Tools::ThreadPool workers;
+		LevelData level;
+		SceneBuilder::DecodedTextures images;
 
 		std::mutex sceneMutex;
 		Assimp::Importer importer;
-		const aiScene* scenePtr;
 		std::mutex dirMutex;
 		std::string rootDirectory;
-
-		std::vector<std::shared_ptr<Texture>> loadMaterialTextures(aiMaterial* mat, aiTextureType type, size_t typeID);
-		void processAINode(aiNode* node, const aiScene* scene, std::shared_ptr<Geometry::Node> parentNode);
-		void createMesh(aiNode* node, const aiScene* scene, std::shared_ptr<Geometry::Node> parentNode);
-	
 	};
 }
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -1,22 +1,149 @@
 #include "GltfLoader.h"
+#include "Bounds.h"
 #include "Util.h"
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #define TINYGLTF_IMPLEMENTATION
 #include <tinygltf/tiny_gltf.h>
 
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <Geometry.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
 using namespace Sparkle;
 using namespace Geometry;
 
+/*
+ * converts a single accessor component to float, respecting the normalized flag
+ */
+static float componentToFloat(const unsigned char* src, int componentType, bool normalized)
+{
+	switch (componentType) {
+	case TINYGLTF_COMPONENT_TYPE_FLOAT: {
+		float v;
+		std::memcpy(&v, src, sizeof(float));
+		return v;
+	}
+	case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
+		const auto v = *src;
+		return normalized ? v / 255.0f : static_cast<float>(v);
+	}
+	case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+		uint16_t v;
+		std::memcpy(&v, src, sizeof(uint16_t));
+		return normalized ? v / 65535.0f : static_cast<float>(v);
+	}
+	case TINYGLTF_COMPONENT_TYPE_BYTE: {
+		int8_t v;
+		std::memcpy(&v, src, sizeof(int8_t));
+		return normalized ? std::max(v / 127.0f, -1.0f) : static_cast<float>(v);
+	}
+	case TINYGLTF_COMPONENT_TYPE_SHORT: {
+		int16_t v;
+		std::memcpy(&v, src, sizeof(int16_t));
+		return normalized ? std::max(v / 32767.0f, -1.0f) : static_cast<float>(v);
+	}
+	default:
+		return 0.0f;
+	}
+}
+
+/*
+ * glTF texture index of a material parameter, -1 if the material does not use it
+ */
+static int textureIndex(const tinygltf::ParameterMap& params, const std::string& name)
+{
+	const auto it = params.find(name);
+	return it == params.end() ? -1 : it->second.TextureIndex();
+}
+
+/*
+ * streams a vector attribute from a (possibly interleaved) glTF buffer view into the vertex array
+ * float data is copied as is without any intermediate storage, other component types are converted in place
+ */
+static void streamAttribute(const unsigned char* src, size_t srcStride, const tinygltf::Accessor& accessor, size_t components, unsigned char* dst, size_t dstStride)
+{
+	if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+		const auto size = components * sizeof(float);
+		for (size_t i = 0; i < accessor.count; ++i) {
+			std::memcpy(dst + i * dstStride, src + i * srcStride, size);
+		}
+	} else {
+		const auto componentSize = static_cast<size_t>(tinygltf::GetComponentSizeInBytes(accessor.componentType));
+		for (size_t i = 0; i < accessor.count; ++i) {
+			auto out = reinterpret_cast<float*>(dst + i * dstStride);
+			for (size_t c = 0; c < components; ++c) {
+				out[c] = componentToFloat(src + i * srcStride + c * componentSize, accessor.componentType, accessor.normalized);
+			}
+		}
+	}
+}
+
+template <typename T>
+static void streamIndices(const unsigned char* src, size_t srcStride, size_t count, uint32_t* dst)
+{
+	for (size_t i = 0; i < count; ++i) {
+		T idx;
+		std::memcpy(&idx, src + i * srcStride, sizeof(T));
+		dst[i] = static_cast<uint32_t>(idx);
+	}
+}
+
+/*
+ * image loader that only keeps the encoded bytes, all images are decoded in parallel once parsing is done.
+ * Images stored in the mapped BIN chunk of .glb files only carry a one byte placeholder and are collected separately.
+ */
+static bool deferImageData(tinygltf::Image* image, const int imageIndex, std::string* err, std::string* warn, int reqWidth, int reqHeight, const unsigned char* bytes, int size, void* userData)
+{
+	if (size <= 1) {
+		return true;
+	}
+	auto encodedImages = reinterpret_cast<std::vector<Import::glTFLoader::EncodedImage>*>(userData);
+	Import::glTFLoader::EncodedImage encoded;
+	encoded.image = imageIndex;
+	encoded.owned.assign(bytes, bytes + size);
+	encoded.data = nullptr;
+	encoded.size = encoded.owned.size();
+	encodedImages->push_back(std::move(encoded));
+	return true;
+}
+
 void Import::glTFLoader::loadFromFile(std::string filePath)
 {
 	levelLoadFuture = std::async(std::launch::async, [this, filePath]() {
-		tinygltf::TinyGLTF loader;
+		auto dirOffs = filePath.rfind('/');
+		dirOffs = dirOffs == std::string::npos ? filePath.rfind('\\') : dirOffs;
+		std::string baseDir;
+		{
+			std::lock_guard<std::mutex> lock(dirMutex);
+			if (dirOffs != std::string::npos) {
+				rootDirectory = filePath.substr(0, dirOffs) + "/";
+			} else {
+				rootDirectory = "assets/";
+			}
+			baseDir = rootDirectory;
+		}
+
 		std::string err, warn;
-		auto ret = loader.LoadASCIIFromFile(&model, &err, &warn, filePath);
+		bool ret;
+		const auto extOffs = filePath.rfind('.');
+		if (extOffs != std::string::npos && filePath.compare(extOffs, std::string::npos, ".glb") == 0) {
+			ret = loadBinaryMapped(filePath, baseDir, err, warn);
+		} else {
+			tinygltf::TinyGLTF loader;
+			loader.SetImageLoader(deferImageData, &encodedImages);
+			ret = loader.LoadASCIIFromFile(&model, &err, &warn, filePath);
+		}
+		if (ret) {
+			decodeImages(warn);
+			decodeMeshes();
+		}
 
 		if (!warn.empty()) {
 			LOGSTDOUT(warn)
@@ -25,152 +152,674 @@ void Import::glTFLoader::loadFromFile(std::string filePath)
 			LOGSTDOUT(err);
 		}
 		if (!ret) {
-			throw std::runtime_error("Unable to read glTF file!");
+			failed = true;
+			throw std::runtime_error("Unable to load scene from " + filePath);
 		}
-		auto dirOffs = filePath.rfind('/');
-		dirOffs = dirOffs == std::string::npos ? filePath.rfind('\\') : dirOffs;
-		{
-			std::lock_guard<std::mutex> lock(dirMutex);
-			if (dirOffs != std::string::npos) {
-				rootDirectory = filePath.substr(0, dirOffs) + "/";
-			} else {
-				rootDirectory = "assets/";
+		loaded = true;
+	});
+}
+
+bool Import::glTFLoader::loadBinaryMapped(const std::string& filePath, const std::string& baseDir, std::string& err, std::string& warn)
+{
+	constexpr uint32_t glbMagic = 0x46546C67; // "glTF"
+	constexpr uint32_t chunkJSON = 0x4E4F534A;
+	constexpr uint32_t chunkBIN = 0x004E4942;
+	// placeholder payload (a single zero byte) for everything that lives in the BIN chunk
+	const std::string placeholderURI = "data:application/octet-stream;base64,AA==";
+
+	try {
+		glbFile = Tools::FileReader::MappedFile(filePath);
+	} catch (std::exception& ex) {
+		err = ex.what();
+		return false;
+	}
+	const auto bytes = glbFile.data();
+	const auto size = glbFile.size();
+
+	uint32_t header[5];
+	if (size < sizeof(header)) {
+		err = "Invalid glb file: " + filePath;
+		return false;
+	}
+	std::memcpy(header, bytes, sizeof(header));
+	const auto jsonLength = static_cast<size_t>(header[3]);
+	if (header[0] != glbMagic || header[1] != 2 || header[4] != chunkJSON || sizeof(header) + jsonLength > size) {
+		err = "Invalid glb header: " + filePath;
+		return false;
+	}
+	const auto jsonChunk = reinterpret_cast<const char*>(bytes + sizeof(header));
+
+	const unsigned char* binChunk = nullptr;
+	size_t binLength = 0;
+	const auto binOffs = sizeof(header) + jsonLength;
+	if (binOffs + 8 <= size) {
+		uint32_t chunk[2];
+		std::memcpy(chunk, bytes + binOffs, sizeof(chunk));
+		if (chunk[1] == chunkBIN) {
+			binChunk = bytes + binOffs + 8;
+			binLength = std::min(static_cast<size_t>(chunk[0]), size - binOffs - 8);
+		}
+	}
+
+	/*
+	 * tinygltf copies the BIN chunk and all embedded images into its own buffers,
+	 * so it only gets to see the json part with placeholders for anything stored in BIN
+	 */
+	auto json = nlohmann::json::parse(jsonChunk, jsonChunk + jsonLength, nullptr, false);
+	if (json.is_discarded() || !json.is_object()) {
+		err = "Invalid glb json chunk: " + filePath;
+		return false;
+	}
+	mappedBuffers.clear();
+	auto buffers = json.find("buffers");
+	if (buffers != json.end() && buffers->is_array() && !buffers->empty()) {
+		auto& binBuffer = (*buffers)[0];
+		if (binBuffer.find("uri") == binBuffer.end()) {
+			if (!binChunk) {
+				err = "glb file references missing BIN chunk: " + filePath;
+				return false;
 			}
+			const auto byteLength = binBuffer.value("byteLength", static_cast<size_t>(0));
+			mappedBuffers[0] = { binChunk, std::min(byteLength, binLength) };
+			binBuffer["uri"] = placeholderURI;
+			binBuffer["byteLength"] = 1;
+		}
+	}
+	std::vector<std::pair<int, int>> mappedImages;
+	auto images = json.find("images");
+	if (images != json.end() && images->is_array()) {
+		for (size_t i = 0; i < images->size(); ++i) {
+			auto& image = (*images)[i];
+			auto view = image.find("bufferView");
+			if (view != image.end() && view->is_number_integer()) {
+				mappedImages.emplace_back(static_cast<int>(i), view->get<int>());
+				image.erase(view);
+				image["uri"] = placeholderURI;
+			}
+		}
+	}
+	const auto patchedJson = json.dump();
+	json = nlohmann::json();
+
+	tinygltf::TinyGLTF loader;
+	loader.SetImageLoader(deferImageData, &encodedImages);
+	if (!loader.LoadASCIIFromString(&model, &err, &warn, patchedJson.c_str(), static_cast<unsigned int>(patchedJson.size()), baseDir)) {
+		return false;
+	}
+
+	// embedded images are decoded directly from the mapped file
+	for (const auto& [imageIndex, viewIndex] : mappedImages) {
+		if (viewIndex < 0 || static_cast<size_t>(viewIndex) >= model.bufferViews.size()) {
+			continue;
+		}
+		const auto& view = model.bufferViews[viewIndex];
+		size_t bufferSize = 0;
+		const auto buffer = bufferData(view.buffer, bufferSize);
+		if (!buffer || view.byteOffset + view.byteLength > bufferSize) {
+			warn += "Image " + std::to_string(imageIndex) + " exceeds its buffer\n";
+			continue;
+		}
+		encodedImages.push_back({ imageIndex, buffer + view.byteOffset, view.byteLength, {} });
+	}
+
+	return true;
+}
+
+void Import::glTFLoader::decodeImages(std::string& warn)
+{
+	std::mutex warnMutex;
+	workers.parallelFor(encodedImages.size(), [&](size_t i) {
+		auto& encoded = encodedImages[i];
+		const auto data = encoded.data ? encoded.data : encoded.owned.data();
+		int w, h, c;
+		auto pixels = stbi_load_from_memory(data, static_cast<int>(encoded.size), &w, &h, &c, STBI_rgb_alpha);
+		if (!pixels) {
+			std::lock_guard<std::mutex> lock(warnMutex);
+			warn += "Unable to decode image " + std::to_string(encoded.image) + "\n";
+			return;
+		}
+		// every image index is decoded at most once, so workers never share an image
+		auto& image = model.images[encoded.image];
+		image.width = w;
+		image.height = h;
+		image.component = 4;
+		image.image.assign(pixels, pixels + static_cast<size_t>(w) * h * 4);
+		stbi_image_free(pixels);
+	});
+	encodedImages.clear();
+}
+
+void Import::glTFLoader::decodeMeshes()
+{
+	// the activation only creates and uploads the meshes, the expensive processing runs here
+	struct PrimitiveRef {
+		size_t mesh;
+		size_t primitive;
+	};
+	std::vector<PrimitiveRef> refs;
+	decodedMeshes.assign(model.meshes.size(), {});
+	for (size_t m = 0; m < model.meshes.size(); ++m) {
+		decodedMeshes[m].resize(model.meshes[m].primitives.size());
+		for (size_t p = 0; p < model.meshes[m].primitives.size(); ++p) {
+			refs.push_back({ m, p });
 		}
+	}
+
+	// every primitive only writes its own pre-allocated entry
+	std::vector<MeshOptimizer::Report> reports(refs.size());
+	workers.parallelFor(refs.size(), [&](size_t i) {
+		auto& decoded = decodedMeshes[refs[i].mesh][refs[i].primitive];
+		decoded.valid = loadPrimitive(model.meshes[refs[i].mesh].primitives[refs[i].primitive], decoded.data);
+		if (!decoded.valid) {
+			return;
+		}
+		reports[i] = MeshOptimizer::optimize(decoded.data);
+		MeshSimplifier::generateLods(decoded.data);
+		MeshClusterizer::buildClusters(decoded.data);
 	});
+	optimizerReport = MeshOptimizer::Report();
+	for (const auto& report : reports) {
+		optimizerReport += report;
+	}
 }
 
-std::unique_ptr<Geometry::Scene> Import::glTFLoader::processGlTF()
+void Import::glTFLoader::processGlTF(SceneActivation& activation)
 {
 	levelLoadFuture.get();
-	auto scene = std::make_unique<Geometry::Scene>();
+	const auto scene = activation.getScene();
+
+	loadTextures(activation);
+	activation.push([this]() {
+		loadMaterials();
+		return false;
+	});
+
+	// the node hierarchy is created right away, its meshes are uploaded by the activation
+	const auto sceneIndex = model.defaultScene > -1 ? static_cast<size_t>(model.defaultScene) : 0;
+	if (sceneIndex < model.scenes.size()) {
+		for (const auto& n : model.scenes[sceneIndex].nodes) {
+			loadNode(scene->getRootNodePtr(), model.nodes[n], activation);
+		}
+	} else {
+		LOGSTDOUT("glTF file does not contain a scene!");
+	}
+	scene->setLights(std::move(lights));
+	lights.clear();
+
+	activation.push([this, scene]() {
+		LOGSTDOUT("Mesh optimization: " + optimizerReport.toString());
+
+		scene->textureCache = textureCache;
+		scene->materialCache = materialCache;
+
+		// all geometry and images live on the gpu now, drop the cpu side copy
+		model = tinygltf::Model();
+		mappedBuffers.clear();
+		glbFile.close();
+		textureLookup.clear();
+		colorTextures.clear();
+		gltfMaterials.clear();
+		uploadedMeshes.clear();
+		decodedMeshes.clear();
+		return false;
+	});
+}
+
+const unsigned char* Import::glTFLoader::bufferData(int bufferIndex, size_t& size) const
+{
+	const auto mapped = mappedBuffers.find(bufferIndex);
+	if (mapped != mappedBuffers.end()) {
+		size = mapped->second.size;
+		return mapped->second.data;
+	}
+	if (bufferIndex < 0 || static_cast<size_t>(bufferIndex) >= model.buffers.size()) {
+		return nullptr;
+	}
+	const auto& buffer = model.buffers[bufferIndex];
+	size = buffer.data.size();
+	return buffer.data.data();
+}
+
+const unsigned char* Import::glTFLoader::accessorData(const tinygltf::Accessor& accessor, size_t& stride) const
+{
+	if (accessor.bufferView < 0 || static_cast<size_t>(accessor.bufferView) >= model.bufferViews.size()) {
+		return nullptr;
+	}
+	const auto& view = model.bufferViews[accessor.bufferView];
+	const auto byteStride = accessor.ByteStride(view);
+	size_t bufferSize = 0;
+	const auto buffer = bufferData(view.buffer, bufferSize);
+	if (byteStride <= 0 || !buffer) {
+		return nullptr;
+	}
+	stride = static_cast<size_t>(byteStride);
+
+	const auto offset = view.byteOffset + accessor.byteOffset;
+	const auto elementSize = static_cast<size_t>(tinygltf::GetComponentSizeInBytes(accessor.componentType) * tinygltf::GetNumComponentsInType(accessor.type));
+	if (accessor.count == 0 || offset + stride * (accessor.count - 1) + elementSize > bufferSize) {
+		LOGSTDOUT("glTF accessor exceeds its buffer!");
+		return nullptr;
+	}
+	return buffer + offset;
+}
+
+std::shared_ptr<Texture> Import::glTFLoader::getTexture(int textureIndex, size_t typeID)
+{
+	if (textureIndex < 0 || static_cast<size_t>(textureIndex) >= model.textures.size()) {
+		return nullptr;
+	}
+	const auto key = (static_cast<uint64_t>(textureIndex) << 8) | typeID;
+	const auto cached = textureLookup.find(key);
+	if (cached != textureLookup.end()) {
+		return cached->second;
+	}
+
+	const auto& gltfTexture = model.textures[textureIndex];
+	if (gltfTexture.source < 0 || static_cast<size_t>(gltfTexture.source) >= model.images.size()) {
+		return nullptr;
+	}
+	const auto& image = model.images[gltfTexture.source];
+	const auto pixelCount = static_cast<size_t>(image.width) * static_cast<size_t>(image.height);
+	if (pixelCount == 0 || image.component <= 0 || image.image.size() < pixelCount * image.component) {
+		LOGSTDOUT("Skipping glTF image without pixel data: " + image.uri);
+		return nullptr;
+	}
+	const auto bytesPerComponent = image.image.size() / (pixelCount * image.component);
+
+	std::string id;
+	{
+		std::lock_guard<std::mutex> lock(dirMutex);
+		id = image.uri.empty() ? image.name : rootDirectory + image.uri;
+	}
+
+	// metallicRoughness textures store roughness in G and metallic in B, the shaders sample R
+	const int channel = typeID == TEX_TYPE_ROUGHNESS ? 1 : typeID == TEX_TYPE_METALLIC ? 2 : -1;
+
+	std::shared_ptr<Texture> tex;
+	if (image.component == 4 && bytesPerComponent == 1 && channel < 0) {
+		tex = std::make_shared<Texture>(const_cast<unsigned char*>(image.image.data()), image.width, image.height, 4, typeID, id);
+	} else {
+		std::vector<unsigned char> rgba(pixelCount * 4, 255);
+		for (size_t p = 0; p < pixelCount; ++p) {
+			for (int c = 0; c < 4; ++c) {
+				int src;
+				if (channel >= 0) {
+					src = c < 3 ? std::min(channel, image.component - 1) : -1;
+				} else if (c < 3) {
+					src = image.component >= 3 ? c : 0;
+				} else {
+					src = image.component == 4 ? 3 : image.component == 2 ? 1 : -1;
+				}
+				if (src >= 0) {
+					// 16 bit images: keep the most significant byte
+					rgba[p * 4 + c] = image.image[(p * image.component + src) * bytesPerComponent + bytesPerComponent - 1];
+				}
+			}
+		}
+		tex = std::make_shared<Texture>(rgba.data(), image.width, image.height, 4, typeID, id);
+	}
+	textureCache.push_back(tex);
+	textureLookup[key] = tex;
+
+	return tex;
+}
 
-	return scene;
+void Import::glTFLoader::loadTextures(SceneActivation& activation)
+{
+	activation.push([this]() {
+		textureCache.push_back(std::make_shared<Texture>("assets/materials/default/diff.png", TEX_TYPE_DIFFUSE));
+		textureCache.push_back(std::make_shared<Texture>("assets/materials/default/spec.png", TEX_TYPE_SPECULAR));
+		return false;
+	});
+
+	// one step per material, textures shared with earlier materials are already cached
+	for (size_t m = 0; m < model.materials.size(); ++m) {
+		activation.push([this, m]() {
+			const auto& mat = model.materials[m];
+			getTexture(textureIndex(mat.values, "baseColorTexture"), TEX_TYPE_DIFFUSE);
+			getTexture(textureIndex(mat.additionalValues, "normalTexture"), TEX_TYPE_NORMAL);
+			const auto metallicRoughness = textureIndex(mat.values, "metallicRoughnessTexture");
+			getTexture(metallicRoughness, TEX_TYPE_ROUGHNESS);
+			getTexture(metallicRoughness, TEX_TYPE_METALLIC);
+			return false;
+		});
+	}
 }
 
 void Import::glTFLoader::loadMaterials()
 {
+	// glTF exporters often emit one material per mesh, identical texture sets share one material
+	using TextureSet = std::array<std::shared_ptr<Texture>, LevelFormat::TextureSlots>;
+	std::unordered_map<TextureSet, std::shared_ptr<Material>, TextureSetHash> materialLookup;
+	const auto getMaterial = [&](const TextureSet& set) {
+		auto& material = materialLookup[set];
+		if (!material) {
+			std::vector<std::shared_ptr<Texture>> textures;
+			for (const auto& tex : set) {
+				if (tex) {
+					textures.push_back(tex);
+				}
+			}
+			material = std::make_shared<Material>(textures);
+			materialCache.push_back(material);
+		}
+		return material;
+	};
+
+	gltfMaterials.reserve(model.materials.size() + 1);
+	for (const auto& mat : model.materials) {
+		TextureSet textures;
+
+		auto diffuse = getTexture(textureIndex(mat.values, "baseColorTexture"), TEX_TYPE_DIFFUSE);
+		if (!diffuse) {
+			const auto factor = mat.values.find("baseColorFactor");
+			if (factor != mat.values.end()) {
+				const auto color = factor->second.ColorFactor();
+				unsigned char pixel[4];
+				uint32_t packed = 0;
+				for (int c = 0; c < 4; ++c) {
+					pixel[c] = static_cast<unsigned char>(std::round(std::min(std::max(color[c], 0.0), 1.0) * 255.0));
+					packed |= static_cast<uint32_t>(pixel[c]) << (c * 8);
+				}
+				auto& colorTex = colorTextures[packed];
+				if (!colorTex) {
+					colorTex = std::make_shared<Texture>(pixel, 1, 1, 4, TEX_TYPE_DIFFUSE, mat.name + "_baseColor");
+					textureCache.push_back(colorTex);
+				}
+				diffuse = colorTex;
+			} else {
+				diffuse = textureCache[0];
+			}
+		}
+		textures[TEX_TYPE_DIFFUSE] = diffuse;
+		// glTF has no specular maps, materials still need one bound
+		textures[TEX_TYPE_SPECULAR] = textureCache[1];
+
+		textures[TEX_TYPE_NORMAL] = getTexture(textureIndex(mat.additionalValues, "normalTexture"), TEX_TYPE_NORMAL);
+		const auto metallicRoughness = textureIndex(mat.values, "metallicRoughnessTexture");
+		auto roughness = getTexture(metallicRoughness, TEX_TYPE_ROUGHNESS);
+		auto metallic = getTexture(metallicRoughness, TEX_TYPE_METALLIC);
+		if (roughness && metallic) {
+			textures[TEX_TYPE_ROUGHNESS] = roughness;
+			textures[TEX_TYPE_METALLIC] = metallic;
+		}
+
+		gltfMaterials.push_back(getMaterial(textures));
+	}
+
+	// primitives without material
+	gltfMaterials.push_back(getMaterial({ textureCache[0], textureCache[1] }));
 }
-void Import::glTFLoader::loadTextures()
+
+bool Import::glTFLoader::loadPrimitive(const tinygltf::Primitive& primitive, Mesh::MeshData& data) const
 {
+	if (primitive.mode != TINYGLTF_MODE_TRIANGLES && primitive.mode != -1) {
+		LOGSTDOUT("Skipping glTF primitive with unsupported mode " + std::to_string(primitive.mode));
+		return false;
+	}
+
+	const auto posIt = primitive.attributes.find("POSITION");
+	if (posIt == primitive.attributes.end() || posIt->second < 0 || static_cast<size_t>(posIt->second) >= model.accessors.size()) {
+		return false;
+	}
+	const auto& posAcc = model.accessors[posIt->second];
+	size_t posStride = 0;
+	const auto posData = accessorData(posAcc, posStride);
+	if (!posData || posAcc.type != TINYGLTF_TYPE_VEC3 || posAcc.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT) {
+		LOGSTDOUT("Skipping glTF primitive with invalid positions");
+		return false;
+	}
+	const auto vertexCount = posAcc.count;
+	if (vertexCount == 0) {
+		return false;
+	}
+
+	const Vertex zero = { glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec2(0.0f) };
+	data.vertices.assign(vertexCount, zero);
+	auto vtxBase = reinterpret_cast<unsigned char*>(data.vertices.data());
+
+	streamAttribute(posData, posStride, posAcc, 3, vtxBase + offsetof(Vertex, position), sizeof(Vertex));
+
+	/*
+	 * returns the accessor data for a vertex attribute if it matches the position count
+	 */
+	auto attribute = [&](const std::string& name, const tinygltf::Accessor*& accessor, size_t& stride) -> const unsigned char* {
+		const auto it = primitive.attributes.find(name);
+		if (it == primitive.attributes.end() || it->second < 0 || static_cast<size_t>(it->second) >= model.accessors.size()) {
+			return nullptr;
+		}
+		accessor = &model.accessors[it->second];
+		if (accessor->count != vertexCount) {
+			return nullptr;
+		}
+		return accessorData(*accessor, stride);
+	};
+
+	const tinygltf::Accessor* normAcc = nullptr;
+	size_t normStride = 0;
+	const auto normData = attribute("NORMAL", normAcc, normStride);
+	if (normData) {
+		streamAttribute(normData, normStride, *normAcc, 3, vtxBase + offsetof(Vertex, normal), sizeof(Vertex));
+	}
+
+	const tinygltf::Accessor* uvAcc = nullptr;
+	size_t uvStride = 0;
+	const auto uvData = attribute("TEXCOORD_0", uvAcc, uvStride);
+	if (uvData) {
+		streamAttribute(uvData, uvStride, *uvAcc, 2, vtxBase + offsetof(Vertex, texCoord), sizeof(Vertex));
+	}
 
+	// indices
+	if (primitive.indices > -1) {
+		if (static_cast<size_t>(primitive.indices) >= model.accessors.size()) {
+			LOGSTDOUT("Skipping glTF primitive with invalid indices");
+			return false;
+		}
+		const auto& idxAcc = model.accessors[primitive.indices];
+		size_t idxStride = 0;
+		const auto idxData = accessorData(idxAcc, idxStride);
+		if (!idxData) {
+			LOGSTDOUT("Skipping glTF primitive with invalid indices");
+			return false;
+		}
+		data.indices.resize(idxAcc.count);
+		switch (idxAcc.componentType) {
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+			streamIndices<uint8_t>(idxData, idxStride, idxAcc.count, data.indices.data());
+			break;
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+			streamIndices<uint16_t>(idxData, idxStride, idxAcc.count, data.indices.data());
+			break;
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+			streamIndices<uint32_t>(idxData, idxStride, idxAcc.count, data.indices.data());
+			break;
+		default:
+			LOGSTDOUT("Index component type " + std::to_string(idxAcc.componentType) + " not supported!");
+			return false;
+		}
+		for (const auto& idx : data.indices) {
+			if (idx >= vertexCount) {
+				LOGSTDOUT("Skipping glTF primitive with out of range indices");
+				return false;
+			}
+		}
+	} else {
+		data.indices.resize(vertexCount);
+		std::iota(data.indices.begin(), data.indices.end(), 0u);
+	}
+	data.indices.resize(data.indices.size() - data.indices.size() % 3);
+
+	if (!normData) {
+		// no normals given: area weighted face normals
+		for (size_t i = 0; i < data.indices.size(); i += 3) {
+			auto& v0 = data.vertices[data.indices[i]];
+			auto& v1 = data.vertices[data.indices[i + 1]];
+			auto& v2 = data.vertices[data.indices[i + 2]];
+			const auto n = glm::cross(v1.position - v0.position, v2.position - v0.position);
+			v0.normal += n;
+			v1.normal += n;
+			v2.normal += n;
+		}
+		for (auto& v : data.vertices) {
+			const auto len = glm::length(v.normal);
+			v.normal = len > 0.0f ? v.normal / len : glm::vec3(0.0f, 1.0f, 0.0f);
+		}
+	}
+
+	const tinygltf::Accessor* tangAcc = nullptr;
+	size_t tangStride = 0;
+	const auto tangData = attribute("TANGENT", tangAcc, tangStride);
+	if (tangData && tangAcc->type == TINYGLTF_TYPE_VEC4 && tangAcc->componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+		// glTF tangents are vec4 with the bitangent sign in w
+		for (size_t i = 0; i < vertexCount; ++i) {
+			float t[4];
+			std::memcpy(t, tangData + i * tangStride, sizeof(t));
+			auto& v = data.vertices[i];
+			v.tangent = glm::vec3(t[0], t[1], t[2]);
+			v.bitangent = glm::cross(v.normal, v.tangent) * (t[3] < 0.0f ? -1.0f : 1.0f);
+		}
+	} else if (uvData) {
+		// derive tangent frame from the texture coordinates
+		for (size_t i = 0; i < data.indices.size(); i += 3) {
+			auto& v0 = data.vertices[data.indices[i]];
+			auto& v1 = data.vertices[data.indices[i + 1]];
+			auto& v2 = data.vertices[data.indices[i + 2]];
+			const auto e1 = v1.position - v0.position;
+			const auto e2 = v2.position - v0.position;
+			const auto duv1 = v1.texCoord - v0.texCoord;
+			const auto duv2 = v2.texCoord - v0.texCoord;
+			const auto det = duv1.x * duv2.y - duv2.x * duv1.y;
+			if (std::abs(det) < 1e-12f) {
+				continue;
+			}
+			const auto r = 1.0f / det;
+			const auto t = (e1 * duv2.y - e2 * duv1.y) * r;
+			const auto b = (e2 * duv1.x - e1 * duv2.x) * r;
+			v0.tangent += t;
+			v1.tangent += t;
+			v2.tangent += t;
+			v0.bitangent += b;
+			v1.bitangent += b;
+			v2.bitangent += b;
+		}
+		for (auto& v : data.vertices) {
+			auto t = v.tangent - v.normal * glm::dot(v.normal, v.tangent);
+			const auto len = glm::length(t);
+			if (len <= 0.0f) {
+				continue;
+			}
+			t /= len;
+			const auto sign = glm::dot(glm::cross(v.normal, t), v.bitangent) < 0.0f ? -1.0f : 1.0f;
+			v.tangent = t;
+			v.bitangent = glm::cross(v.normal, t) * sign;
+		}
+	}
+
+	if (uvData) {
+		// MRT.vert flips v for the bottom-left origin of the assimp formats, glTF uses top-left
+		for (auto& v : data.vertices) {
+			v.texCoord.y = 1.0f - v.texCoord.y;
+		}
+	}
+
+	data.boundingSphere = Bounds::computeSphere(&data.vertices[0].position, data.vertices.size(), sizeof(Vertex));
+
+	return !data.indices.empty();
 }
-void Import::glTFLoader::loadNode(std::shared_ptr<Geometry::Node> parent, const tinygltf::Node& node)
+
+void Import::glTFLoader::loadNode(std::shared_ptr<Geometry::Node> parent, const tinygltf::Node& node, SceneActivation& activation)
 {
 	glm::mat4 modelmat = glm::mat4(1.0f);
-	auto nodeParent = parent;
 	if (node.matrix.size() == 16) {
-		modelmat = glm::make_mat4x4(node.matrix.data());
+		modelmat = glm::mat4(glm::make_mat4x4(node.matrix.data()));
 	} else {
 		glm::vec3 pos = glm::vec3(0.0f);
 		if (node.translation.size() == 3) {
-			pos = glm::make_vec3(node.translation.data());
+			pos = glm::vec3(glm::make_vec3(node.translation.data()));
 		}
-		glm::mat3 rot = glm::mat3(1.0f);
+		glm::quat rot = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
 		if (node.rotation.size() == 4) {
-			glm::quat q = glm::make_quat(node.rotation.data());
-			rot = glm::mat3(q);
+			// glTF stores x, y, z, w
+			rot = glm::quat(static_cast<float>(node.rotation[3]), static_cast<float>(node.rotation[0]), static_cast<float>(node.rotation[1]), static_cast<float>(node.rotation[2]));
 		}
 		glm::vec3 scale = glm::vec3(1.0f);
 		if (node.scale.size() == 3) {
-			scale = glm::make_vec3(node.scale.data());
+			scale = glm::vec3(glm::make_vec3(node.scale.data()));
 		}
-		modelmat = glm::mat4(rot);
-		modelmat = glm::translate(modelmat, pos);
-		modelmat = glm::scale(modelmat, scale);
+		modelmat = glm::translate(glm::mat4(1.0f), pos) * glm::mat4_cast(rot) * glm::scale(glm::mat4(1.0f), scale);
 	}
-	if (node.mesh > -1) {
-		const auto mesh = model.meshes[node.mesh];
-		for (size_t i = 0; i < mesh.primitives.size(); ++i) {
-			const auto& primitive = mesh.primitives[i];
-			if (primitive.indices < 0) {
-				continue;
-			}
-
-			Mesh::MeshData data = {};
 
-			glm::vec3 minPos = {};
-			glm::vec3 maxPos = {};
+	auto sparkleNode = std::make_shared<Geometry::Node>(modelmat, parent);
+	parent->addChild(sparkleNode);
 
-			const float* bufferPos;
-			const float* bufferNorm;
-			const float* bufferUV;
-			const float* bufferTang;
-			const float* bufferBiTang;
-
-			assert(primitive.attributes.find("POSITION") != primitive.attributes.end()); // Position is required
-			const auto & posAcc = model.accessors[primitive.attributes.find("POSITION")->second];
-			const auto & posView = model.bufferViews[posAcc.bufferView];
-			bufferPos = reinterpret_cast<const float*>(&(model.buffers[posView.buffer].data[posAcc.byteOffset + posView.byteOffset]));
+	const auto lightExtension = node.extensions.find("KHR_lights_punctual");
+	if (lightExtension != node.extensions.end() && lightExtension->second.Has("light")) {
+		const auto& lightIndex = lightExtension->second.Get("light");
+		if (lightIndex.IsInt() && lightIndex.Get<int>() >= 0 && static_cast<size_t>(lightIndex.Get<int>()) < model.lights.size()) {
+			loadLight(sparkleNode, model.lights[lightIndex.Get<int>()]);
+		}
+	}
 
-			minPos = glm::vec3(posAcc.minValues[0], posAcc.minValues[1], posAcc.minValues[3]);
-			maxPos = glm::vec3(posAcc.maxValues[0], posAcc.maxValues[1], posAcc.maxValues[3]);
+	if (node.mesh > -1 && static_cast<size_t>(node.mesh) < model.meshes.size()) {
+		activation.push([this, sparkleNode, meshIndex = node.mesh]() {
+			loadMesh(sparkleNode, meshIndex);
+			return true;
+		});
+	}
 
-			if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
-				const tinygltf::Accessor& normAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
-				const tinygltf::BufferView& normView = model.bufferViews[normAccessor.bufferView];
-				bufferNorm = reinterpret_cast<const float*>(&(model.buffers[normView.buffer].data[normAccessor.byteOffset + normView.byteOffset]));
-			}
+	for (const auto& c : node.children) {
+		loadNode(sparkleNode, model.nodes[c], activation);
+	}
+}
 
-			if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
-				const tinygltf::Accessor& uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
-				const tinygltf::BufferView& uvView = model.bufferViews[uvAccessor.bufferView];
-				bufferUV = reinterpret_cast<const float*>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-			}
-			if (primitive.attributes.find("TANGENT") != primitive.attributes.end()) {
-				const tinygltf::Accessor& tangAccessor = model.accessors[primitive.attributes.find("TANGENT")->second];
-				const tinygltf::BufferView& tangView = model.bufferViews[tangAccessor.bufferView];
-				bufferNorm = reinterpret_cast<const float*>(&(model.buffers[tangView.buffer].data[tangAccessor.byteOffset + tangView.byteOffset]));
-			}
-			if (primitive.attributes.find("BITANGENT") != primitive.attributes.end()) {
-				const tinygltf::Accessor& biTangAccessor = model.accessors[primitive.attributes.find("BITANGENT")->second];
-				const tinygltf::BufferView& biTangView = model.bufferViews[biTangAccessor.bufferView];
-				bufferNorm = reinterpret_cast<const float*>(&(model.buffers[biTangView.buffer].data[biTangAccessor.byteOffset + biTangView.byteOffset]));
-			}
+void Import::glTFLoader::loadLight(const std::shared_ptr<Geometry::Node>& node, const tinygltf::Light& light)
+{
+	auto color = glm::vec3(1.0f);
+	if (light.color.size() == 3) {
+		color = glm::vec3(glm::make_vec3(light.color.data()));
+	}
+	color *= static_cast<float>(light.intensity);
 
-			for (auto v = 0u; v < posAcc.count; ++v) {
-				Vertex vtx;
-				vtx.position = glm::make_vec3(&bufferPos[v * 3]);
-				vtx.normal = glm::normalize(bufferNorm ? glm::make_vec3(&bufferNorm[v * 3]) : glm::vec3(0.0f));
-				vtx.texCoord = bufferUV ? glm::make_vec2(&bufferUV[v * 2]) : glm::vec2(0.0f);
-				vtx.tangent = bufferTang ? glm::make_vec3(&bufferTang[v * 3]) : glm::vec3(0.0f);
-				vtx.bitangent = bufferBiTang ? glm::make_vec3(&bufferBiTang[v * 3]) : glm::vec3(0.0f);
-				data.vertices.push_back(vtx);
-			}
+	// punctual lights sit at the origin of their node and shine along its -z axis
+	const auto world = node->accumModel();
+	if (light.type == "directional") {
+		lights.push_back(Lights::directionalLight(glm::vec3(world * glm::vec4(0.0f, 0.0f, -1.0f, 0.0f)), color));
+	} else if (light.type == "point" || light.type == "spot") { // the deferred pass has no cone, spot lights are lit like point lights
+		lights.push_back(Lights::pointLight(glm::vec3(world[3]), color, 1.0f));
+	} else {
+		LOGSTDOUT("Unsupported light type " + light.type + ", skipping");
+	}
+}
 
-			if (primitive.indices > -1) {
-				const auto& accessor = model.accessors[primitive.indices];
-				const auto& view = model.bufferViews[accessor.bufferView];
-				const auto& buffer = model.buffers[view.buffer];
-
-				const void* dataPtr = &(buffer.data[accessor.byteOffset + view.byteOffset]);
-
-				const uint32_t* ptr = nullptr;
-				switch (accessor.componentType) {
-				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-					ptr = static_cast<const uint32_t*>(dataPtr);
-					for (auto idx = 0u; idx < accessor.count; ++idx) {
-						data.indices.push_back(ptr[idx]);
-					}
-					break;
-				default:
-					LOGSTDOUT("Index component type " + std::to_string(accessor.componentType) + " not supported!");
-					return;
-					// todo: other types
-				}
-			}
-			else {
-				// todo?
-			}
+void Import::glTFLoader::loadMesh(std::shared_ptr<Geometry::Node> node, int meshIndex)
+{
+	// meshes referenced by several nodes are uploaded once and drawn as instances
+	const auto uploaded = uploadedMeshes.find(meshIndex);
+	if (uploaded != uploadedMeshes.end()) {
+		for (const auto& primitive : uploaded->second) {
+			node->addChild(std::make_shared<Mesh>(*primitive, node));
 		}
-	} else {
-		auto sparkleNode = std::make_shared<Geometry::Node>(modelmat, nodeParent);
-		nodeParent->addChild(sparkleNode);
-		nodeParent = sparkleNode;
+		return;
 	}
-	if (node.children.size() > 0) {
-		for (const auto& c : node.children) {
-			loadNode(nodeParent, model.nodes[c]);
+
+	auto& primitives = uploadedMeshes[meshIndex];
+	const auto& mesh = model.meshes[meshIndex];
+	auto& decoded = decodedMeshes[meshIndex];
+	for (size_t i = 0; i < mesh.primitives.size(); ++i) {
+		const auto& primitive = mesh.primitives[i];
+		if (!decoded[i].valid) {
+			continue;
 		}
+		auto data = std::move(decoded[i].data);
+		auto material = primitive.material > -1 && static_cast<size_t>(primitive.material) + 1 < gltfMaterials.size()
+		    ? gltfMaterials[primitive.material]
+		    : gltfMaterials.back();
+
+		auto sparkleMesh = std::make_shared<Mesh>(std::move(data), material, node);
+		if (!mesh.name.empty()) {
+			sparkleMesh->setName(mesh.name);
+		}
+		primitives.push_back(sparkleMesh);
+		node->addChild(std::static_pointer_cast<Node, Mesh>(sparkleMesh));
 	}
-}
\ No newline at end of file
+}
@@ -1,10 +1,20 @@
 #ifndef GLTF_LOADER_H
 #define GLTF_LOADER_H
 
+#include <atomic>
 #include <future>
+#include <map>
 #include <mutex>
+#include <unordered_map>
 
+#include "FileReader.h"
 #include "Geometry.h"
+#include "LevelData.h"
+#include "MeshClusterizer.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "SceneActivation.h"
+#include "ThreadPool.h"
 
 #include <tinygltf/tiny_gltf.h>
 
@@ -13,19 +23,97 @@ namespace Import {
 	class glTFLoader {
 	public:
 		void loadFromFile(std::string filePath);
-		std::unique_ptr<Geometry::Scene> processGlTF();
+		/**
+		 * queue the scene creation into activation, the loader has to outlive it
+		 */
+		void processGlTF(SceneActivation& activation);
+		/**
+		 * true once the file was read or reading failed, processGlTF rethrows the error of a failed read
+		 */
+		bool isLoaded() const { return loaded || failed; }
+
+		/**
+		 * encoded image collected while tinygltf parses, all images are decoded on the workers afterwards
+		 */
+		struct EncodedImage {
+			int image;
+			const unsigned char* data; // into the mapped file, nullptr if owned
+			size_t size;
+			std::vector<unsigned char> owned;
+		};
+
 	private:
+		std::atomic_bool loaded = false;
+		std::atomic_bool failed = false;
+
 		tinygltf::Model model;
 		std::string rootDirectory;
 
 		std::mutex dirMutex;
 		std::future<void> levelLoadFuture;
 
+		/**
+		 * .glb files are mapped instead of read, the BIN chunk is referenced in place
+		 * and has to stay mapped until all geometry is uploaded
+		 */
+		Tools::FileReader::MappedFile glbFile;
+		struct MappedRange {
+			const unsigned char* data;
+			size_t size;
+		};
+		std::map<int, MappedRange> mappedBuffers;
+
+		std::vector<EncodedImage> encodedImages;
+		Tools::ThreadPool workers;
+
+		std::vector<std::shared_ptr<Texture>> textureCache;
+		std::vector<std::shared_ptr<Material>> materialCache;
+		/**
+		 * gpu textures keyed by glTF texture index and TEX_TYPE_* they are used as
+		 * the same image can be referenced with different meanings (e.g. metallicRoughness)
+		 */
+		std::unordered_map<uint64_t, std::shared_ptr<Texture>> textureLookup;
+		/**
+		 * 1x1 textures for materials without base color texture keyed by their packed RGBA8 color
+		 */
+		std::unordered_map<uint32_t, std::shared_ptr<Texture>> colorTextures;
+		/**
+		 * materials indexed by glTF material index, last entry is the default material
+		 */
+		std::vector<std::shared_ptr<Material>> gltfMaterials;
+		/**
+		 * uploaded primitives by glTF mesh index, further nodes using the mesh create instances
+		 */
+		std::unordered_map<int, std::vector<std::shared_ptr<Geometry::Mesh>>> uploadedMeshes;
+		/**
+		 * primitive geometry with lods and clusters built on the workers, by glTF mesh and primitive index
+		 */
+		struct DecodedPrimitive {
+			Geometry::Mesh::MeshData data;
+			bool valid = false;
+		};
+		std::vector<std::vector<DecodedPrimitive>> decodedMeshes;
+		/**
+		 * KHR_lights_punctual lights in world space, collected while the nodes are created
+		 */
+		std::vector<Lights::Light> lights;
+		MeshOptimizer::Report optimizerReport;
+
+		bool loadBinaryMapped(const std::string& filePath, const std::string& baseDir, std::string& err, std::string& warn);
+		void decodeImages(std::string& warn);
+		void decodeMeshes();
+		const unsigned char* bufferData(int bufferIndex, size_t& size) const;
+		const unsigned char* accessorData(const tinygltf::Accessor& accessor, size_t& stride) const;
+
 		void loadMaterials();
-		void loadTextures();
-		void loadNode(std::shared_ptr<Geometry::Node> parent, const tinygltf::Node& node);
+		void loadTextures(SceneActivation& activation);
+		std::shared_ptr<Texture> getTexture(int textureIndex, size_t typeID);
+		void loadNode(std::shared_ptr<Geometry::Node> parent, const tinygltf::Node& node, SceneActivation& activation);
+		void loadMesh(std::shared_ptr<Geometry::Node> node, int meshIndex);
+		void loadLight(const std::shared_ptr<Geometry::Node>& node, const tinygltf::Light& light);
+		bool loadPrimitive(const tinygltf::Primitive& primitive, Geometry::Mesh::MeshData& data) const;
 	};
-} // namespace Utils
+} // namespace Import
 } // namespace Sparkle
 
-#endif
\ No newline at end of file
+#endif
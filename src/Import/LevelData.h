@@ -0,0 +1,71 @@
+#ifndef LEVEL_DATA_H
+#define LEVEL_DATA_H
+
+#include <array>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Geometry.h"
+#include "LevelFormat.h"
+#include "Lights.h"
+
+namespace Sparkle {
+namespace Import {
+	/**
+	 * hash for per slot texture sets, identical sets share one material
+	 */
+	struct TextureSetHash {
+		template <typename T>
+		size_t operator()(const std::array<T, LevelFormat::TextureSlots>& textures) const
+		{
+			size_t seed = 0;
+			for (const auto& t : textures) {
+				seed ^= std::hash<T>()(t) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+			}
+			return seed;
+		}
+	};
+
+	/**
+	 * CPU side description of a level, produced by the converters without touching the GPU.
+	 * It is either written to a cooked level or turned into a Geometry::Scene at runtime.
+	 */
+	struct LevelData {
+		struct TextureEntry {
+			std::string path; // relative to the level directory
+			uint32_t type; // TEX_TYPE_*
+			std::vector<unsigned char> embedded; // encoded image file for textures stored inside the source scene
+			std::string embeddedExtension;
+		};
+
+		struct MaterialEntry {
+			std::string name;
+			std::array<uint32_t, LevelFormat::TextureSlots> textures; // index into textures per TEX_TYPE_* or InvalidIndex
+		};
+
+		struct MeshEntry {
+			std::string name;
+			uint32_t material; // index into materials or InvalidIndex
+			Geometry::Mesh::MeshData data;
+		};
+
+		/**
+		 * nodes are stored parents first, meshes are referenced by index so they can be shared by multiple nodes
+		 */
+		struct NodeEntry {
+			glm::mat4 model;
+			uint32_t parent; // index into nodes or InvalidIndex for children of the scene root
+			std::vector<uint32_t> meshes;
+		};
+
+		std::vector<TextureEntry> textures;
+		std::vector<MaterialEntry> materials;
+		std::vector<MeshEntry> meshes;
+		std::vector<NodeEntry> nodes;
+		std::vector<Lights::Light> lights; // transformed to world space by their nodes
+	};
+} // namespace Import
+} // namespace Sparkle
+
+#endif
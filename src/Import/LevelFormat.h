@@ -0,0 +1,125 @@
+/*
+*   LevelFormat.h
+*
+*   Binary layout of cooked Sparkle levels (.spkl)
+*   All sections are stored at 16 byte aligned offsets so the file can be mapped and read in place.
+*   Vertex and index blobs are stored in the exact layout they are uploaded with.
+*
+*   This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace Sparkle {
+namespace Import {
+	namespace LevelFormat {
+		constexpr uint32_t Magic = 0x4C4B5053; // "SPKL"
+		constexpr uint32_t Version = 4;
+		constexpr uint32_t InvalidIndex = 0xFFFFFFFF;
+		constexpr uint64_t SectionAlignment = 16;
+		/**
+		 * one texture slot per TEX_TYPE_*
+		 */
+		constexpr uint32_t TextureSlots = 5;
+
+		struct Section {
+			uint64_t offset;
+			uint64_t count;
+		};
+
+		struct Header {
+			uint32_t magic;
+			uint32_t version;
+			uint32_t vertexSize; // sizeof(Geometry::Vertex) the level was cooked with
+			uint32_t reserved;
+			Section strings; // zero terminated strings, count in bytes
+			Section textures; // TextureRecord
+			Section materials; // MaterialRecord
+			Section nodes; // NodeRecord
+			Section meshes; // MeshRecord
+			Section vertices; // Geometry::Vertex
+			Section indices; // uint32_t, relative to the first vertex of their mesh
+			Section lods; // LodRecord
+			Section clusters; // ClusterRecord
+			Section lights; // LightRecord
+		};
+
+		struct TextureRecord {
+			uint32_t path; // offset into strings, relative to the level directory
+			uint32_t type; // TEX_TYPE_*
+		};
+
+		struct MaterialRecord {
+			uint32_t textures[TextureSlots]; // texture index per TEX_TYPE_* or InvalidIndex
+			uint32_t reserved;
+		};
+
+		/**
+		 * nodes are stored parents first, parent is InvalidIndex for children of the scene root
+		 */
+		struct NodeRecord {
+			float model[16];
+			uint32_t parent;
+			uint32_t reserved;
+		};
+
+		/**
+		 * index range of one level of detail, relative to the first index of its mesh
+		 */
+		struct LodRecord {
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			float error; // object space deviation from lod 0
+			uint32_t reserved;
+		};
+
+		/**
+		 * triangles of lod 0 culled as one unit, see Geometry::Mesh::Cluster
+		 */
+		struct ClusterRecord {
+			uint32_t firstIndex; // relative to the first index of its mesh
+			uint32_t indexCount;
+			float boundingSphere[4]; // center xyz, radius
+			float cone[4]; // axis xyz, cutoff
+		};
+
+		/**
+		 * world space light, see Lights::Light
+		 */
+		struct LightRecord {
+			float vec[4]; // position with w = 1 or direction towards the light with w = 0
+			float color[4];
+			float radius;
+			uint32_t type; // Lights::LTypeFlags
+			uint32_t reserved[2];
+		};
+
+		struct MeshRecord {
+			uint64_t firstVertex;
+			uint64_t firstIndex;
+			uint32_t vertexCount;
+			uint32_t indexCount; // all lods
+			float boundingSphere[4]; // center xyz, radius
+			uint32_t node; // NodeRecord the mesh is attached to or InvalidIndex
+			uint32_t material; // MaterialRecord or InvalidIndex
+			uint32_t name; // offset into strings
+			uint32_t lodCount;
+			uint64_t firstLod; // LodRecord of lod 0, records sharing geometry share their lods
+			uint64_t firstCluster; // ClusterRecord, shared like the lods
+			uint32_t clusterCount; // 0 if lod 0 is not split
+			uint32_t reserved;
+		};
+
+		static_assert(sizeof(Header) == 176, "Level header layout changed");
+		static_assert(sizeof(TextureRecord) == 8, "Texture record layout changed");
+		static_assert(sizeof(MaterialRecord) == 24, "Material record layout changed");
+		static_assert(sizeof(NodeRecord) == 72, "Node record layout changed");
+		static_assert(sizeof(LodRecord) == 16, "Lod record layout changed");
+		static_assert(sizeof(ClusterRecord) == 40, "Cluster record layout changed");
+		static_assert(sizeof(MeshRecord) == 80, "Mesh record layout changed");
+		static_assert(sizeof(LightRecord) == 48, "Light record layout changed");
+	} // namespace LevelFormat
+} // namespace Import
+} // namespace Sparkle
@@ -0,0 +1,340 @@
+#include "LevelLoader.h"
+#include "LevelData.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "TextureCompression.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+using namespace Sparkle;
+using namespace Geometry;
+
+template <typename T>
+static bool sectionInFile(const Import::LevelFormat::Section& s, size_t fileSize)
+{
+	if (s.count == 0) {
+		return true;
+	}
+	if (s.offset % alignof(T) != 0 || s.offset > fileSize) {
+		return false;
+	}
+	return s.count <= (fileSize - s.offset) / sizeof(T);
+}
+
+void Import::LevelLoader::loadFromFile(const std::string& fileName, bool compressTextures)
+{
+	levelLoadFuture = std::async(std::launch::async, [this, fileName, compressTextures]() {
+		try {
+			levelFile = Tools::FileReader::MappedFile(fileName);
+		} catch (std::exception& ex) {
+			failed = true;
+			throw std::runtime_error("Unable to load level from " + fileName + ": " + ex.what());
+		}
+
+		std::string err;
+		if (!validate(err)) {
+			levelFile.close();
+			failed = true;
+			throw std::runtime_error("Unable to load level from " + fileName + ": " + err);
+		}
+
+		auto dirOffs = fileName.rfind('/');
+		dirOffs = dirOffs == std::string::npos ? fileName.rfind('\\') : dirOffs;
+		std::string root;
+		{
+			std::lock_guard<std::mutex> lock(dirMutex);
+			if (dirOffs != std::string::npos) {
+				rootDirectory = fileName.substr(0, dirOffs) + "/";
+			} else {
+				rootDirectory = "assets/";
+			}
+			root = rootDirectory;
+		}
+
+		const auto textureRecords = section<LevelFormat::TextureRecord>(header.textures);
+		images.resize(header.textures.count);
+		workers.parallelFor(images.size(), [&](size_t i) {
+			try {
+				const auto path = root + string(textureRecords[i].path);
+				images[i] = compressTextures ? Tools::TextureCompression::load(path, textureRecords[i].type, workers) : Tools::FileReader::loadImage(path);
+			} catch (std::exception& ex) {
+				LOGSTDOUT(ex.what());
+			}
+		});
+		loaded = true;
+	});
+}
+
+bool Import::LevelLoader::validate(std::string& err)
+{
+	using namespace LevelFormat;
+
+	const auto size = levelFile.size();
+	if (size < sizeof(Header)) {
+		err = "file too small";
+		return false;
+	}
+	std::memcpy(&header, levelFile.data(), sizeof(Header));
+	if (header.magic != Magic) {
+		err = "not a sparkle level";
+		return false;
+	}
+	if (header.version != Version) {
+		err = "level version " + std::to_string(header.version) + " does not match " + std::to_string(Version) + ", please re-cook";
+		return false;
+	}
+	if (header.vertexSize != sizeof(Vertex)) {
+		err = "vertex layout mismatch, please re-cook";
+		return false;
+	}
+	if (!sectionInFile<char>(header.strings, size) || !sectionInFile<TextureRecord>(header.textures, size)
+	    || !sectionInFile<MaterialRecord>(header.materials, size) || !sectionInFile<NodeRecord>(header.nodes, size)
+	    || !sectionInFile<MeshRecord>(header.meshes, size) || !sectionInFile<Vertex>(header.vertices, size)
+	    || !sectionInFile<uint32_t>(header.indices, size) || !sectionInFile<LodRecord>(header.lods, size)
+	    || !sectionInFile<ClusterRecord>(header.clusters, size) || !sectionInFile<LightRecord>(header.lights, size)) {
+		err = "section out of bounds";
+		return false;
+	}
+	if (header.strings.count > 0 && section<char>(header.strings)[header.strings.count - 1] != '\0') {
+		err = "unterminated string table";
+		return false;
+	}
+
+	const auto textures = section<TextureRecord>(header.textures);
+	for (uint64_t i = 0; i < header.textures.count; ++i) {
+		if (textures[i].path >= header.strings.count || textures[i].type >= TextureSlots) {
+			err = "invalid texture record";
+			return false;
+		}
+	}
+	const auto materials = section<MaterialRecord>(header.materials);
+	for (uint64_t i = 0; i < header.materials.count; ++i) {
+		for (const auto& t : materials[i].textures) {
+			if (t != InvalidIndex && t >= header.textures.count) {
+				err = "invalid material record";
+				return false;
+			}
+		}
+	}
+	const auto nodes = section<NodeRecord>(header.nodes);
+	for (uint64_t i = 0; i < header.nodes.count; ++i) {
+		if (nodes[i].parent != InvalidIndex && nodes[i].parent >= i) {
+			err = "invalid node hierarchy";
+			return false;
+		}
+	}
+	const auto meshes = section<MeshRecord>(header.meshes);
+	const auto lods = section<LodRecord>(header.lods);
+	const auto clusters = section<ClusterRecord>(header.clusters);
+	for (uint64_t i = 0; i < header.meshes.count; ++i) {
+		const auto& m = meshes[i];
+		if (m.firstVertex + m.vertexCount > header.vertices.count || m.firstIndex + m.indexCount > header.indices.count
+		    || (m.node != InvalidIndex && m.node >= header.nodes.count)
+		    || (m.material != InvalidIndex && m.material >= header.materials.count)
+		    || m.name >= std::max<uint64_t>(header.strings.count, 1)
+		    || m.lodCount == 0 || m.lodCount > Mesh::MaxLods || m.lodCount > header.lods.count || m.firstLod > header.lods.count - m.lodCount
+		    || m.clusterCount > header.clusters.count || m.firstCluster > header.clusters.count - m.clusterCount) {
+			err = "invalid mesh record";
+			return false;
+		}
+		for (uint64_t l = m.firstLod; l < m.firstLod + m.lodCount; ++l) {
+			if (static_cast<uint64_t>(lods[l].firstIndex) + lods[l].indexCount > m.indexCount) {
+				err = "invalid lod record";
+				return false;
+			}
+		}
+		for (uint64_t c = m.firstCluster; c < m.firstCluster + m.clusterCount; ++c) {
+			if (static_cast<uint64_t>(clusters[c].firstIndex) + clusters[c].indexCount > lods[m.firstLod].indexCount) {
+				err = "invalid cluster record";
+				return false;
+			}
+		}
+		// indices are relative to the first vertex of their mesh and read by the gpu unchecked
+		const auto indices = section<uint32_t>(header.indices) + m.firstIndex;
+		for (uint32_t idx = 0; idx < m.indexCount; ++idx) {
+			if (indices[idx] >= m.vertexCount) {
+				err = "index out of range in mesh " + std::to_string(i);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+const char* Import::LevelLoader::string(uint32_t offset) const
+{
+	if (offset >= header.strings.count) {
+		return "";
+	}
+	return section<char>(header.strings) + offset;
+}
+
+void Import::LevelLoader::processLevel(SceneActivation& activation)
+{
+	using namespace LevelFormat;
+	using TextureSet = std::array<uint32_t, TextureSlots>;
+
+	levelLoadFuture.get();
+
+	std::string root;
+	{
+		std::lock_guard<std::mutex> lock(dirMutex);
+		root = rootDirectory;
+	}
+
+	// resources created by earlier steps and looked up by later ones
+	struct State {
+		std::shared_ptr<Texture> defaultDiffuse;
+		std::shared_ptr<Texture> defaultSpecular;
+		std::vector<std::shared_ptr<Texture>> textures;
+		std::unordered_map<TextureSet, std::shared_ptr<Material>, TextureSetHash> materialLookup;
+		std::vector<std::shared_ptr<Material>> materials;
+		std::vector<std::shared_ptr<Node>> nodes;
+		// the writer stores geometry once per source mesh, records pointing at the same ranges become instances
+		std::map<std::tuple<uint64_t, uint64_t, uint32_t>, std::shared_ptr<Mesh>> uploaded;
+	};
+	const auto state = std::make_shared<State>();
+	state->textures.resize(header.textures.count);
+	state->materials.resize(header.materials.count);
+	state->nodes.resize(header.nodes.count);
+	const auto scene = activation.getScene();
+
+	activation.push([state, scene]() {
+		state->defaultDiffuse = std::make_shared<Texture>("assets/materials/default/diff.png", TEX_TYPE_DIFFUSE);
+		state->defaultSpecular = std::make_shared<Texture>("assets/materials/default/spec.png", TEX_TYPE_SPECULAR);
+		scene->textureCache.push_back(state->defaultDiffuse);
+		scene->textureCache.push_back(state->defaultSpecular);
+		return false;
+	});
+
+	activation.push([this, scene]() {
+		const auto records = section<LightRecord>(header.lights);
+		std::vector<Lights::Light> lights;
+		lights.reserve(header.lights.count);
+		for (uint64_t i = 0; i < header.lights.count; ++i) {
+			Lights::Light light = {};
+			light.mVec = glm::make_vec4(records[i].vec);
+			light.mColor = glm::make_vec4(records[i].color);
+			light.mRadius = records[i].radius;
+			lights.push_back(light);
+		}
+		scene->setLights(std::move(lights));
+		return false;
+	});
+
+	for (size_t i = 0; i < state->textures.size(); ++i) {
+		if (i >= images.size() || !images[i].imageData) {
+			continue;
+		}
+		activation.push([this, root, state, scene, i]() {
+			const auto& rec = section<TextureRecord>(header.textures)[i];
+			try {
+				state->textures[i] = std::make_shared<Texture>(images[i], rec.type, root + string(rec.path));
+				scene->textureCache.push_back(state->textures[i]);
+			} catch (std::exception& ex) {
+				LOGSTDOUT(ex.what());
+			}
+			images[i].free();
+			return false;
+		});
+	}
+
+	// records with the same texture set share one material and descriptor pool
+	const auto getMaterial = [state, scene](TextureSet set) {
+		for (auto& idx : set) {
+			if (idx != InvalidIndex && (idx >= state->textures.size() || !state->textures[idx])) {
+				idx = InvalidIndex;
+			}
+		}
+		auto& material = state->materialLookup[set];
+		if (!material) {
+			std::vector<std::shared_ptr<Texture>> matTextures;
+			for (uint32_t t = 0; t < TextureSlots; ++t) {
+				if (set[t] != InvalidIndex) {
+					matTextures.push_back(state->textures[set[t]]);
+				} else if (t == TEX_TYPE_DIFFUSE) {
+					matTextures.push_back(state->defaultDiffuse);
+				} else if (t == TEX_TYPE_SPECULAR) {
+					matTextures.push_back(state->defaultSpecular);
+				}
+			}
+			material = std::make_shared<Material>(matTextures);
+			scene->materialCache.push_back(material);
+		}
+		return material;
+	};
+
+	for (size_t i = 0; i < state->materials.size(); ++i) {
+		activation.push([this, state, getMaterial, i]() {
+			const auto& rec = section<MaterialRecord>(header.materials)[i];
+			TextureSet set;
+			std::copy(std::begin(rec.textures), std::end(rec.textures), set.begin());
+			state->materials[i] = getMaterial(set);
+			return false;
+		});
+	}
+
+	activation.push([this, state, scene]() {
+		const auto nodeRecords = section<NodeRecord>(header.nodes);
+		for (size_t i = 0; i < state->nodes.size(); ++i) {
+			auto parent = nodeRecords[i].parent == InvalidIndex ? scene->getRootNodePtr() : state->nodes[nodeRecords[i].parent];
+			state->nodes[i] = std::make_shared<Node>(glm::make_mat4(nodeRecords[i].model), parent);
+			parent->addChild(state->nodes[i]);
+		}
+		return false;
+	});
+
+	// one upload per step, meshes become visible as soon as they are attached
+	for (uint64_t i = 0; i < header.meshes.count; ++i) {
+		activation.push([this, state, scene, getMaterial, i]() {
+			const auto& rec = section<MeshRecord>(header.meshes)[i];
+			const auto lodRecords = section<LodRecord>(header.lods);
+			const auto clusterRecords = section<ClusterRecord>(header.clusters);
+			auto parent = rec.node == InvalidIndex ? scene->getRootNodePtr() : state->nodes[rec.node];
+			auto& geometry = state->uploaded[std::make_tuple(rec.firstVertex, rec.firstIndex, rec.material)];
+			if (geometry && geometry->size() == lodRecords[rec.firstLod].indexCount) {
+				parent->addChild(std::make_shared<Mesh>(*geometry, parent));
+				return true;
+			}
+			TextureSet defaultSet;
+			defaultSet.fill(InvalidIndex);
+			const auto material = rec.material != InvalidIndex ? state->materials[rec.material] : getMaterial(defaultSet);
+			const BoundingSphere bounds = {
+				glm::make_vec3(rec.boundingSphere),
+				rec.boundingSphere[3]
+			};
+			std::vector<Mesh::Lod> lods;
+			for (uint64_t l = rec.firstLod; l < rec.firstLod + rec.lodCount; ++l) {
+				lods.push_back({ lodRecords[l].firstIndex, lodRecords[l].indexCount, lodRecords[l].error });
+			}
+			std::vector<Mesh::Cluster> clusters;
+			clusters.reserve(rec.clusterCount);
+			for (uint64_t c = rec.firstCluster; c < rec.firstCluster + rec.clusterCount; ++c) {
+				const auto& cluster = clusterRecords[c];
+				clusters.push_back({ cluster.firstIndex, cluster.indexCount, { glm::make_vec3(cluster.boundingSphere), cluster.boundingSphere[3] }, glm::make_vec4(cluster.cone) });
+			}
+			const auto vertices = section<Vertex>(header.vertices);
+			const auto indices = section<uint32_t>(header.indices);
+			auto mesh = std::make_shared<Mesh>(vertices + rec.firstVertex, rec.vertexCount, indices + rec.firstIndex, rec.indexCount, std::move(lods), std::move(clusters), bounds, material, parent);
+			const auto name = string(rec.name);
+			if (*name != '\0') {
+				mesh->setName(name);
+			}
+			geometry = mesh;
+			parent->addChild(std::static_pointer_cast<Node, Mesh>(mesh));
+			return true;
+		});
+	}
+
+	activation.push([this]() {
+		images.clear();
+		levelFile.close();
+		return false;
+	});
+}
@@ -0,0 +1,63 @@
+#ifndef LEVEL_LOADER_H
+#define LEVEL_LOADER_H
+
+#include <atomic>
+#include <future>
+#include <mutex>
+
+#include "FileReader.h"
+#include "Geometry.h"
+#include "LevelFormat.h"
+#include "SceneActivation.h"
+#include "ThreadPool.h"
+
+namespace Sparkle {
+namespace Import {
+	/**
+	 * loader for cooked .spkl levels, the file is mapped and vertex/index data is uploaded directly from the mapping
+	 */
+	class LevelLoader {
+	public:
+		/**
+		 * \param compressTextures block compress the textures of the level, see TextureCompression::load
+		 */
+		void loadFromFile(const std::string& fileName, bool compressTextures = true);
+		/**
+		 * queue the scene creation into activation, the loader has to outlive it
+		 */
+		void processLevel(SceneActivation& activation);
+		/**
+		 * true once the level was mapped or mapping it failed, processLevel rethrows the error of a failed load
+		 */
+		bool isLoaded() const { return loaded || failed; }
+
+	private:
+		std::atomic_bool loaded = false;
+		std::atomic_bool failed = false;
+
+		std::future<void> levelLoadFuture;
+		Tools::FileReader::MappedFile levelFile;
+		LevelFormat::Header header;
+
+		/**
+		 * textures are decoded on these workers while the level loads, one image per texture record
+		 */
+		Tools::ThreadPool workers;
+		std::vector<Tools::FileReader::ImageFile> images;
+
+		std::mutex dirMutex;
+		std::string rootDirectory;
+
+		template <typename T>
+		const T* section(const LevelFormat::Section& s) const
+		{
+			return reinterpret_cast<const T*>(levelFile.data() + s.offset);
+		}
+		const char* string(uint32_t offset) const;
+
+		bool validate(std::string& err);
+	};
+} // namespace Import
+} // namespace Sparkle
+
+#endif
@@ -0,0 +1,206 @@
+#include "LevelWriter.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+using namespace Sparkle;
+using namespace Import;
+
+static uint64_t alignSection(uint64_t offset)
+{
+	return (offset + LevelFormat::SectionAlignment - 1) & ~(LevelFormat::SectionAlignment - 1);
+}
+
+/*
+ * places a section of count elements of type T at the next aligned offset
+ */
+template <typename T>
+static LevelFormat::Section placeSection(uint64_t& offset, size_t count)
+{
+	const LevelFormat::Section s = { offset, static_cast<uint64_t>(count) };
+	offset = alignSection(offset + count * sizeof(T));
+	return s;
+}
+
+static void seekSection(std::ofstream& file, const LevelFormat::Section& s)
+{
+	static const char padding[LevelFormat::SectionAlignment] = {};
+	const auto pos = static_cast<uint64_t>(file.tellp());
+	if (pos < s.offset) {
+		file.write(padding, static_cast<std::streamsize>(s.offset - pos));
+	}
+}
+
+void LevelWriter::write(const LevelData& level, const std::string& fileName)
+{
+	using namespace LevelFormat;
+
+	const auto dirOffs = fileName.find_last_of("/\\");
+	const auto directory = dirOffs == std::string::npos ? std::string() : fileName.substr(0, dirOffs + 1);
+	auto stem = dirOffs == std::string::npos ? fileName : fileName.substr(dirOffs + 1);
+	stem = stem.substr(0, stem.rfind('.'));
+
+	std::string strings(1, '\0'); // offset 0 is the empty string
+	const auto addString = [&strings](const std::string& s) -> uint32_t {
+		if (s.empty()) {
+			return 0;
+		}
+		const auto offset = static_cast<uint32_t>(strings.size());
+		strings += s;
+		strings.push_back('\0');
+		return offset;
+	};
+
+	std::vector<TextureRecord> textures;
+	textures.reserve(level.textures.size());
+	for (size_t i = 0; i < level.textures.size(); ++i) {
+		const auto& tex = level.textures[i];
+		auto path = tex.path;
+		if (!tex.embedded.empty()) {
+			path = stem + "_embedded" + std::to_string(i) + "." + (tex.embeddedExtension.empty() ? "bin" : tex.embeddedExtension);
+			std::ofstream image(directory + path, std::ios::binary | std::ios::trunc);
+			image.write(reinterpret_cast<const char*>(tex.embedded.data()), static_cast<std::streamsize>(tex.embedded.size()));
+			if (!image) {
+				throw std::runtime_error("Failed to write embedded texture: " + directory + path);
+			}
+		}
+		textures.push_back({ addString(path), tex.type });
+	}
+
+	std::vector<MaterialRecord> materials;
+	materials.reserve(level.materials.size());
+	for (const auto& mat : level.materials) {
+		MaterialRecord rec = {};
+		std::copy(mat.textures.begin(), mat.textures.end(), rec.textures);
+		materials.push_back(rec);
+	}
+
+	// geometry is stored once per mesh, every node referencing it gets its own record
+	std::vector<uint64_t> firstVertex(level.meshes.size());
+	std::vector<uint64_t> firstIndex(level.meshes.size());
+	std::vector<uint64_t> firstLod(level.meshes.size());
+	std::vector<uint64_t> firstCluster(level.meshes.size());
+	std::vector<LodRecord> lods;
+	std::vector<ClusterRecord> clusters;
+	size_t vertexCount = 0;
+	size_t indexCount = 0;
+	for (size_t i = 0; i < level.meshes.size(); ++i) {
+		const auto& data = level.meshes[i].data;
+		firstVertex[i] = vertexCount;
+		firstIndex[i] = indexCount;
+		firstLod[i] = lods.size();
+		firstCluster[i] = clusters.size();
+		vertexCount += data.vertices.size();
+		indexCount += data.indices.size();
+		if (data.lods.empty()) {
+			lods.push_back({ 0, static_cast<uint32_t>(data.indices.size()), 0.0f, 0 });
+		}
+		for (const auto& lod : data.lods) {
+			lods.push_back({ lod.firstIndex, lod.indexCount, lod.error, 0 });
+		}
+		for (const auto& cluster : data.clusters) {
+			const auto& sphere = cluster.boundingSphere;
+			clusters.push_back({ cluster.firstIndex, cluster.indexCount, { sphere.center.x, sphere.center.y, sphere.center.z, sphere.radius }, { cluster.cone.x, cluster.cone.y, cluster.cone.z, cluster.cone.w } });
+		}
+	}
+
+	std::vector<NodeRecord> nodes;
+	std::vector<MeshRecord> meshes;
+	nodes.reserve(level.nodes.size());
+	for (size_t n = 0; n < level.nodes.size(); ++n) {
+		const auto& node = level.nodes[n];
+		NodeRecord rec = {};
+		std::memcpy(rec.model, glm::value_ptr(node.model), sizeof(rec.model));
+		rec.parent = node.parent;
+		nodes.push_back(rec);
+
+		for (const auto& m : node.meshes) {
+			const auto& mesh = level.meshes[m];
+			MeshRecord meshRec = {};
+			meshRec.firstVertex = firstVertex[m];
+			meshRec.firstIndex = firstIndex[m];
+			meshRec.vertexCount = static_cast<uint32_t>(mesh.data.vertices.size());
+			meshRec.indexCount = static_cast<uint32_t>(mesh.data.indices.size());
+			meshRec.boundingSphere[0] = mesh.data.boundingSphere.center.x;
+			meshRec.boundingSphere[1] = mesh.data.boundingSphere.center.y;
+			meshRec.boundingSphere[2] = mesh.data.boundingSphere.center.z;
+			meshRec.boundingSphere[3] = mesh.data.boundingSphere.radius;
+			meshRec.node = static_cast<uint32_t>(n);
+			meshRec.material = mesh.material;
+			meshRec.name = addString(mesh.name);
+			meshRec.firstLod = firstLod[m];
+			meshRec.lodCount = static_cast<uint32_t>(std::max<size_t>(mesh.data.lods.size(), 1));
+			meshRec.firstCluster = firstCluster[m];
+			meshRec.clusterCount = static_cast<uint32_t>(mesh.data.clusters.size());
+			meshes.push_back(meshRec);
+		}
+	}
+
+	std::vector<LightRecord> lights;
+	lights.reserve(level.lights.size());
+	for (const auto& light : level.lights) {
+		LightRecord rec = {};
+		std::memcpy(rec.vec, glm::value_ptr(light.mVec), sizeof(rec.vec));
+		std::memcpy(rec.color, glm::value_ptr(light.mColor), sizeof(rec.color));
+		rec.radius = light.mRadius;
+		rec.type = light.mVec.w == 0.0f ? Lights::SPARKLE_LIGHT_TYPE_DIRECTIONAL : Lights::SPARKLE_LIGHT_TYPE_POINT;
+		lights.push_back(rec);
+	}
+
+	Header header = {};
+	header.magic = Magic;
+	header.version = Version;
+	header.vertexSize = sizeof(Geometry::Vertex);
+
+	uint64_t offset = alignSection(sizeof(Header));
+	header.strings = placeSection<char>(offset, strings.size());
+	header.textures = placeSection<TextureRecord>(offset, textures.size());
+	header.materials = placeSection<MaterialRecord>(offset, materials.size());
+	header.nodes = placeSection<NodeRecord>(offset, nodes.size());
+	header.meshes = placeSection<MeshRecord>(offset, meshes.size());
+	header.vertices = placeSection<Geometry::Vertex>(offset, vertexCount);
+	header.indices = placeSection<uint32_t>(offset, indexCount);
+	header.lods = placeSection<LodRecord>(offset, lods.size());
+	header.clusters = placeSection<ClusterRecord>(offset, clusters.size());
+	header.lights = placeSection<LightRecord>(offset, lights.size());
+
+	std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open file: " + fileName);
+	}
+	file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+	seekSection(file, header.strings);
+	file.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+	seekSection(file, header.textures);
+	file.write(reinterpret_cast<const char*>(textures.data()), static_cast<std::streamsize>(textures.size() * sizeof(TextureRecord)));
+	seekSection(file, header.materials);
+	file.write(reinterpret_cast<const char*>(materials.data()), static_cast<std::streamsize>(materials.size() * sizeof(MaterialRecord)));
+	seekSection(file, header.nodes);
+	file.write(reinterpret_cast<const char*>(nodes.data()), static_cast<std::streamsize>(nodes.size() * sizeof(NodeRecord)));
+	seekSection(file, header.meshes);
+	file.write(reinterpret_cast<const char*>(meshes.data()), static_cast<std::streamsize>(meshes.size() * sizeof(MeshRecord)));
+
+	seekSection(file, header.vertices);
+	for (const auto& mesh : level.meshes) {
+		file.write(reinterpret_cast<const char*>(mesh.data.vertices.data()), static_cast<std::streamsize>(mesh.data.vertices.size() * sizeof(Geometry::Vertex)));
+	}
+	seekSection(file, header.indices);
+	for (const auto& mesh : level.meshes) {
+		file.write(reinterpret_cast<const char*>(mesh.data.indices.data()), static_cast<std::streamsize>(mesh.data.indices.size() * sizeof(uint32_t)));
+	}
+	seekSection(file, header.lods);
+	file.write(reinterpret_cast<const char*>(lods.data()), static_cast<std::streamsize>(lods.size() * sizeof(LodRecord)));
+	seekSection(file, header.clusters);
+	file.write(reinterpret_cast<const char*>(clusters.data()), static_cast<std::streamsize>(clusters.size() * sizeof(ClusterRecord)));
+	seekSection(file, header.lights);
+	file.write(reinterpret_cast<const char*>(lights.data()), static_cast<std::streamsize>(lights.size() * sizeof(LightRecord)));
+
+	if (!file) {
+		throw std::runtime_error("Failed to write level: " + fileName);
+	}
+}
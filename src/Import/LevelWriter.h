@@ -0,0 +1,23 @@
+#ifndef LEVEL_WRITER_H
+#define LEVEL_WRITER_H
+
+#include <string>
+
+#include "LevelData.h"
+
+namespace Sparkle {
+namespace Import {
+	class LevelWriter {
+	public:
+		/**
+		 * \brief write level as cooked .spkl file, throws on I/O errors
+		 * embedded textures are extracted into image files next to the level
+		 * \param level level to write
+		 * \param fileName path of the output file
+		 */
+		static void write(const LevelData& level, const std::string& fileName);
+	};
+} // namespace Import
+} // namespace Sparkle
+
+#endif
@@ -0,0 +1,91 @@
+#include "MeshClusterizer.h"
+
+#include "Bounds.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Sparkle;
+using namespace Geometry;
+
+/*
+ * bounding sphere and normal cone of the triangles in indices[first, first + count)
+ * cone.xyz is the average facing direction, cone.w the cutoff used by cull.comp (1 disables cone culling)
+ */
+static Mesh::Cluster finishCluster(const Mesh::MeshData& data, uint32_t first, uint32_t count)
+{
+	Mesh::Cluster cluster = {};
+	cluster.firstIndex = first;
+	cluster.indexCount = count;
+
+	std::vector<glm::vec3> positions;
+	positions.reserve(count);
+	glm::vec3 axis(0.0f);
+	for (auto i = first; i < first + count; i += 3) {
+		const auto& p0 = data.vertices[data.indices[i + 0]].position;
+		const auto& p1 = data.vertices[data.indices[i + 1]].position;
+		const auto& p2 = data.vertices[data.indices[i + 2]].position;
+		positions.insert(positions.end(), { p0, p1, p2 });
+		axis += glm::cross(p1 - p0, p2 - p0); // area weighted
+	}
+	cluster.boundingSphere = Bounds::computeSphere(positions.data(), positions.size());
+
+	// the cone contains every triangle normal, clusters spreading over more than a half space are never cone culled
+	cluster.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	const auto axisLength = glm::length(axis);
+	if (axisLength <= 0.0f) {
+		return cluster;
+	}
+	axis /= axisLength;
+	float minDot = 1.0f;
+	for (auto i = first; i < first + count; i += 3) {
+		const auto& p0 = data.vertices[data.indices[i + 0]].position;
+		const auto normal = glm::cross(data.vertices[data.indices[i + 1]].position - p0, data.vertices[data.indices[i + 2]].position - p0);
+		const auto length = glm::length(normal);
+		if (length > 0.0f) {
+			minDot = std::min(minDot, glm::dot(normal / length, axis));
+		}
+	}
+	if (minDot > 0.0f) {
+		cluster.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+	}
+	return cluster;
+}
+
+void Import::MeshClusterizer::buildClusters(Mesh::MeshData& data)
+{
+	data.clusters.clear();
+	const auto lodIndexCount = data.lods.empty() ? data.indices.size() - data.indices.size() % 3 : data.lods.front().indexCount;
+	const auto invalid = std::any_of(data.indices.begin(), data.indices.begin() + lodIndexCount, [&data](uint32_t i) { return i >= data.vertices.size(); });
+	if (lodIndexCount == 0 || invalid) {
+		return;
+	}
+
+	// vertices of the open cluster, a vertex belongs to it if its stamp matches the cluster number
+	std::vector<uint32_t> stamp(data.vertices.size(), 0);
+	uint32_t clusterNumber = 1;
+	size_t vertexCount = 0;
+	uint32_t first = 0;
+	for (uint32_t i = 0; i < lodIndexCount; i += 3) {
+		size_t newVertices = 0;
+		for (uint32_t c = 0; c < 3; ++c) {
+			if (stamp[data.indices[i + c]] != clusterNumber) {
+				++newVertices;
+			}
+		}
+		if (vertexCount + newVertices > MaxVertices || (i - first) / 3 >= MaxTriangles) {
+			data.clusters.push_back(finishCluster(data, first, i - first));
+			first = i;
+			vertexCount = 0;
+			++clusterNumber;
+		}
+		for (uint32_t c = 0; c < 3; ++c) {
+			auto& s = stamp[data.indices[i + c]];
+			if (s != clusterNumber) {
+				s = clusterNumber;
+				++vertexCount;
+			}
+		}
+	}
+	data.clusters.push_back(finishCluster(data, first, static_cast<uint32_t>(lodIndexCount) - first));
+}
@@ -0,0 +1,25 @@
+#ifndef MESH_CLUSTERIZER_H
+#define MESH_CLUSTERIZER_H
+
+#include "Geometry.h"
+
+namespace Sparkle {
+namespace Import {
+	/**
+	 * splits lod 0 of imported meshes into small clusters (meshlets) that are culled and drawn individually
+	 */
+	class MeshClusterizer {
+	public:
+		static constexpr size_t MaxVertices = 64;
+		static constexpr size_t MaxTriangles = 124;
+
+		/**
+		 * fill data.clusters with consecutive index ranges of lod 0, each with its bounding sphere and normal cone.
+		 * Triangles keep their order, so run MeshOptimizer::optimize first for spatially coherent clusters.
+		 */
+		static void buildClusters(Geometry::Mesh::MeshData& data);
+	};
+} // namespace Import
+} // namespace Sparkle
+
+#endif
@@ -0,0 +1,281 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <numeric>
+
+using namespace Sparkle;
+using namespace Geometry;
+
+/*
+ * triangles per vertex as one flat array, triangles of vertex v are
+ * triangles[offsets[v]] .. triangles[offsets[v] + counts[v]]
+ */
+struct VertexAdjacency {
+	std::vector<uint32_t> counts;
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> triangles;
+
+	VertexAdjacency(const std::vector<uint32_t>& indices, size_t vertexCount)
+	    : counts(vertexCount, 0)
+	    , offsets(vertexCount, 0)
+	    , triangles(indices.size())
+	{
+		for (const auto i : indices) {
+			++counts[i];
+		}
+		uint32_t offset = 0;
+		for (size_t v = 0; v < vertexCount; ++v) {
+			offsets[v] = offset;
+			offset += counts[v];
+		}
+		std::vector<uint32_t> fill(offsets);
+		for (size_t i = 0; i < indices.size(); ++i) {
+			triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+	}
+};
+
+/*
+ * Sander et al. 2007, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"
+ * fans around the vertex that is most likely still in the cache, falls back to recently used vertices on dead ends
+ */
+static std::vector<uint32_t> tipsify(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+{
+	const auto triangleCount = indices.size() / 3;
+	const VertexAdjacency adjacency(indices, vertexCount);
+
+	std::vector<uint32_t> liveTriangles(adjacency.counts);
+	std::vector<uint32_t> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnds;
+	std::vector<uint32_t> candidates;
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	uint32_t time = cacheSize + 1;
+	size_t cursor = 0;
+
+	const auto skipDeadEnd = [&]() -> int64_t {
+		while (!deadEnds.empty()) {
+			const auto v = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[v] > 0) {
+				return v;
+			}
+		}
+		for (; cursor < vertexCount; ++cursor) {
+			if (liveTriangles[cursor] > 0) {
+				return static_cast<int64_t>(cursor);
+			}
+		}
+		return -1;
+	};
+
+	int64_t fanning = skipDeadEnd();
+	while (fanning >= 0) {
+		candidates.clear();
+		const auto v = static_cast<uint32_t>(fanning);
+		for (uint32_t t = 0; t < adjacency.counts[v]; ++t) {
+			const auto tri = adjacency.triangles[adjacency.offsets[v] + t];
+			if (emitted[tri]) {
+				continue;
+			}
+			for (uint32_t c = 0; c < 3; ++c) {
+				const auto corner = indices[tri * 3 + c];
+				result.push_back(corner);
+				deadEnds.push_back(corner);
+				candidates.push_back(corner);
+				--liveTriangles[corner];
+				if (time - cacheTime[corner] > cacheSize) {
+					cacheTime[corner] = time++;
+				}
+			}
+			emitted[tri] = true;
+		}
+
+		// prefer the candidate that stays in the cache while its remaining triangles are emitted
+		int64_t next = -1;
+		uint32_t best = 0;
+		for (const auto c : candidates) {
+			if (liveTriangles[c] == 0) {
+				continue;
+			}
+			uint32_t priority = 0;
+			if (time - cacheTime[c] + 2 * liveTriangles[c] <= cacheSize) {
+				priority = time - cacheTime[c];
+			}
+			if (priority > best) {
+				best = priority;
+				next = c;
+			}
+		}
+		fanning = next >= 0 ? next : skipDeadEnd();
+	}
+	return result;
+}
+
+/*
+ * split the triangle order where the FIFO cache is effectively flushed (all three vertices miss),
+ * the resulting clusters can be reordered without hurting vertex cache efficiency
+ */
+static std::vector<size_t> findClusters(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+{
+	std::vector<size_t> clusters;
+	std::vector<uint32_t> cacheTime(vertexCount, 0);
+	uint32_t time = cacheSize + 1;
+	for (size_t tri = 0; tri < indices.size() / 3; ++tri) {
+		uint32_t misses = 0;
+		for (uint32_t c = 0; c < 3; ++c) {
+			const auto v = indices[tri * 3 + c];
+			if (time - cacheTime[v] > cacheSize) {
+				cacheTime[v] = time++;
+				++misses;
+			}
+		}
+		if (misses == 3 || clusters.empty()) {
+			clusters.push_back(tri);
+		}
+	}
+	return clusters;
+}
+
+/*
+ * view independent overdraw reduction: clusters facing away from the mesh center are likely
+ * to occlude the rest and are drawn first (Sander et al. 2007, section 4)
+ */
+static void sortClusters(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<size_t>& clusters)
+{
+	const auto triangleCount = indices.size() / 3;
+	if (clusters.size() < 2) {
+		return;
+	}
+
+	glm::vec3 meshCenter(0.0f);
+	float meshArea = 0.0f;
+	std::vector<glm::vec3> clusterCenter(clusters.size(), glm::vec3(0.0f));
+	std::vector<glm::vec3> clusterNormal(clusters.size(), glm::vec3(0.0f));
+	std::vector<float> clusterArea(clusters.size(), 0.0f);
+
+	for (size_t c = 0; c < clusters.size(); ++c) {
+		const auto end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+		for (auto tri = clusters[c]; tri < end; ++tri) {
+			const auto& p0 = vertices[indices[tri * 3 + 0]].position;
+			const auto& p1 = vertices[indices[tri * 3 + 1]].position;
+			const auto& p2 = vertices[indices[tri * 3 + 2]].position;
+			const auto normal = glm::cross(p1 - p0, p2 - p0); // length is twice the area
+			const auto area = glm::length(normal);
+			const auto center = (p0 + p1 + p2) / 3.0f;
+			clusterCenter[c] += center * area;
+			clusterNormal[c] += normal;
+			clusterArea[c] += area;
+		}
+		meshCenter += clusterCenter[c];
+		meshArea += clusterArea[c];
+	}
+	meshCenter = meshArea > 0.0f ? meshCenter / meshArea : meshCenter;
+
+	std::vector<float> sortKey(clusters.size());
+	for (size_t c = 0; c < clusters.size(); ++c) {
+		const auto center = clusterArea[c] > 0.0f ? clusterCenter[c] / clusterArea[c] : clusterCenter[c];
+		const auto normalLength = glm::length(clusterNormal[c]);
+		const auto normal = normalLength > 0.0f ? clusterNormal[c] / normalLength : clusterNormal[c];
+		sortKey[c] = glm::dot(center - meshCenter, normal);
+	}
+
+	std::vector<size_t> order(clusters.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&sortKey](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+	std::vector<uint32_t> sorted;
+	sorted.reserve(indices.size());
+	for (const auto c : order) {
+		const auto end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+		sorted.insert(sorted.end(), indices.begin() + clusters[c] * 3, indices.begin() + end * 3);
+	}
+	indices.swap(sorted);
+}
+
+/*
+ * store vertices in the order they are first referenced, unreferenced vertices are dropped
+ */
+static void reorderVertexFetch(Mesh::MeshData& data)
+{
+	constexpr auto unused = std::numeric_limits<uint32_t>::max();
+	std::vector<uint32_t> remap(data.vertices.size(), unused);
+	std::vector<Vertex> vertices;
+	vertices.reserve(data.vertices.size());
+	for (auto& i : data.indices) {
+		if (remap[i] == unused) {
+			remap[i] = static_cast<uint32_t>(vertices.size());
+			vertices.push_back(data.vertices[i]);
+		}
+		i = remap[i];
+	}
+	data.vertices.swap(vertices);
+}
+
+Import::MeshOptimizer::Statistics Import::MeshOptimizer::analyze(const Mesh::MeshData& data, uint32_t cacheSize)
+{
+	Statistics stats;
+	stats.triangles = data.indices.size() / 3;
+
+	std::vector<uint32_t> cacheTime(data.vertices.size(), 0);
+	std::vector<bool> referenced(data.vertices.size(), false);
+	uint32_t time = cacheSize + 1;
+	for (const auto i : data.indices) {
+		if (i >= data.vertices.size()) {
+			continue;
+		}
+		if (!referenced[i]) {
+			referenced[i] = true;
+			++stats.vertices;
+		}
+		if (time - cacheTime[i] > cacheSize) {
+			cacheTime[i] = time++;
+			++stats.cacheMisses;
+		}
+	}
+	return stats;
+}
+
+Import::MeshOptimizer::Report Import::MeshOptimizer::optimize(Mesh::MeshData& data)
+{
+	Report report;
+	report.before = analyze(data);
+
+	if (data.lods.size() > 1) {
+		report.after = report.before;
+		return report;
+	}
+	data.indices.resize(data.indices.size() - data.indices.size() % 3);
+	const auto invalid = std::any_of(data.indices.begin(), data.indices.end(), [&data](uint32_t i) { return i >= data.vertices.size(); });
+	if (data.indices.empty() || invalid) {
+		report.after = report.before;
+		return report;
+	}
+
+	data.indices = tipsify(data.indices, data.vertices.size(), CacheSize);
+	sortClusters(data.indices, data.vertices, findClusters(data.indices, data.vertices.size(), CacheSize));
+	reorderVertexFetch(data);
+
+	report.after = analyze(data);
+	return report;
+}
+
+void Import::MeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	if (indices.size() < 3 || indices.size() % 3 != 0) {
+		return;
+	}
+	indices = tipsify(indices, vertexCount, CacheSize);
+}
+
+std::string Import::MeshOptimizer::Report::toString() const
+{
+	char buffer[128];
+	std::snprintf(buffer, sizeof(buffer), "ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", before.acmr(), after.acmr(), before.atvr(), after.atvr());
+	return std::string(buffer);
+}
@@ -0,0 +1,82 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <string>
+
+#include "Geometry.h"
+
+namespace Sparkle {
+namespace Import {
+	/**
+	 * reorders triangles and vertices of imported meshes for the post-transform vertex cache,
+	 * overdraw and vertex fetch. The triangle set and vertex attributes stay the same.
+	 */
+	class MeshOptimizer {
+	public:
+		/**
+		 * FIFO cache size used for optimization and for the reported metrics
+		 */
+		static constexpr uint32_t CacheSize = 16;
+
+		struct Statistics {
+			size_t vertices = 0; // referenced vertices
+			size_t triangles = 0;
+			size_t cacheMisses = 0; // vertex shader invocations
+
+			/**
+			 * average cache miss ratio, transformed vertices per triangle (0.5 is optimal, 3 is worst)
+			 */
+			float acmr() const { return triangles > 0 ? static_cast<float>(cacheMisses) / triangles : 0.0f; }
+			/**
+			 * average transform to vertex ratio, transformed vertices per referenced vertex (1 is optimal)
+			 */
+			float atvr() const { return vertices > 0 ? static_cast<float>(cacheMisses) / vertices : 0.0f; }
+
+			Statistics& operator+=(const Statistics& other)
+			{
+				vertices += other.vertices;
+				triangles += other.triangles;
+				cacheMisses += other.cacheMisses;
+				return *this;
+			}
+		};
+
+		struct Report {
+			Statistics before;
+			Statistics after;
+
+			Report& operator+=(const Report& other)
+			{
+				before += other.before;
+				after += other.after;
+				return *this;
+			}
+
+			/**
+			 * one line "ACMR a -> b, ATVR c -> d" summary for logs
+			 */
+			std::string toString() const;
+		};
+
+		/**
+		 * simulate a FIFO post-transform cache of the given size over the index buffer
+		 */
+		static Statistics analyze(const Geometry::Mesh::MeshData& data, uint32_t cacheSize = CacheSize);
+
+		/**
+		 * optimize the mesh in place: vertex cache order (tipsify), overdraw aware cluster order
+		 * and vertex fetch order. Vertices not referenced by any triangle are removed.
+		 * Has to run before lods are generated, meshes with a lod chain are left untouched.
+		 */
+		static Report optimize(Geometry::Mesh::MeshData& data);
+
+		/**
+		 * reorder the triangles of an index buffer for the vertex cache only, used for index buffers sharing
+		 * the vertices of an already optimized mesh (lods)
+		 */
+		static void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+	};
+} // namespace Import
+} // namespace Sparkle
+
+#endif
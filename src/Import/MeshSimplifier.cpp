@@ -0,0 +1,302 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <unordered_map>
+
+using namespace Sparkle;
+using namespace Geometry;
+
+/*
+ * symmetric 4x4 error quadric, weighted by the area of the planes it was built from
+ */
+struct Quadric {
+	double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+	double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+	double c = 0.0;
+	double weight = 0.0;
+
+	static Quadric fromPlane(const glm::vec3& n, float d, float w)
+	{
+		Quadric q;
+		q.a00 = w * n.x * n.x;
+		q.a01 = w * n.x * n.y;
+		q.a02 = w * n.x * n.z;
+		q.a11 = w * n.y * n.y;
+		q.a12 = w * n.y * n.z;
+		q.a22 = w * n.z * n.z;
+		q.b0 = w * n.x * d;
+		q.b1 = w * n.y * d;
+		q.b2 = w * n.z * d;
+		q.c = w * d * d;
+		q.weight = w;
+		return q;
+	}
+
+	Quadric& operator+=(const Quadric& o)
+	{
+		a00 += o.a00;
+		a01 += o.a01;
+		a02 += o.a02;
+		a11 += o.a11;
+		a12 += o.a12;
+		a22 += o.a22;
+		b0 += o.b0;
+		b1 += o.b1;
+		b2 += o.b2;
+		c += o.c;
+		weight += o.weight;
+		return *this;
+	}
+
+	/**
+	 * mean squared distance of p to the planes of the quadric
+	 */
+	double error(const glm::vec3& p) const
+	{
+		const double x = p.x, y = p.y, z = p.z;
+		const auto e = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+		    + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+		return weight > 0.0 ? std::max(e, 0.0) / weight : 0.0;
+	}
+};
+
+struct Collapse {
+	uint32_t source;
+	uint32_t target;
+	double cost;
+};
+
+/*
+ * triangles around every vertex of the current index buffer
+ */
+static void buildAdjacency(const std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& offsets, std::vector<uint32_t>& triangles)
+{
+	offsets.assign(vertexCount + 1, 0);
+	for (const auto i : indices) {
+		++offsets[i + 1];
+	}
+	for (size_t v = 0; v < vertexCount; ++v) {
+		offsets[v + 1] += offsets[v];
+	}
+	triangles.resize(indices.size());
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); ++i) {
+		triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+}
+
+/*
+ * vertices on an edge that is not shared by exactly two triangles are locked: mesh borders,
+ * attribute seams (split vertices) and non manifold edges keep their shape
+ */
+static std::vector<bool> findLockedVertices(const std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	std::unordered_map<uint64_t, uint32_t> edges;
+	edges.reserve(indices.size());
+	for (size_t t = 0; t < indices.size(); t += 3) {
+		for (uint32_t e = 0; e < 3; ++e) {
+			const auto a = indices[t + e];
+			const auto b = indices[t + (e + 1) % 3];
+			++edges[(static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b)];
+		}
+	}
+	std::vector<bool> locked(vertexCount, false);
+	for (const auto& edge : edges) {
+		if (edge.second != 2) {
+			locked[static_cast<uint32_t>(edge.first >> 32)] = true;
+			locked[static_cast<uint32_t>(edge.first)] = true;
+		}
+	}
+	return locked;
+}
+
+/*
+ * collapse edges by increasing quadric error until the index buffer reaches targetIndexCount or no valid collapse is left
+ * \param error receives the largest error of all collapses, as distance in object space
+ */
+static std::vector<uint32_t> simplify(const std::vector<Vertex>& vertices, std::vector<uint32_t> indices, size_t targetIndexCount, float& error)
+{
+	const auto vertexCount = vertices.size();
+	const auto locked = findLockedVertices(indices, vertexCount);
+
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t t = 0; t < indices.size(); t += 3) {
+		const auto& p0 = vertices[indices[t + 0]].position;
+		const auto& p1 = vertices[indices[t + 1]].position;
+		const auto& p2 = vertices[indices[t + 2]].position;
+		const auto normal = glm::cross(p1 - p0, p2 - p0);
+		const auto length = glm::length(normal);
+		if (length <= 0.0f) {
+			continue;
+		}
+		const auto n = normal / length;
+		const auto q = Quadric::fromPlane(n, -glm::dot(n, p0), 0.5f * length);
+		quadrics[indices[t + 0]] += q;
+		quadrics[indices[t + 1]] += q;
+		quadrics[indices[t + 2]] += q;
+	}
+
+	double maxCost = 0.0;
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> triangles;
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> sourceRing;
+	std::vector<uint32_t> targetRing;
+	std::vector<uint32_t> common;
+
+	const auto ring = [&](uint32_t v, std::vector<uint32_t>& result) {
+		result.clear();
+		for (auto t = offsets[v]; t < offsets[v + 1]; ++t) {
+			const auto tri = triangles[t] * 3;
+			result.insert(result.end(), { indices[tri], indices[tri + 1], indices[tri + 2] });
+		}
+		std::sort(result.begin(), result.end());
+		result.erase(std::unique(result.begin(), result.end()), result.end());
+	};
+
+	// moving source onto target must not flip or degenerate any triangle that survives the collapse
+	const auto preservesOrientation = [&](uint32_t source, uint32_t target) {
+		const auto& p = vertices[target].position;
+		for (auto t = offsets[source]; t < offsets[source + 1]; ++t) {
+			const auto tri = triangles[t] * 3;
+			const uint32_t corners[3] = { indices[tri], indices[tri + 1], indices[tri + 2] };
+			if (corners[0] == target || corners[1] == target || corners[2] == target) {
+				continue;
+			}
+			glm::vec3 moved[3];
+			for (uint32_t c = 0; c < 3; ++c) {
+				moved[c] = corners[c] == source ? p : vertices[corners[c]].position;
+			}
+			const auto before = glm::cross(vertices[corners[1]].position - vertices[corners[0]].position, vertices[corners[2]].position - vertices[corners[0]].position);
+			const auto after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+			if (glm::dot(before, after) <= 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	};
+
+	while (indices.size() > targetIndexCount) {
+		buildAdjacency(indices, vertexCount, offsets, triangles);
+
+		collapses.clear();
+		for (size_t t = 0; t < indices.size(); t += 3) {
+			for (uint32_t e = 0; e < 3; ++e) {
+				const auto a = indices[t + e];
+				const auto b = indices[t + (e + 1) % 3];
+				// interior edges are visited from both triangles, only keep one direction
+				if (a > b || (locked[a] && locked[b])) {
+					continue;
+				}
+				auto q = quadrics[a];
+				q += quadrics[b];
+				const auto costA = locked[a] ? std::numeric_limits<double>::max() : q.error(vertices[b].position);
+				const auto costB = locked[b] ? std::numeric_limits<double>::max() : q.error(vertices[a].position);
+				collapses.push_back(costA <= costB ? Collapse { a, b, costA } : Collapse { b, a, costB });
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) { return l.cost < r.cost; });
+
+		// collapses of one pass touch disjoint triangle fans, so their validity checks stay independent
+		std::fill(touched.begin(), touched.end(), false);
+		for (uint32_t v = 0; v < vertexCount; ++v) {
+			remap[v] = v;
+		}
+		const auto removeTriangles = (indices.size() - targetIndexCount) / 3;
+		size_t removed = 0;
+		for (const auto& collapse : collapses) {
+			if (removed >= removeTriangles) {
+				break;
+			}
+			if (touched[collapse.source] || touched[collapse.target]) {
+				continue;
+			}
+			ring(collapse.source, sourceRing);
+			ring(collapse.target, targetRing);
+			// link condition: the fans may only share the vertices of the triangles on the collapsed edge
+			size_t shared = 0;
+			for (auto t = offsets[collapse.source]; t < offsets[collapse.source + 1]; ++t) {
+				const auto tri = triangles[t] * 3;
+				if (indices[tri] == collapse.target || indices[tri + 1] == collapse.target || indices[tri + 2] == collapse.target) {
+					++shared;
+				}
+			}
+			common.clear();
+			std::set_intersection(sourceRing.begin(), sourceRing.end(), targetRing.begin(), targetRing.end(), std::back_inserter(common));
+			if (common.size() != shared + 2 || !preservesOrientation(collapse.source, collapse.target)) {
+				continue;
+			}
+
+			remap[collapse.source] = collapse.target;
+			quadrics[collapse.target] += quadrics[collapse.source];
+			for (const auto v : sourceRing) {
+				touched[v] = true;
+			}
+			removed += shared;
+			maxCost = std::max(maxCost, collapse.cost);
+		}
+		if (removed == 0) {
+			break;
+		}
+
+		size_t count = 0;
+		for (size_t t = 0; t < indices.size(); t += 3) {
+			const auto a = remap[indices[t]];
+			const auto b = remap[indices[t + 1]];
+			const auto c = remap[indices[t + 2]];
+			if (a == b || b == c || a == c) {
+				continue;
+			}
+			indices[count++] = a;
+			indices[count++] = b;
+			indices[count++] = c;
+		}
+		indices.resize(count);
+	}
+
+	error = static_cast<float>(std::sqrt(maxCost));
+	return indices;
+}
+
+void Import::MeshSimplifier::generateLods(Mesh::MeshData& data)
+{
+	if (!data.lods.empty() || data.indices.size() / 3 < 2 * MinTriangles) {
+		return;
+	}
+	const auto invalid = std::any_of(data.indices.begin(), data.indices.end(), [&data](uint32_t i) { return i >= data.vertices.size(); });
+	if (invalid) {
+		return;
+	}
+
+	data.indices.resize(data.indices.size() - data.indices.size() % 3);
+	data.lods.push_back({ 0, static_cast<uint32_t>(data.indices.size()), 0.0f });
+	std::vector<uint32_t> current(data.indices);
+	float error = 0.0f;
+	while (data.lods.size() < Mesh::MaxLods) {
+		const auto target = static_cast<size_t>(current.size() / 3 * ReductionRatio) * 3;
+		if (target / 3 < MinTriangles) {
+			break;
+		}
+		float lodError = 0.0f;
+		auto lod = simplify(data.vertices, current, target, lodError);
+		// stop once borders and seams dominate and collapsing barely makes progress
+		if (lod.empty() || lod.size() > current.size() - current.size() / 8) {
+			break;
+		}
+		// errors are measured against the previous lod, their sum bounds the deviation from the base mesh
+		error += lodError;
+		MeshOptimizer::optimizeVertexCache(lod, data.vertices.size());
+		data.lods.push_back({ static_cast<uint32_t>(data.indices.size()), static_cast<uint32_t>(lod.size()), error });
+		data.indices.insert(data.indices.end(), lod.begin(), lod.end());
+		current.swap(lod);
+	}
+	if (data.lods.size() == 1) {
+		data.lods.clear();
+	}
+}
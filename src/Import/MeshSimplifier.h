@@ -0,0 +1,33 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include "Geometry.h"
+
+namespace Sparkle {
+namespace Import {
+	/**
+	 * generates the lod chain of imported meshes by quadric edge collapse (Garland and Heckbert 1997).
+	 * Lods only collapse vertices onto existing ones, so every lod is an index buffer into the vertices of the base lod.
+	 */
+	class MeshSimplifier {
+	public:
+		/**
+		 * every lod targets this fraction of the triangles of the previous one
+		 */
+		static constexpr float ReductionRatio = 0.5f;
+		/**
+		 * no further lods are generated below this triangle count
+		 */
+		static constexpr size_t MinTriangles = 64;
+
+		/**
+		 * append simplified index buffers to data.indices and describe the chain in data.lods.
+		 * Lod 0 is the unchanged input, borders and attribute seams are kept in place.
+		 * Run MeshOptimizer::optimize first, the lods reuse its vertex order.
+		 */
+		static void generateLods(Geometry::Mesh::MeshData& data);
+	};
+} // namespace Import
+} // namespace Sparkle
+
+#endif
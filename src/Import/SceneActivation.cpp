@@ -0,0 +1,27 @@
+#include "SceneActivation.h"
+
+#include <chrono>
+
+using namespace Sparkle;
+
+bool Import::SceneActivation::run(double budgetSeconds)
+{
+	using Clock = std::chrono::steady_clock;
+	const auto start = Clock::now();
+
+	bool attached = false;
+	if (steps.empty()) {
+		return attached;
+	}
+	do {
+		auto step = std::move(steps.front());
+		steps.pop_front();
+		attached |= step();
+	} while (!steps.empty() && std::chrono::duration<double>(Clock::now() - start).count() < budgetSeconds);
+
+	if (attached) {
+		// regrouping every instance is left to the end of the activation
+		scene->setAppended();
+	}
+	return attached;
+}
@@ -0,0 +1,50 @@
+#ifndef SCENE_ACTIVATION_H
+#define SCENE_ACTIVATION_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+
+#include "Geometry.h"
+
+namespace Sparkle {
+namespace Import {
+	/**
+	 * creates the gpu resources of a loaded level in small steps on the render thread,
+	 * frames keep being drawn while the scene fills up
+	 */
+	class SceneActivation {
+	public:
+		/**
+		 * creates some resources of the scene, returns true if it attached drawable geometry
+		 */
+		using Step = std::function<bool()>;
+
+		explicit SceneActivation(std::shared_ptr<Geometry::Scene> scene)
+		    : scene(std::move(scene))
+		{
+		}
+
+		std::shared_ptr<Geometry::Scene> getScene() const { return scene; }
+
+		/**
+		 * steps run in the order they are pushed, a running step may push further steps
+		 */
+		void push(Step step) { steps.push_back(std::move(step)); }
+
+		/**
+		 * run steps until budgetSeconds are spent, at least one step runs per call
+		 * \return true if drawable geometry was attached to the scene
+		 */
+		bool run(double budgetSeconds);
+
+		bool done() const { return steps.empty(); }
+
+	private:
+		std::shared_ptr<Geometry::Scene> scene;
+		std::deque<Step> steps;
+	};
+} // namespace Import
+} // namespace Sparkle
+
+#endif
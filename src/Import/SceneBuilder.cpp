@@ -0,0 +1,162 @@
+#include "SceneBuilder.h"
+
+#include "TextureCompression.h"
+#include "Util.h"
+
+#include <unordered_map>
+
+using namespace Sparkle;
+using namespace Geometry;
+
+Import::SceneBuilder::DecodedTextures Import::SceneBuilder::decodeTextures(const LevelData& level, const std::string& rootDirectory, Tools::ThreadPool& pool, bool compress)
+{
+	DecodedTextures images(level.textures.size());
+	pool.parallelFor(level.textures.size(), [&](size_t i) {
+		const auto& entry = level.textures[i];
+		try {
+			if (!entry.embedded.empty()) {
+				images[i] = Tools::FileReader::loadImage(entry.embedded.data(), entry.embedded.size(), entry.path);
+				if (compress) {
+					Tools::TextureCompression::compress(images[i], entry.type, pool);
+				}
+			} else if (compress) {
+				images[i] = Tools::TextureCompression::load(rootDirectory + entry.path, entry.type, pool);
+			} else {
+				images[i] = Tools::FileReader::loadImage(rootDirectory + entry.path);
+			}
+		} catch (std::exception& ex) {
+			LOGSTDOUT(ex.what());
+		}
+	});
+	return images;
+}
+
+void Import::SceneBuilder::build(const LevelData& level, const std::string& rootDirectory, DecodedTextures& images, SceneActivation& activation)
+{
+	using TextureSet = std::array<uint32_t, LevelFormat::TextureSlots>;
+	// resources created by earlier steps and looked up by later ones
+	struct State {
+		std::shared_ptr<Texture> defaultDiffuse;
+		std::shared_ptr<Texture> defaultSpecular;
+		std::vector<std::shared_ptr<Texture>> textures;
+		std::unordered_map<TextureSet, std::shared_ptr<Material>, TextureSetHash> materialLookup;
+		std::vector<std::shared_ptr<Material>> materials;
+		std::vector<std::shared_ptr<Node>> nodes;
+		std::vector<std::shared_ptr<Mesh>> uploaded;
+	};
+	const auto state = std::make_shared<State>();
+	state->textures.resize(level.textures.size());
+	state->materials.resize(level.materials.size());
+	state->nodes.resize(level.nodes.size());
+	state->uploaded.resize(level.meshes.size());
+	const auto scene = activation.getScene();
+
+	activation.push([state, scene]() {
+		state->defaultDiffuse = std::make_shared<Texture>("assets/materials/default/diff.png", TEX_TYPE_DIFFUSE);
+		state->defaultSpecular = std::make_shared<Texture>("assets/materials/default/spec.png", TEX_TYPE_SPECULAR);
+		scene->textureCache.push_back(state->defaultDiffuse);
+		scene->textureCache.push_back(state->defaultSpecular);
+		return false;
+	});
+
+	activation.push([&level, scene]() {
+		scene->setLights(level.lights);
+		return false;
+	});
+
+	for (size_t i = 0; i < level.textures.size(); ++i) {
+		activation.push([&level, &images, rootDirectory, state, scene, i]() {
+			const auto& entry = level.textures[i];
+			auto& texture = state->textures[i];
+			try {
+				if (i < images.size()) {
+					if (images[i].imageData) {
+						texture = std::make_shared<Texture>(images[i], entry.type, rootDirectory + entry.path);
+					}
+				} else if (!entry.embedded.empty()) {
+					texture = std::make_shared<Texture>(entry.embedded.data(), entry.embedded.size(), entry.type, entry.path);
+				} else {
+					texture = std::make_shared<Texture>(rootDirectory + entry.path, entry.type);
+				}
+				if (texture) {
+					scene->textureCache.push_back(texture);
+				}
+			} catch (std::exception& ex) {
+				LOGSTDOUT(ex.what());
+			}
+			if (i < images.size()) {
+				images[i].free();
+			}
+			return false;
+		});
+	}
+
+	// materials are shared by texture set, textures that failed to load fall back to the defaults
+	const auto getMaterial = [state, scene](TextureSet set) {
+		for (auto& idx : set) {
+			if (idx != LevelFormat::InvalidIndex && !state->textures[idx]) {
+				idx = LevelFormat::InvalidIndex;
+			}
+		}
+		auto& material = state->materialLookup[set];
+		if (!material) {
+			std::vector<std::shared_ptr<Texture>> matTextures;
+			for (uint32_t t = 0; t < LevelFormat::TextureSlots; ++t) {
+				if (set[t] != LevelFormat::InvalidIndex) {
+					matTextures.push_back(state->textures[set[t]]);
+				} else if (t == TEX_TYPE_DIFFUSE) {
+					matTextures.push_back(state->defaultDiffuse);
+				} else if (t == TEX_TYPE_SPECULAR) {
+					matTextures.push_back(state->defaultSpecular);
+				}
+			}
+			material = std::make_shared<Material>(matTextures);
+			scene->materialCache.push_back(material);
+		}
+		return material;
+	};
+
+	for (size_t i = 0; i < level.materials.size(); ++i) {
+		activation.push([&level, state, getMaterial, i]() {
+			state->materials[i] = getMaterial(level.materials[i].textures);
+			return false;
+		});
+	}
+
+	activation.push([&level, state, scene]() {
+		for (size_t i = 0; i < level.nodes.size(); ++i) {
+			const auto& entry = level.nodes[i];
+			auto parent = entry.parent == LevelFormat::InvalidIndex ? scene->getRootNodePtr() : state->nodes[entry.parent];
+			state->nodes[i] = std::make_shared<Node>(entry.model, parent);
+			parent->addChild(state->nodes[i]);
+		}
+		return false;
+	});
+
+	// one upload per step, meshes become visible as soon as they are attached
+	for (size_t i = 0; i < level.nodes.size(); ++i) {
+		for (const auto m : level.nodes[i].meshes) {
+			activation.push([&level, state, getMaterial, i, m]() {
+				const auto& node = state->nodes[i];
+				// meshes referenced by several nodes are uploaded once and drawn as instances
+				if (state->uploaded[m]) {
+					node->addChild(std::make_shared<Mesh>(*state->uploaded[m], node));
+					return true;
+				}
+				const auto& meshEntry = level.meshes[m];
+				TextureSet defaultSet;
+				defaultSet.fill(LevelFormat::InvalidIndex);
+				const auto material = meshEntry.material != LevelFormat::InvalidIndex ? state->materials[meshEntry.material] : getMaterial(defaultSet);
+
+				const auto& data = meshEntry.data;
+				auto mesh = std::make_shared<Mesh>(data.vertices.data(), data.vertices.size(), data.indices.data(), data.indices.size(), data.lods, data.clusters, data.boundingSphere, material, node);
+				if (!meshEntry.name.empty()) {
+					mesh->setName(meshEntry.name);
+				}
+				state->uploaded[m] = mesh;
+				node->addChild(std::static_pointer_cast<Node, Mesh>(mesh));
+				return true;
+			});
+		}
+	}
+}
@@ -0,0 +1,44 @@
+#ifndef SCENE_BUILDER_H
+#define SCENE_BUILDER_H
+
+#include <memory>
+#include <string>
+
+#include "FileReader.h"
+#include "Geometry.h"
+#include "LevelData.h"
+#include "SceneActivation.h"
+#include "ThreadPool.h"
+
+namespace Sparkle {
+namespace Import {
+	/**
+	 * turns converted LevelData into a renderable scene, the activation steps have to run on the render thread as they upload to the GPU
+	 */
+	class SceneBuilder {
+	public:
+		/**
+		 * decoded images per level texture, entries without image data failed to decode
+		 */
+		using DecodedTextures = std::vector<Tools::FileReader::ImageFile>;
+
+		/**
+		 * decode all textures of the level on the pool, does not require a renderer
+		 * \param rootDirectory directory texture paths of the level are relative to
+		 * \param compress block compress the textures, files next to the level are compressed once and cached
+		 */
+		static DecodedTextures decodeTextures(const LevelData& level, const std::string& rootDirectory, Tools::ThreadPool& pool, bool compress);
+
+		/**
+		 * queue the creation of textures, materials and meshes of the level into the scene of activation,
+		 * level and images are referenced by the steps and have to outlive them
+		 * \param level converted level, geometry is uploaded directly from its arrays
+		 * \param rootDirectory directory texture paths of the level are relative to
+		 * \param images result of decodeTextures for the level, freed after upload. Textures are decoded on the render thread if empty.
+		 */
+		static void build(const LevelData& level, const std::string& rootDirectory, DecodedTextures& images, SceneActivation& activation);
+	};
+} // namespace Import
+} // namespace Sparkle
+
+#endif
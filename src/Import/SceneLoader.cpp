@@ -12,36 +12,64 @@ namespace fs = std::experimental::filesystem;
 
 using namespace Sparkle;
 
-void Import::SceneLoader::loadFromFile(std::string filePath)
+void Import::SceneLoader::loadFromFile(std::string filePath, bool compressTextures)
 {
+	// pending steps reference the loaders
+	activation.reset();
 	if (glTFImporter) {
 		glTFImporter.reset();
 	}
 	if (assimpImporter) {
 		assimpImporter.reset();
 	}
+	if (levelImporter) {
+		levelImporter.reset();
+	}
 	auto path = fs::path(filePath);
-	if (path.extension() == ".gltf1") {
+	if (path.extension() == ".spkl") {
+		levelImporter = std::make_unique<Import::LevelLoader>();
+		levelImporter->loadFromFile(filePath, compressTextures);
+	} else if (path.extension() == ".gltf" || path.extension() == ".glb") {
 		glTFImporter = std::make_unique<Import::glTFLoader>();
 		glTFImporter->loadFromFile(filePath);
 	} else {
 		assimpImporter = std::make_unique<Import::AssimpLoader>();
-		assimpImporter->loadFromFile(filePath);
+		assimpImporter->loadFromFile(filePath, compressTextures);
 	}
 
 }
 
-std::unique_ptr<Geometry::Scene> Import::SceneLoader::processScene() {
-	if (glTFImporter) {
-		return nullptr;
+std::shared_ptr<Geometry::Scene> Import::SceneLoader::processScene() {
+	activation = std::make_unique<SceneActivation>(std::make_shared<Geometry::Scene>());
+	if (levelImporter) {
+		levelImporter->processLevel(*activation);
+	} else if (glTFImporter) {
+		glTFImporter->processGlTF(*activation);
 	} else {
-		return assimpImporter->processAssimp();
+		assimpImporter->processAssimp(*activation);
 	}
+	return activation->getScene();
 }
 
-bool Import::SceneLoader::isLoaded() {
-	if (glTFImporter) {
+bool Import::SceneLoader::activate(double budgetSeconds) {
+	if (!activation) {
 		return false;
+	}
+	auto attached = activation->run(budgetSeconds);
+	if (activation->done()) {
+		// the slices appended their meshes as batches of their own, group the instances of the complete level
+		activation->getScene()->setDirty();
+		activation.reset();
+		attached = true;
+	}
+	return attached;
+}
+
+bool Import::SceneLoader::isLoaded() {
+	if (levelImporter) {
+		return levelImporter->isLoaded();
+	} else if (glTFImporter) {
+		return glTFImporter->isLoaded();
 	} else {
 		return assimpImporter->isLoaded();
 	}
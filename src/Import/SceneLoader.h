@@ -6,19 +6,35 @@
 #include "Geometry.h"
 #include "AssimpLoader.h"
 #include "GltfLoader.h"
+#include "LevelLoader.h"
+#include "SceneActivation.h"
 
 namespace Sparkle {
 namespace Import {
 	class SceneLoader {
 	public:
-		void loadFromFile(std::string filePath);
+		/**
+		 * \param compressTextures block compress textures of .spkl and assimp levels, glTF textures are uploaded uncompressed
+		 */
+		void loadFromFile(std::string filePath, bool compressTextures = true);
 
 		bool isLoaded();
-		std::unique_ptr<Geometry::Scene> processScene();
+		/**
+		 * start creating the loaded level on the gpu, the returned scene is empty until activate runs
+		 */
+		std::shared_ptr<Geometry::Scene> processScene();
+		/**
+		 * continue creating the scene for about budgetSeconds, has to be called on the render thread
+		 * \return true if new meshes became visible or the draws of the complete scene were regrouped
+		 */
+		bool activate(double budgetSeconds);
+		bool isActivated() const { return !activation || activation->done(); }
 
 	private:
+		std::unique_ptr<SceneActivation> activation = nullptr;
 		std::unique_ptr<AssimpLoader> assimpImporter = nullptr;
 		std::unique_ptr<glTFLoader> glTFImporter = nullptr;
+		std::unique_ptr<LevelLoader> levelImporter = nullptr;
 	};
 }
 }
@@ -0,0 +1,45 @@
+#include "Bounds.h"
+
+#include <iostream>
+
+using namespace Sparkle;
+using namespace Geometry;
+
+static int failures = 0;
+
+static void check(bool condition, const char* what)
+{
+	if (!condition) {
+		std::cerr << "FAILED: " << what << std::endl;
+		++failures;
+	}
+}
+
+// meshes without clusters of their own get a single cluster with the cone Mesh assigns to it
+static void singleClusterSurvivesConeCulling()
+{
+	const BoundingSphere sphere = { glm::vec3(0.0f), 1.0f };
+	const glm::vec4 cone(0.0f, 0.0f, 0.0f, 1.0f);
+	const glm::vec3 cameras[] = { glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f, 0.0f, -10.0f), glm::vec3(10.0f, 0.0f, 0.0f), glm::vec3(0.0f) };
+	for (const auto& camera : cameras) {
+		check(Bounds::coneVisible(cone, sphere, camera), "single cluster is visible from every side");
+	}
+	// no facing direction but a cutoff below 1 would normalize a zero vector
+	check(Bounds::coneVisible(glm::vec4(0.0f, 0.0f, 0.0f, 0.5f), sphere, glm::vec3(0.0f, 0.0f, 10.0f)), "cluster without facing direction is visible");
+}
+
+static void backFacingClusterIsCulled()
+{
+	const BoundingSphere sphere = { glm::vec3(0.0f), 1.0f };
+	// triangles facing +z within a narrow cone
+	const glm::vec4 cone(0.0f, 0.0f, 1.0f, 0.1f);
+	check(Bounds::coneVisible(cone, sphere, glm::vec3(0.0f, 0.0f, 10.0f)), "cluster facing the camera is visible");
+	check(!Bounds::coneVisible(cone, sphere, glm::vec3(0.0f, 0.0f, -10.0f)), "cluster facing away from the camera is culled");
+}
+
+int main()
+{
+	singleClusterSurvivesConeCulling();
+	backFacingClusterIsCulled();
+	return failures == 0 ? 0 : 1;
+}